@@ -470,16 +470,17 @@ SDSPITiva_Object sdspiTivaObjects[EK_TM4C1294XL_SDSPICOUNT];
 
 const SDSPITiva_HWAttrs sdspiTivaHWattrs[EK_TM4C1294XL_SDSPICOUNT] = {
     {
-        .baseAddr = SSI2_BASE,
-
-        .portSCK = GPIO_PORTD_BASE,
-        .pinSCK = GPIO_PIN_3,
-        .portMISO = GPIO_PORTD_BASE,
-        .pinMISO = GPIO_PIN_0,
-        .portMOSI = GPIO_PORTD_BASE,
-        .pinMOSI = GPIO_PIN_1,
-        .portCS = GPIO_PORTC_BASE,
-        .pinCS = GPIO_PIN_7,
+        /* linDelta SD card socket */
+        .baseAddr = SSI1_BASE,
+
+        .portSCK = GPIO_PORTB_BASE,
+        .pinSCK = GPIO_PIN_5,
+        .portMISO = GPIO_PORTE_BASE,
+        .pinMISO = GPIO_PIN_5,
+        .portMOSI = GPIO_PORTE_BASE,
+        .pinMOSI = GPIO_PIN_4,
+        .portCS = GPIO_PORTB_BASE,
+        .pinCS = GPIO_PIN_4,
     },
     {
         .baseAddr = SSI3_BASE,
@@ -516,52 +517,29 @@ void EK_TM4C1294XL_initSDSPI(void)
 {
     /* SDSPI0 configuration */
     /* Enable the peripherals used by the SD Card */
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI2);
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI1);
 
     /* Configure pad settings */
-    GPIOPadConfigSet(GPIO_PORTD_BASE,
-                     GPIO_PIN_3 | GPIO_PIN_1,
-                     GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD);
-
-    GPIOPadConfigSet(GPIO_PORTD_BASE,
-                     GPIO_PIN_0,
-                     GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD_WPU);
-
-    GPIOPadConfigSet(GPIO_PORTC_BASE,
-                     GPIO_PIN_7,
+    GPIOPadConfigSet(GPIO_PORTB_BASE,
+                     GPIO_PIN_5 | GPIO_PIN_4,
                      GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD);
 
-    GPIOPinConfigure(GPIO_PD3_SSI2CLK);
-    GPIOPinConfigure(GPIO_PD0_SSI2XDAT1);
-    GPIOPinConfigure(GPIO_PD1_SSI2XDAT0);
-
-    /* SDSPI1 configuration */
-    /* Enable the peripherals used by the SD Card */
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI3);
-
-    /* Configure pad settings */
-    GPIOPadConfigSet(GPIO_PORTQ_BASE,
-                     GPIO_PIN_0 | GPIO_PIN_2,
+    GPIOPadConfigSet(GPIO_PORTE_BASE,
+                     GPIO_PIN_4,
                      GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD);
 
-    GPIOPadConfigSet(GPIO_PORTQ_BASE,
-                     GPIO_PIN_3,
+    GPIOPadConfigSet(GPIO_PORTE_BASE,
+                     GPIO_PIN_5,
                      GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD_WPU);
 
-    GPIOPadConfigSet(GPIO_PORTP_BASE,
-                     GPIO_PIN_4,
-                     GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD);
-
-    GPIOPinConfigure(GPIO_PQ0_SSI3CLK);
-    GPIOPinConfigure(GPIO_PQ3_SSI3XDAT1);
-    GPIOPinConfigure(GPIO_PQ2_SSI3XDAT0);
+    GPIOPinConfigure(GPIO_PB5_SSI1CLK);
+    GPIOPinConfigure(GPIO_PE5_SSI1XDAT1);
+    GPIOPinConfigure(GPIO_PE4_SSI1XDAT0);
 
     /*
-     *  These GPIOs are connected to PA2 and PA3 and need to be brought into a
-     *  GPIO input state so they don't interfere with SPI communications.
+     *  SDSPI1 is not set up: SSI3 drives the thermocouple bank, and the EK
+     *  pins it would use (PQ2, PP4) are Thermo and Step1.MS3 on this board.
      */
-    GPIOPinTypeGPIOInput(GPIO_PORTA_BASE, GPIO_PIN_2);
-    GPIOPinTypeGPIOInput(GPIO_PORTA_BASE, GPIO_PIN_3);
 
     SDSPI_init();
 }
@@ -704,7 +682,8 @@ const UART_Config UART_config[] = {
 #include <ti/drivers/uart/UARTTiva.h>
 
 UARTTiva_Object uartTivaObjects[EK_TM4C1294XL_UARTCOUNT];
-unsigned char uartTivaRingBuffer[EK_TM4C1294XL_UARTCOUNT][32];
+/* Holds a whole host link packet, and is the link's byte credit window. See UARTLINK_RX_BUF */
+unsigned char uartTivaRingBuffer[EK_TM4C1294XL_UARTCOUNT][1024];
 
 /* UART configuration structure */
 const UARTTiva_HWAttrs uartTivaHWAttrs[EK_TM4C1294XL_UARTCOUNT] = {
@@ -36,7 +36,8 @@
 
 MEMORY
 {
-    FLASH (RX) : origin = 0x00000000, length = 0x00100000
+    /* the last two 16K sectors are left for the nvstore flash fallback */
+    FLASH (RX) : origin = 0x00000000, length = 0x000F8000
     SRAM (RWX) : origin = 0x20000000, length = 0x00040000
 }
 
@@ -49,6 +50,12 @@ SECTIONS
     .cinit  :   > FLASH
     .pinit  :   > FLASH
     .init_array : > FLASH
+    .binit  :   > FLASH
+
+    /* servo path code and tables (RAMFUNC, RAMDATA in code/util.h), loaded
+     * in flash and copied to SRAM by the boot routine */
+    .TI.ramfunc : {} load = FLASH, run = SRAM, table(BINIT)
+    .ramdata    : {} load = FLASH, run = SRAM, table(BINIT)
 
     .data   :   > SRAM
     .bss    :   > SRAM
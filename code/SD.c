@@ -6,5 +6,60 @@
  */
 
 #include <code/SD.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include <ti/drivers/SDSPI.h>
+#include <ti/mw/fatfs/ff.h>
+#include "board.h"
 
 
+static SDSPI_Handle sdHdl = NULL;
+static FATFS *sdFs;
+
+
+
+/**
+ * Opens the SD card driver and checks there is a readable filesystem on the
+ * card. hwIO_init_SD() has to have been run first
+ *
+ * @return true if files can be opened on the card
+ */
+bool SD_mount()
+{
+	SDSPI_Params params;
+	DWORD freeClust;
+
+	if(sdHdl) { return true; }
+
+	SDSPI_Params_init(&params);
+	sdHdl = SDSPI_open(Board_SDSPI0, SD_DRIVE_NUM, &params);
+	if(!sdHdl) { return false; }
+
+	// FatFs mounts lazily, so poke the filesystem to make sure a card is there
+	if(f_getfree("0:", &freeClust, &sdFs) != FR_OK)
+	{
+		SD_unmount();
+		return false;
+	}
+
+	return true;
+}
+
+
+
+
+void SD_unmount()
+{
+	if(!sdHdl) { return; }
+
+	SDSPI_close(sdHdl);
+	sdHdl = NULL;
+}
+
+
+
+
+bool SD_isMounted()
+{
+	return sdHdl != NULL;
+}
@@ -8,6 +8,14 @@
 #ifndef CODE_SD_H_
 #define CODE_SD_H_
 
+#include <stdbool.h>
+
+#define SD_DRIVE_NUM 0 // FatFs logical drive the card is mounted on. Paths start with "0:"
+
+
+bool SD_mount(); // opens the SDSPI driver and mounts the card. true if it is ready to use
+void SD_unmount(); // unmounts the card and closes the driver
+bool SD_isMounted();
 
 
 #endif /* CODE_SD_H_ */
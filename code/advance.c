@@ -0,0 +1,110 @@
+/*
+ * advance.c
+ */
+
+#include "code/advance.h"
+#include "code/stepper.h"
+#include <stdint.h>
+#include <math.h>
+#include "code/noalloc.h"
+
+
+/**
+ * Applies pressure advance to a planned extrusion segment, producing the step
+ * segments that should actually be queued. If the advance term reverses the
+ * extruder partway through (hard decelerations), the segment is split where
+ * the velocity crosses 0 so each output segment only steps one way
+ *
+ * @param advK pressure advance coefficient (secs)
+ * @param carry fractional step left over from the last segment. Updated, so rounding never accumulates
+ * @param de planned extrusion over the segment (steps)
+ * @param v0 planned extrusion velocity at the segment start (steps / sec)
+ * @param v1 planned extrusion velocity at the segment end (steps / sec)
+ * @param dur length of the segment (clock cycles)
+ * @param clkFreq clock cycles per sec
+ * @param out filled with up to ADVANCE_MAX_SEGS step segments
+ *
+ * @return the number of segments written to out
+ */
+uint8_t advance_apply(float advK, float *carry, float de, float v0, float v1, uint32_t dur, uint32_t clkFreq, StepSeg *out)
+{
+	float t = (float)dur / clkFreq;
+	float a = (v1 - v0) / t;
+
+	// the advance term only shifts the velocity, and adds its change in advance to the distance
+	float av0 = v0 + advK * a;
+	float av1 = v1 + advK * a;
+	float exact = de + advK * (v1 - v0) + *carry;
+	int32_t steps = (int32_t)roundf(exact);
+	*carry = exact - steps;
+
+	if(av0 * av1 >= 0 || a == 0) // extruder keeps going the same way the whole time
+	{
+		out[0].steps = steps;
+		out[0].v0 = fabsf(av0);
+		out[0].v1 = fabsf(av1);
+		out[0].dur = dur;
+		return 1;
+	}
+
+	// split where the advanced velocity crosses 0
+	float tz = -av0 / a;
+	uint32_t dur0 = (uint32_t)(tz * clkFreq);
+	if(dur0 == 0 || dur0 >= dur)
+	{
+		// too close to an edge to be worth splitting. The short side is
+		// under a cycle long, so its speed is clamped to 0, and the whole
+		// segment goes the way it mostly goes
+		out[0].steps = steps;
+		out[0].v0 = dur0 == 0 ? 0 : fabsf(av0);
+		out[0].v1 = dur0 == 0 ? fabsf(av1) : 0;
+		out[0].dur = dur;
+		return 1;
+	}
+
+	int32_t steps0 = (int32_t)roundf(av0 * tz / 2);
+
+	out[0].steps = steps0;
+	out[0].v0 = fabsf(av0);
+	out[0].v1 = 0;
+	out[0].dur = dur0;
+
+	out[1].steps = steps - steps0;
+	out[1].v0 = 0;
+	out[1].v1 = fabsf(av1);
+	out[1].dur = dur - dur0;
+
+	return 2;
+}
+
+
+
+
+/**
+ * Analytic reference for the advanced extruder position, relative to where it
+ * was at the start of the segment. Used to check the generated step times
+ * against in simulation
+ *
+ * @param segTime length of the segment (secs)
+ * @param t time into the segment (secs)
+ */
+float advance_refPos(float advK, float v0, float v1, float segTime, float t)
+{
+	float a = (v1 - v0) / segTime;
+	return v0 * t + a * t * t / 2 + advK * a * t;
+}
+
+
+
+
+/**
+ * Analytic reference for the advanced extruder velocity
+ *
+ * @param segTime length of the segment (secs)
+ * @param t time into the segment (secs)
+ */
+float advance_refVel(float advK, float v0, float v1, float segTime, float t)
+{
+	float a = (v1 - v0) / segTime;
+	return v0 + a * t + advK * a;
+}
@@ -0,0 +1,31 @@
+/*
+ * advance.h
+ *
+ * Pressure advance for the extruders. The filament pressure in the hotend lags
+ * the extruder, so the extruder is driven ahead of the planned extrusion by
+ * advK times the planned extrusion velocity:
+ *
+ * e'(t) = e(t) + advK * v(t)
+ *
+ * For a constant acceleration segment that is just a constant velocity offset
+ * of advK * a over the whole segment, so it is applied once per segment and
+ * costs nothing per step. Nothing in here touches hardware, so it can be run
+ * as is in a host simulation
+ */
+
+#ifndef CODE_ADVANCE_H_
+#define CODE_ADVANCE_H_
+
+#include <stdint.h>
+#include "code/stepper.h"
+
+#define ADVANCE_MAX_SEGS 2 // most step segments a single extrusion segment can turn into
+
+
+uint8_t advance_apply(float advK, float *carry, float de, float v0, float v1, uint32_t dur, uint32_t clkFreq, StepSeg *out);
+
+float advance_refPos(float advK, float v0, float v1, float segTime, float t); // analytic advanced position at time t into a segment
+float advance_refVel(float advK, float v0, float v1, float segTime, float t); // analytic advanced velocity at time t into a segment
+
+
+#endif /* CODE_ADVANCE_H_ */
@@ -0,0 +1,212 @@
+/*
+ * arc.c
+ */
+
+#include "code/arc.h"
+#include "code/motion.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <float.h>
+
+#define ARC_PI 3.14159265f
+
+
+
+/**
+ * Sets up an arc in the XY plane, with Z and E moved linearly along with it.
+ * A start point equal to the end point is a full circle
+ *
+ * @param start current tool position
+ * @param end position at the end of the arc
+ * @param i X offset from the start point to the center
+ * @param j Y offset from the start point to the center
+ * @param cw true for clockwise (G2), false for counterclockwise (G3)
+ * @param tol maximum distance between a segment and the true arc
+ *
+ * @return false if the arc is degenerate (0 radius)
+ */
+bool arc_init(ArcGen *g, const ToolPos *start, const ToolPos *end, float i, float j, bool cw, float tol)
+{
+	g->cx = start->x + i;
+	g->cy = start->y + j;
+	g->rx = -i;
+	g->ry = -j;
+	g->r = sqrtf(i*i + j*j);
+
+	if(g->r <= 0) { return false; }
+
+	// sweep from the start to the end angle, in the requested direction
+	g->a0 = atan2f(g->ry, g->rx);
+	float sweep = atan2f(end->y - g->cy, end->x - g->cx) - g->a0;
+
+	if(cw && sweep >= 0) { sweep -= 2*ARC_PI; }
+	else if(!cw && sweep <= 0) { sweep += 2*ARC_PI; }
+
+	// biggest angle with a sagitta, r(1 - cos(theta/2)), inside the tolerance.
+	// Between trig corrections the rotation recurrence lets the radius drift by
+	// up to about an ulp of r per point, and that comes off the sagitta budget
+	if(tol < ARC_MIN_TOL) { tol = ARC_MIN_TOL; }
+	float sag = tol - ARC_CORRECTION * g->r * FLT_EPSILON;
+	if(sag < ARC_MIN_TOL) { sag = ARC_MIN_TOL; }
+	float maxTheta = sag < g->r ? 2 * acosf(1 - sag / g->r) : ARC_PI;
+
+	g->n = (uint32_t)ceilf(fabsf(sweep) / maxTheta);
+	if(g->n == 0) { g->n = 1; }
+
+	g->theta = sweep / g->n;
+	g->cosT = cosf(g->theta);
+	g->sinT = sinf(g->theta);
+	g->dz = (end->z - start->z) / g->n;
+	g->de = (end->e - start->e) / g->n;
+	g->pos = *start;
+	g->end = *end;
+	g->i = 0;
+
+	return true;
+}
+
+
+
+
+/**
+ * Gets the end point of the next segment of the arc
+ *
+ * @param out filled with the point
+ *
+ * @return false if the arc has already been finished
+ */
+bool arc_next(ArcGen *g, ToolPos *out)
+{
+	if(g->i >= g->n) { return false; }
+
+	g->i++;
+
+	if(g->i == g->n) // land exactly on the requested end point
+	{
+		g->pos = g->end;
+		*out = g->pos;
+		return true;
+	}
+
+	if(g->i % ARC_CORRECTION == 0) // get rid of accumulated rotation error
+	{
+		float a = g->a0 + g->i * g->theta;
+		g->rx = g->r * cosf(a);
+		g->ry = g->r * sinf(a);
+	} else
+	{
+		float rx = g->rx;
+		g->rx = rx * g->cosT - g->ry * g->sinT;
+		g->ry = rx * g->sinT + g->ry * g->cosT;
+	}
+
+	g->pos.x = g->cx + g->rx;
+	g->pos.y = g->cy + g->ry;
+	g->pos.z += g->dz;
+	g->pos.e += g->de;
+
+	*out = g->pos;
+	return true;
+}
+
+
+
+
+/**
+ * Sets up a cubic bezier spline in the XY plane (G5), with Z and E moved linearly
+ * along with it. The curve is split into equal parameter steps; the chord error
+ * of a step h is at most h^2/8 * max|B''|, and B'' is largest at one of the ends
+ *
+ * @param start current tool position (first control point)
+ * @param end position at the end of the spline (last control point)
+ * @param i X offset from the start to the second control point
+ * @param j Y offset from the start to the second control point
+ * @param p X offset from the end to the third control point
+ * @param q Y offset from the end to the third control point
+ * @param tol maximum distance between a segment and the true curve
+ *
+ * @return false if the spline has no length
+ */
+bool spline_init(SplineGen *g, const ToolPos *start, const ToolPos *end, float i, float j, float p, float q, float tol)
+{
+	float x0 = start->x, y0 = start->y;
+	float x1 = x0 + i, y1 = y0 + j;
+	float x3 = end->x, y3 = end->y;
+	float x2 = x3 + p, y2 = y3 + q;
+
+	// power basis: B(t) = a t^3 + b t^2 + c t + P0
+	float ax = x3 - x0 + 3*(x1 - x2), ay = y3 - y0 + 3*(y1 - y2);
+	float bx = 3*(x0 - 2*x1 + x2), by = 3*(y0 - 2*y1 + y2);
+	float cx = 3*(x1 - x0), cy = 3*(y1 - y0);
+
+	if(ax == 0 && ay == 0 && bx == 0 && by == 0 && cx == 0 && cy == 0) { return false; }
+
+	// B''(0) = 2b, B''(1) = 6a + 2b
+	float dd0 = sqrtf(4*(bx*bx + by*by));
+	float dd1 = sqrtf((6*ax + 2*bx)*(6*ax + 2*bx) + (6*ay + 2*by)*(6*ay + 2*by));
+	float ddMax = dd0 > dd1 ? dd0 : dd1;
+
+	if(tol < ARC_MIN_TOL) { tol = ARC_MIN_TOL; }
+	g->n = (uint32_t)ceilf(sqrtf(ddMax / (8 * tol)));
+	if(g->n == 0) { g->n = 1; }
+
+	float h = 1.0f / g->n;
+	float h2 = h*h, h3 = h2*h;
+
+	g->px = x0;
+	g->py = y0;
+	g->d1x = ax*h3 + bx*h2 + cx*h;
+	g->d1y = ay*h3 + by*h2 + cy*h;
+	g->d2x = 6*ax*h3 + 2*bx*h2;
+	g->d2y = 6*ay*h3 + 2*by*h2;
+	g->d3x = 6*ax*h3;
+	g->d3y = 6*ay*h3;
+
+	g->dz = (end->z - start->z) / g->n;
+	g->de = (end->e - start->e) / g->n;
+	g->pos = *start;
+	g->end = *end;
+	g->i = 0;
+
+	return true;
+}
+
+
+
+
+/**
+ * Gets the end point of the next segment of the spline
+ *
+ * @param out filled with the point
+ *
+ * @return false if the spline has already been finished
+ */
+bool spline_next(SplineGen *g, ToolPos *out)
+{
+	if(g->i >= g->n) { return false; }
+
+	g->i++;
+
+	if(g->i == g->n) // land exactly on the requested end point
+	{
+		g->pos = g->end;
+		*out = g->pos;
+		return true;
+	}
+
+	g->px += g->d1x;
+	g->py += g->d1y;
+	g->d1x += g->d2x;
+	g->d1y += g->d2y;
+	g->d2x += g->d3x;
+	g->d2y += g->d3y;
+
+	g->pos.x = g->px;
+	g->pos.y = g->py;
+	g->pos.z += g->dz;
+	g->pos.e += g->de;
+
+	*out = g->pos;
+	return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * arc.h
+ *
+ * Breaks arcs (G2/G3) and cubic splines (G5) up into straight segments for the
+ * planner. Segment count is picked so the chord never strays further than a
+ * given tolerance from the true curve.
+ *
+ * Both are generators: init once, then pull segment end points out with
+ * arc_next() / spline_next() as the planner has room for them. Points are
+ * produced incrementally (rotation for arcs, forward differencing for splines),
+ * so there is no trig per point
+ */
+
+#ifndef CODE_ARC_H_
+#define CODE_ARC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "code/motion.h"
+
+#define ARC_CORRECTION	32		// arc points between exact trig corrections of the rotation drift
+#define ARC_MIN_TOL		1e-6f	// smallest chord tolerance that will be honored
+
+
+typedef struct ArcGen
+{
+	float cx, cy;		// center
+	float rx, ry;		// current radius vector
+	float cosT, sinT;	// rotation per segment
+	float r;			// radius
+	float a0;			// angle of the start point
+	float theta;		// angle per segment
+	float dz, de;		// z and extruder change per segment
+	ToolPos pos;		// last point output
+	ToolPos end;
+	uint32_t n;			// total number of segments
+	uint32_t i;			// segments output so far
+} ArcGen;
+
+
+
+typedef struct SplineGen
+{
+	float px, py;		// current point
+	float d1x, d1y;		// forward differences
+	float d2x, d2y;
+	float d3x, d3y;
+	float dz, de;		// z and extruder change per segment
+	ToolPos pos;
+	ToolPos end;
+	uint32_t n;
+	uint32_t i;
+} SplineGen;
+
+
+
+bool arc_init(ArcGen *g, const ToolPos *start, const ToolPos *end, float i, float j, bool cw, float tol);
+bool arc_next(ArcGen *g, ToolPos *out); // gets the next segment end point. false once the arc is done
+
+bool spline_init(SplineGen *g, const ToolPos *start, const ToolPos *end, float i, float j, float p, float q, float tol);
+bool spline_next(SplineGen *g, ToolPos *out); // gets the next segment end point. false once the spline is done
+
+
+#endif /* CODE_ARC_H_ */
@@ -0,0 +1,111 @@
+/*
+ * boot.c
+ */
+
+#include "code/boot.h"
+#include "code/hwIO.h"
+#include "code/util.h"
+#include "code/timebase.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/knl/Task.h>
+
+
+static const char * const bootNames[BOOT_NUM_MARKS] =
+{
+	"safe",
+	"config",
+	"motion",
+	"bios",
+	"servo",
+	"late"
+};
+
+static uint32_t bootCycles[BOOT_NUM_MARKS];
+static volatile uint32_t bootReached;	// bit for each mark that has been recorded
+
+
+
+
+/**
+ * Zeroes the cycle counter, which the rest of the marks are timed with.
+ * timebase_init() has to have been run
+ */
+void boot_start()
+{
+	bootReached = 0;
+	cycleCountInit();
+}
+
+
+
+
+void boot_mark(uint8_t mark)
+{
+	if(mark >= BOOT_NUM_MARKS || (bootReached & (1 << mark))) { return; }
+
+	bootCycles[mark] = cycleCount();
+	bootReached |= 1 << mark;
+}
+
+
+
+bool boot_reached(uint8_t mark)
+{
+	return mark < BOOT_NUM_MARKS && (bootReached & (1 << mark));
+}
+
+
+
+uint32_t boot_getUsecs(uint8_t mark)
+{
+	if(!boot_reached(mark)) { return 0xffffffff; }
+	return timebase_cyclesToUs(bootCycles[mark]);
+}
+
+
+
+
+/**
+ * Prints when each stage was reached. The servo line is the one to watch
+ * across releases
+ */
+void boot_report()
+{
+	uint8_t i;
+
+	for(i = 0; i < BOOT_NUM_MARKS; i++)
+	{
+		if(boot_reached(i))
+			System_printf("boot: %s at %d us\n", bootNames[i], boot_getUsecs(i));
+		else
+			System_printf("boot: %s not reached\n", bootNames[i]);
+	}
+
+	System_flush();
+}
+
+
+
+
+/**
+ * Background init task. Needs to be the highest priority task, so that the
+ * network driver is up before the NDK stack thread starts
+ */
+void boot_lateTask(UArg arg0, UArg arg1)
+{
+	uint32_t waited;
+
+	boot_mark(BOOT_MARK_BIOS);
+
+	hwIO_init_late();
+	boot_mark(BOOT_MARK_LATE);
+
+	// the cycle counter wraps after about 35s, so don't wait forever
+	for(waited = 0; !boot_reached(BOOT_MARK_SERVO) && waited < BOOT_SERVO_WAIT; waited += 10)
+		Task_sleep(10);
+
+	boot_report();
+}
@@ -0,0 +1,42 @@
+/*
+ * boot.h
+ *
+ * Staged startup, and a timestamp log of how long each stage takes. main()
+ * only does what is needed to hold the motors safe and get the servo running,
+ * and everything else (the SD card and the config, networking, the
+ * thermocouples, the UART) is brought up by boot_lateTask() once BIOS has
+ * started.
+ *
+ * Times are measured from boot_start(), right after the clock is set up, so
+ * the reset vector, C runtime init and PLL lock aren't counted
+ */
+
+#ifndef CODE_BOOT_H_
+#define CODE_BOOT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+
+// boot stages, in the order they normally happen
+#define BOOT_MARK_SAFE		0	// motor, heater and driver outputs are held off
+#define BOOT_MARK_CONFIG	1	// config is loaded and applied over the defaults, from boot_lateTask()
+#define BOOT_MARK_MOTION	2	// PWM generators and step timers are set up
+#define BOOT_MARK_BIOS		3	// BIOS is running tasks
+#define BOOT_MARK_SERVO		4	// first servo tick
+#define BOOT_MARK_LATE		5	// background init is done
+#define BOOT_NUM_MARKS		6
+
+#define BOOT_SERVO_WAIT		1000	// ms boot_lateTask() waits for the first servo tick before reporting
+
+
+void boot_start(); // starts the boot clock. Run as soon as the system clock is set
+void boot_mark(uint8_t mark); // records the time a stage was reached. Only the first call for each mark counts
+bool boot_reached(uint8_t mark);
+uint32_t boot_getUsecs(uint8_t mark); // time from boot_start() to a mark, 0xffffffff if it wasn't reached
+
+void boot_report(); // prints the timestamp log
+void boot_lateTask(UArg arg0, UArg arg1); // runs the deferred init, then reports
+
+
+#endif /* CODE_BOOT_H_ */
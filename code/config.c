@@ -0,0 +1,698 @@
+/*
+ * config.c
+ */
+
+#include "code/config.h"
+#include "code/dat.h"
+#include "code/SD.h"
+#include "code/nvstore.h"
+#include "code/util.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/mw/fatfs/ff.h>
+
+#define CONFIG_VALS_MAX 512 // room for the packed values of the image
+
+// value types in the config table
+#define CFG_F32		0
+#define CFG_U32		1
+#define CFG_U64		2
+#define CFG_U8		3
+#define CFG_BOOL	4
+
+
+typedef struct CfgEntry
+{
+	const char *key;
+	uint8_t type;
+	void *var;
+	float min;	// allowed range. ignored for bools
+	float max;
+} CfgEntry;
+
+
+
+#define CFG_AXIS(pre, d) \
+	{ pre ".enc.ppi",		CFG_F32,	&d.enc.ppi,			1,		1e6 }, \
+	{ pre ".enc.inv",		CFG_BOOL,	&d.enc.inv,			0,		1 }, \
+	{ pre ".mot.period",	CFG_U32,	&d.mot.period,		100,	100000 }, \
+	{ pre ".mot.low",		CFG_U32,	&d.mot.low,			0,		100000 }, \
+	{ pre ".mot.high",		CFG_U32,	&d.mot.high,		0,		100000 }, \
+	{ pre ".mot.deadband",	CFG_U32,	&d.mot.deadband,	0,		100000 }, \
+	{ pre ".mot.inv",		CFG_BOOL,	&d.mot.inv,			0,		1 }, \
+	{ pre ".mot.mode",		CFG_U8,		&d.mot.mode,		0,		1 }, \
+	{ pre ".pid.kp",		CFG_F32,	&d.pid.kp,			-1e6,	1e6 }, \
+	{ pre ".pid.ki",		CFG_F32,	&d.pid.ki,			-1e6,	1e6 }, \
+	{ pre ".pid.kd",		CFG_F32,	&d.pid.kd,			-1e6,	1e6 }, \
+	{ pre ".et.zPos",		CFG_F32,	&d.et.zPos,			-1000,	1000 }, \
+	{ pre ".et.inv",		CFG_BOOL,	&d.et.inv,			0,		1 }, \
+	{ pre ".eb.zPos",		CFG_F32,	&d.eb.zPos,			-1000,	1000 }, \
+	{ pre ".eb.inv",		CFG_BOOL,	&d.eb.inv,			0,		1 }, \
+	{ pre ".axisX",			CFG_F32,	&d.axisX,			-1000,	1000 }, \
+	{ pre ".axisY",			CFG_F32,	&d.axisY,			-1000,	1000 }, \
+	{ pre ".rodLen",		CFG_F32,	&d.rodLen,			0.1,	1000 }
+
+#define CFG_EXT(pre, d) \
+	{ pre ".stepsPerMm",	CFG_F32,	&d.stepsPerMm,		1,		10000 }, \
+	{ pre ".microsteps",	CFG_U8,		&d.microsteps,		1,		16 }, \
+	{ pre ".pulseWidth",	CFG_U32,	&d.pulseWidth,		1,		100 }, \
+	{ pre ".inv",			CFG_BOOL,	&d.inv,				0,		1 }, \
+	{ pre ".advK",			CFG_F32,	&d.advK,			0,		1 }
+
+
+/**
+ * Every configurable variable. The binary image packs values in this order,
+ * so CONFIG_VERSION has to be bumped whenever this changes
+ */
+static const CfgEntry cfgTbl[] =
+{
+	{ "tickTime",				CFG_U64,	&tickTime,				100,	1e6 },
+	CFG_AXIS("axisA", axisADat),
+	CFG_AXIS("axisB", axisBDat),
+	CFG_AXIS("axisC", axisCDat),
+	CFG_EXT("ext1", ext1Dat),
+	CFG_EXT("ext2", ext2Dat),
+	{ "kin.segRate",			CFG_F32,	&kin_segRate,			10,		20000 },
+	{ "thermo.clk",				CFG_U32,	&thermo_clk,			1000,	5e6 },
+	{ "thermo.bitsPerFrame",	CFG_U32,	&thermo_bitsPerFrame,	4,		16 },
+	{ "thermo.comMode",			CFG_U32,	&thermo_comMode,		0,		3 },
+	{ "thermo.tempScl",			CFG_F32,	&thermo_tempScl,		0,		10 }
+};
+
+#define CFG_NUM_ENTRIES (sizeof(cfgTbl) / sizeof(cfgTbl[0]))
+
+
+static char cfgTxt[CONFIG_TXT_MAX + 1];
+static uint8_t cfgImg[sizeof(ConfigHdr) + CONFIG_VALS_MAX];
+static uint8_t cfgStage[CONFIG_VALS_MAX];
+
+static uint8_t cfgSrc = CONFIG_SRC_DEFAULTS;	// where the values in use came from
+static uint32_t cfgSrcCrc;	// CRC-32 of the text the values in use came from
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// Packed values ///////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+static uint32_t config_typeSize(uint8_t type)
+{
+	switch(type)
+	{
+		case CFG_U64:	return 8;
+		case CFG_U8:	return 1;
+		case CFG_BOOL:	return 1;
+		default:		return 4;
+	}
+}
+
+
+
+static uint32_t config_offset(uint32_t idx)
+{
+	uint32_t off = 0, i;
+	for(i = 0; i < idx; i++) { off += config_typeSize(cfgTbl[i].type); }
+	return off;
+}
+
+
+
+uint32_t config_getImageLen()
+{
+	return config_offset(CFG_NUM_ENTRIES);
+}
+
+
+
+void config_pack(uint8_t *buf)
+{
+	uint32_t i;
+	for(i = 0; i < CFG_NUM_ENTRIES; i++)
+	{
+		uint32_t sz = config_typeSize(cfgTbl[i].type);
+		memcpy(buf, cfgTbl[i].var, sz);
+		buf += sz;
+	}
+}
+
+
+
+void config_unpack(const uint8_t *buf)
+{
+	uint32_t i;
+	for(i = 0; i < CFG_NUM_ENTRIES; i++)
+	{
+		uint32_t sz = config_typeSize(cfgTbl[i].type);
+		memcpy(cfgTbl[i].var, buf, sz);
+		buf += sz;
+	}
+}
+
+
+
+
+/**
+ * Reads a packed value as a float, for range checking
+ */
+static float config_getPacked(const uint8_t *buf, uint32_t idx)
+{
+	const uint8_t *p = buf + config_offset(idx);
+	float f;
+	uint32_t u32;
+	uint64_t u64;
+
+	switch(cfgTbl[idx].type)
+	{
+		case CFG_F32:	memcpy(&f, p, 4); return f;
+		case CFG_U32:	memcpy(&u32, p, 4); return (float)u32;
+		case CFG_U64:	memcpy(&u64, p, 8); return (float)u64;
+		default:		return (float)*p;
+	}
+}
+
+
+
+
+/**
+ * Checks that a set of motor pulse settings make sense together. In RC mode
+ * the pulse has to fit in the period, and the deadband can't swallow the
+ * whole range. In H-bridge mode the period has to be in the supported range,
+ * and the deadband has to leave some of it to control
+ *
+ * @return true if they are safe to drive the motor with
+ */
+bool config_checkMot(const MotDat *mot)
+{
+	if(mot->mode == MOT_MODE_HBRIDGE)
+	{
+		return mot->period >= MOT_HB_PERIOD_MIN &&
+				mot->period <= MOT_HB_PERIOD_MAX &&
+				mot->deadband < mot->period;
+	}
+
+	return mot->mode == MOT_MODE_RC &&
+			mot->low < mot->high &&
+			mot->high <= mot->period &&
+			2 * mot->deadband < mot->high - mot->low;
+}
+
+
+
+
+/**
+ * Checks packed values are all in range, and that the motor pulse settings
+ * make sense together
+ *
+ * @return true if the values are safe to load
+ */
+static bool config_validate(const uint8_t *vals)
+{
+	uint32_t i, nMot = 0;
+	uint32_t periods[3];
+
+	for(i = 0; i < CFG_NUM_ENTRIES; i++)
+	{
+		if(cfgTbl[i].type == CFG_BOOL) { continue; }
+
+		float v = config_getPacked(vals, i);
+		if(v != v || v < cfgTbl[i].min || v > cfgTbl[i].max)
+		{
+			System_printf("config: %s out of range\n", cfgTbl[i].key);
+			return false;
+		}
+	}
+
+	// the MS pins can only set power of two microstepping
+	for(i = 0; i < CFG_NUM_ENTRIES; i++)
+	{
+		const char *dot = strrchr(cfgTbl[i].key, '.');
+		if(!dot || strcmp(dot, ".microsteps") != 0) { continue; }
+
+		uint32_t ms = config_getPacked(vals, i);
+		if(ms & (ms - 1))
+		{
+			System_printf("config: %s must be 1, 2, 4, 8 or 16\n", cfgTbl[i].key);
+			return false;
+		}
+	}
+
+	// in the table, each .mot.period is followed by the matching low, high,
+	// deadband, inv and mode, and the axes are in order
+	for(i = 0; i < CFG_NUM_ENTRIES; i++)
+	{
+		const char *dot = strrchr(cfgTbl[i].key, '.');
+		if(!dot || strcmp(dot, ".period") != 0) { continue; }
+
+		MotDat mot =
+		{
+			.period = config_getPacked(vals, i),
+			.low = config_getPacked(vals, i + 1),
+			.high = config_getPacked(vals, i + 2),
+			.deadband = config_getPacked(vals, i + 3),
+			.mode = config_getPacked(vals, i + 5)
+		};
+
+		if(!config_checkMot(&mot))
+		{
+			System_printf("config: bad motor pulse settings at %s\n", cfgTbl[i].key);
+			return false;
+		}
+
+		if(nMot < 3) { periods[nMot++] = mot.period; }
+	}
+
+	// axes A and C are on the same PWM generator, so they can only have one period
+	if(nMot == 3 && periods[0] != periods[2])
+	{
+		System_printf("config: axisA and axisC need the same mot.period\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Validates an image header and values against the current config table. The
+ * values go through the same checks as text, so an image saved before a rule
+ * was added doesn't get around it
+ *
+ * @return true if the image can be unpacked
+ */
+bool config_checkImage(const ConfigHdr *hdr, const uint8_t *vals)
+{
+	return hdr->magic == CONFIG_MAGIC &&
+			hdr->version == CONFIG_VERSION &&
+			hdr->numEntries == CFG_NUM_ENTRIES &&
+			hdr->len == config_getImageLen() &&
+			hdr->crc == crc32(0, vals, hdr->len) &&
+			config_validate(vals);
+}
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Text parsing /////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+static char *config_trim(char *s)
+{
+	char *end;
+
+	while(*s == ' ' || *s == '\t') { s++; }
+
+	end = s + strlen(s);
+	while(end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) { end--; }
+	*end = 0;
+
+	return s;
+}
+
+
+
+
+/**
+ * Parses a value string into the packed slot of a config entry
+ *
+ * @return false if the string isn't a valid value of the right type
+ */
+static bool config_parseValue(uint32_t idx, const char *str, uint8_t *vals)
+{
+	uint8_t *p = vals + config_offset(idx);
+	char *end;
+
+	if(cfgTbl[idx].type == CFG_BOOL)
+	{
+		bool b;
+		if(!strcmp(str, "true") || !strcmp(str, "1")) { b = true; }
+		else if(!strcmp(str, "false") || !strcmp(str, "0")) { b = false; }
+		else { return false; }
+
+		memcpy(p, &b, 1);
+		return true;
+	}
+
+	if(cfgTbl[idx].type == CFG_F32)
+	{
+		float f = strtof(str, &end);
+		if(end == str || *end) { return false; }
+		memcpy(p, &f, 4);
+		return true;
+	}
+
+	unsigned long ul = strtoul(str, &end, 0);
+	if(end == str || *end || *str == '-') { return false; }
+
+	if(cfgTbl[idx].type == CFG_U64)
+	{
+		uint64_t u64 = ul;
+		memcpy(p, &u64, 8);
+	} else if(cfgTbl[idx].type == CFG_U8)
+	{
+		uint8_t u8 = (uint8_t)(ul > 0xff ? 0xff : ul);
+		memcpy(p, &u8, 1);
+	} else
+	{
+		uint32_t u32 = (uint32_t)ul;
+		memcpy(p, &u32, 4);
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Parses config text over the top of a set of packed values
+ *
+ * @param txt null terminated config text. Modified in place
+ * @param vals packed values to update
+ *
+ * @return true if every line parsed
+ */
+static bool config_parseText(char *txt, uint8_t *vals)
+{
+	uint32_t lineNum = 0;
+	bool ok = true;
+	char *line = txt;
+
+	while(line && *line)
+	{
+		char *next = strchr(line, '\n');
+		if(next) { *next++ = 0; }
+		lineNum++;
+
+		char *hash = strchr(line, '#');
+		if(hash) { *hash = 0; }
+
+		char *eq = strchr(line, '=');
+		if(!eq)
+		{
+			if(*config_trim(line)) { System_printf("config: line %d has no '='\n", lineNum); ok = false; }
+			line = next;
+			continue;
+		}
+
+		*eq = 0;
+		char *key = config_trim(line);
+		char *val = config_trim(eq + 1);
+		uint32_t i;
+
+		for(i = 0; i < CFG_NUM_ENTRIES; i++)
+		{
+			if(!strcmp(key, cfgTbl[i].key)) { break; }
+		}
+
+		if(i == CFG_NUM_ENTRIES)
+		{
+			System_printf("config: line %d unknown key %s\n", lineNum, key);
+			ok = false;
+		} else if(!config_parseValue(i, val, vals))
+		{
+			System_printf("config: line %d bad value for %s\n", lineNum, key);
+			ok = false;
+		}
+
+		line = next;
+	}
+
+	return ok;
+}
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////// Loading ////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Reads a whole file into a buffer
+ *
+ * @return number of bytes read, or -1 if it couldn't be opened or is too big
+ */
+static int32_t config_readFile(const char *path, void *buf, uint32_t maxLen)
+{
+	FIL fil;
+	UINT got;
+
+	if(f_open(&fil, path, FA_READ) != FR_OK) { return -1; }
+
+	if(f_size(&fil) > maxLen || f_read(&fil, buf, maxLen, &got) != FR_OK)
+	{
+		f_close(&fil);
+		return -1;
+	}
+
+	f_close(&fil);
+	return got;
+}
+
+
+
+
+/**
+ * Builds a binary image of the current config variables in cfgImg
+ *
+ * @return total length of the image, header included
+ */
+static uint32_t config_buildImage(uint32_t srcCrc)
+{
+	ConfigHdr *hdr = (ConfigHdr *)cfgImg;
+	uint8_t *vals = cfgImg + sizeof(ConfigHdr);
+
+	config_pack(vals);
+
+	hdr->magic = CONFIG_MAGIC;
+	hdr->version = CONFIG_VERSION;
+	hdr->numEntries = CFG_NUM_ENTRIES;
+	hdr->srcCrc = srcCrc;
+	hdr->len = config_getImageLen();
+	hdr->crc = crc32(0, vals, hdr->len);
+
+	return sizeof(ConfigHdr) + hdr->len;
+}
+
+
+
+
+/**
+ * Writes out a binary image of the current config variables
+ */
+static bool config_writeImage(uint32_t srcCrc)
+{
+	uint32_t len = config_buildImage(srcCrc);
+	FIL fil;
+	UINT put;
+
+	if(f_open(&fil, CONFIG_BIN_PATH, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) { return false; }
+
+	FRESULT res = f_write(&fil, cfgImg, len, &put);
+	f_close(&fil);
+
+	return res == FR_OK && put == len;
+}
+
+
+
+
+/**
+ * Loads the config and bed mesh from the on chip store
+ *
+ * @return true if a good config image was found
+ */
+static bool config_loadNV()
+{
+	ConfigHdr *hdr = (ConfigHdr *)cfgImg;
+	uint8_t *vals = cfgImg + sizeof(ConfigHdr);
+	uint32_t len;
+
+	if(!nv_read(NV_REC_MESH, MESH_VERSION, &bedMesh, sizeof(bedMesh), &len) || len != sizeof(bedMesh))
+		bedMesh.valid = false;
+
+	if(!nv_read(NV_REC_CONFIG, CONFIG_VERSION, cfgImg, sizeof(cfgImg), &len)) { return false; }
+	if(len < sizeof(ConfigHdr) || !config_checkImage(hdr, vals)) { return false; }
+
+	config_unpack(vals);
+	cfgSrcCrc = hdr->srcCrc;
+	return true;
+}
+
+
+
+
+/**
+ * Loads the config from the SD card. If the binary image on the card was made
+ * from the current text file, it is copied straight in. Otherwise the text is
+ * parsed over the current values and checked, and only applied (and the image
+ * rewritten) if the whole thing is valid. On any failure the current values
+ * stay in place. Whatever gets loaded is copied to the on chip store for the
+ * next boot
+ *
+ * @return where the config now in use came from, CONFIG_SRC_xxx
+ */
+static uint8_t config_loadSD()
+{
+	ConfigHdr *hdr = (ConfigHdr *)cfgImg;
+	uint8_t *vals = cfgImg + sizeof(ConfigHdr);
+
+	if(!SD_mount()) { return cfgSrc; }
+
+	int32_t txtLen = config_readFile(CONFIG_TXT_PATH, cfgTxt, CONFIG_TXT_MAX);
+	uint32_t txtCrc = txtLen >= 0 ? crc32(0, cfgTxt, txtLen) : 0;
+
+	// the stored copy came from this same text, and may have calibration on top of it
+	if(cfgSrc == CONFIG_SRC_NV && (txtLen < 0 || txtCrc == cfgSrcCrc)) { return cfgSrc; }
+
+	int32_t imgLen = config_readFile(CONFIG_BIN_PATH, cfgImg, sizeof(cfgImg));
+	bool imgOk = imgLen >= (int32_t)sizeof(ConfigHdr) && config_checkImage(hdr, vals);
+
+	// fast path, the image is current (or there is no text to check it against)
+	if(imgOk && (txtLen < 0 || hdr->srcCrc == txtCrc))
+	{
+		config_unpack(vals);
+		cfgSrcCrc = hdr->srcCrc;
+		cfgSrc = CONFIG_SRC_IMAGE;
+		config_saveNV();
+		return cfgSrc;
+	}
+
+	if(txtLen < 0) { return cfgSrc; }
+
+	// text changed, re-parse it over the current values
+	cfgTxt[txtLen] = 0;
+	config_pack(cfgStage);
+
+	if(!config_parseText(cfgTxt, cfgStage) || !config_validate(cfgStage))
+	{
+		System_printf("config: %s rejected\n", CONFIG_TXT_PATH);
+		System_flush();
+
+		// last good image beats the defaults
+		if(imgOk && cfgSrc == CONFIG_SRC_DEFAULTS)
+		{
+			config_unpack(vals);
+			cfgSrcCrc = hdr->srcCrc;
+			cfgSrc = CONFIG_SRC_IMAGE;
+			config_saveNV();
+		}
+
+		return cfgSrc;
+	}
+
+	config_unpack(cfgStage);
+	cfgSrcCrc = txtCrc;
+	cfgSrc = CONFIG_SRC_TEXT;
+
+	if(!config_writeImage(txtCrc)) { System_printf("config: couldn't write %s\n", CONFIG_BIN_PATH); }
+	config_saveNV();
+
+	return cfgSrc;
+}
+
+
+
+
+/**
+ * Loads all of the configuration variables. The on chip store is tried first,
+ * so a machine that has booted before can move without the SD card being
+ * touched. Otherwise the config is loaded from the SD card, and on any failure
+ * the compiled in defaults stay in place.
+ *
+ * hwIO_init_SD() must be run first
+ *
+ * @return where the config came from, CONFIG_SRC_xxx
+ */
+uint8_t initConfig()
+{
+	cfgSrc = CONFIG_SRC_DEFAULTS;
+
+	if(config_getImageLen() > CONFIG_VALS_MAX)
+	{
+		System_printf("config: CONFIG_VALS_MAX is too small\n");
+		return cfgSrc;
+	}
+
+	if(nv_init() && config_loadNV())
+	{
+		cfgSrc = CONFIG_SRC_NV;
+		return cfgSrc;
+	}
+
+	return config_loadSD();
+}
+
+
+
+
+/**
+ * Checks the config file on the SD card against the stored config, and loads
+ * it if it has changed since. Slow, and the values can change under running
+ * code, so only call it while the machine is idle
+ *
+ * @return where the config now in use came from, CONFIG_SRC_xxx
+ */
+uint8_t config_syncSD()
+{
+	return config_loadSD();
+}
+
+
+
+
+/**
+ * Writes the current config variables to the on chip store, eg. after a
+ * calibration routine has changed some of them. They are tagged with the
+ * checksum of the text they came from, so they stay in use until the text
+ * is edited
+ *
+ * @return true if they were written
+ */
+bool config_saveNV()
+{
+	uint32_t len = config_buildImage(cfgSrcCrc);
+
+	if(!nv_write(NV_REC_CONFIG, CONFIG_VERSION, cfgImg, len))
+	{
+		System_printf("config: couldn't write the stored copy\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Writes bedMesh to the on chip store
+ *
+ * @return true if it was written
+ */
+bool config_saveMesh()
+{
+	return nv_write(NV_REC_MESH, MESH_VERSION, &bedMesh, sizeof(bedMesh));
+}
+
+
+
+
+uint8_t config_getSrc()
+{
+	return cfgSrc;
+}
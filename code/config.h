@@ -0,0 +1,67 @@
+/*
+ * config.h
+ *
+ * Loads the configuration variables in dat.h at boot. The human readable config
+ * file on the SD card is the master copy. The first time it is seen (or any time
+ * it changes) it is parsed, range checked, and written back out as a binary image
+ * tagged with the checksum of the text. The image is also kept in the on chip
+ * store (nvstore.h), along with any calibration done since, so boots normally
+ * copy it straight into the variables without touching the SD card.
+ *
+ * The text file is "key = value" lines, with # starting a comment, eg.
+ *
+ *   axisA.pid.kp = 0.8   # proportional gain
+ *   ext1.inv = true
+ *
+ * Any key that isn't in the file keeps its compiled in default from dat.c
+ */
+
+#ifndef CODE_CONFIG_H_
+#define CODE_CONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "code/dat.h"
+
+#define CONFIG_TXT_PATH		"0:config.txt"
+#define CONFIG_BIN_PATH		"0:config.bin"
+#define CONFIG_TXT_MAX		8192		// largest config file that will be read
+#define CONFIG_MAGIC		0x4643444C	// "LDCF"
+#define CONFIG_VERSION		2			// bump whenever the config table changes
+
+// where the config came from
+#define CONFIG_SRC_DEFAULTS	0	// nothing usable was found, compiled in defaults are in use
+#define CONFIG_SRC_IMAGE	1	// binary image was up to date with the text
+#define CONFIG_SRC_TEXT		2	// text was parsed, and the image rewritten
+#define CONFIG_SRC_NV		3	// stored copy in the on chip store
+
+
+/**
+ * Header of the binary config image. The values follow it, packed in config
+ * table order
+ */
+typedef struct ConfigHdr
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numEntries;	// entries in the config table the image was made with
+	uint32_t srcCrc;		// CRC-32 of the text file the image was made from
+	uint32_t len;			// length of the values
+	uint32_t crc;			// CRC-32 of the values
+} ConfigHdr;
+
+
+uint8_t initConfig(); // loads everything from the on chip store or the configuration file. Returns CONFIG_SRC_xxx
+uint8_t config_syncSD(); // reloads the configuration file if it changed since the stored copy was made
+bool config_saveNV(); // stores the current values, eg. after calibration
+bool config_saveMesh(); // stores bedMesh
+uint8_t config_getSrc(); // CONFIG_SRC_xxx of the values in use
+
+uint32_t config_getImageLen(); // length of the packed values
+void config_pack(uint8_t *buf); // packs the current config variables into buf
+void config_unpack(const uint8_t *buf); // loads the config variables from packed values
+bool config_checkImage(const ConfigHdr *hdr, const uint8_t *vals); // validates an image against the current table and the value checks
+bool config_checkMot(const MotDat *mot); // checks a set of motor pulse settings are consistent
+
+
+#endif /* CODE_CONFIG_H_ */
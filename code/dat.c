@@ -0,0 +1,70 @@
+/*
+ * dat.c
+ *
+ * Holds the storage for all of the configuration variables declared
+ * in dat.h, so that header can be included from more than one file
+ */
+
+#include "code/dat.h"
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef HOST_SIM
+#include <driverlib/ssi.h>
+#else
+#define SSI_FRF_MOTO_MODE_3 0x000000C0 // same as driverlib, so the host builds get the same config
+#endif
+
+
+// general information
+uint64_t tickTime = 15000; // number of usecs between each time a system update tick occurs
+
+
+// Axis data
+AxisDat axisADat =
+{
+	.enc = { .ppi = 200, .inv = false },
+	.mot = { .period = 7500, .low = 1000, .high = 2000, .deadband = 200, .inv = false, .mode = MOT_MODE_RC },
+	.pid = { .kp = 0, .ki = 0, .kd = 0 },
+	.et = { .zPos = 21, .inv = true },
+	.eb = { .zPos = 2, .inv = true }, .axisX = 10, .axisY = 12, .rodLen = 9
+};
+
+
+AxisDat axisBDat =
+{
+	.enc = { .ppi = 200, .inv = false },
+	.mot = { .period = 7500, .low = 1000, .high = 2000, .deadband = 200, .inv = false, .mode = MOT_MODE_RC },
+	.pid = { .kp = 0, .ki = 0, .kd = 0 },
+	.et = { .zPos = 21, .inv = true },
+	.eb = { .zPos = 2, .inv = true }, .axisX = 10, .axisY = 12, .rodLen = 9
+};
+
+
+AxisDat axisCDat =
+{
+	.enc = { .ppi = 200, .inv = false },
+	.mot = { .period = 7500, .low = 1000, .high = 2000, .deadband = 200, .inv = false, .mode = MOT_MODE_RC },
+	.pid = { .kp = 0, .ki = 0, .kd = 0 },
+	.et = { .zPos = 21, .inv = true },
+	.eb = { .zPos = 2, .inv = true }, .axisX = 10, .axisY = 12, .rodLen = 9
+};
+
+
+// Extruder data
+ExtDat ext1Dat = { .stepsPerMm = 96, .microsteps = 16, .pulseWidth = 2, .inv = false, .advK = 0 };
+ExtDat ext2Dat = { .stepsPerMm = 96, .microsteps = 16, .pulseWidth = 2, .inv = false, .advK = 0 };
+
+
+// Bed leveling data. Loaded from the on chip store if the bed has been probed before
+MeshDat bedMesh = { .valid = false };
+
+
+// Kinematics data
+float kin_segRate = 200;
+
+
+// Thermocouple module data
+uint32_t thermo_clk = 100000;
+uint32_t thermo_bitsPerFrame = 16;
+uint32_t thermo_comMode = SSI_FRF_MOTO_MODE_3;
+float thermo_tempScl = 0.25;
@@ -13,7 +13,6 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <driverlib/ssi.h>
 
 typedef struct EncDat
 {
@@ -23,13 +22,22 @@ typedef struct EncDat
 
 
 
+// motor output modes
+#define MOT_MODE_RC			0	// RC style pulses, from low (full reverse) to high (full forward)
+#define MOT_MODE_HBRIDGE	1	// PWM duty cycle plus a direction pin, straight into an H-bridge
+
+#define MOT_HB_PERIOD_MIN	10	// shortest H-bridge PWM period (usecs). 100kHz
+#define MOT_HB_PERIOD_MAX	50	// longest, 20kHz, so it stays out of the audible range
+
+
 typedef struct MotDat
 {
 	uint32_t period; 	// period (in uSecs) of the PWM
-	uint32_t low;		// pulse length for full reverse
-	uint32_t high;		// pulse length for full forward
-	uint32_t deadband;	// minimum offset from center that will produce an output
+	uint32_t low;		// pulse length for full reverse. RC mode only
+	uint32_t high;		// pulse length for full forward. RC mode only
+	uint32_t deadband;	// minimum offset from center that will produce an output. In H-bridge mode, the on time any nonzero output starts from
 	bool inv;			// if true multiplies output by -1
+	uint8_t mode;		// MOT_MODE_xxx
 } MotDat;
 
 
@@ -62,6 +70,7 @@ typedef struct AxisDat
 
 	float axisX;	// X-coord of the carriage mount
 	float axisY;	// Y-coord of the carriage mount
+	float rodLen;	// length of the diagonal rod from the carriage to the effector
 } AxisDat;
 
 
@@ -70,50 +79,69 @@ typedef struct AxisDat
 
 
 
+typedef struct ExtDat
+{
+	float stepsPerMm;	// full steps per mm of filament fed
+	uint8_t microsteps;	// microstepping factor set on the MS pins (1, 2, 4, 8 or 16)
+	uint32_t pulseWidth;// step pulse high time (in uSecs)
+	bool inv;			// if true, reverses the direction pin
+	float advK;			// pressure advance coefficient (in secs of extrusion velocity). 0 disables it
+} ExtDat;
+
+
+
+
+
+
+
+#define MESH_SIZE		7	// points along each side of the bed mesh
+#define MESH_VERSION	1	// bump whenever MeshDat changes, so stale stored meshes are ignored
+
+typedef struct MeshDat
+{
+	float x0;		// X-coord of the first mesh point
+	float y0;		// Y-coord of the first mesh point
+	float pitch;	// spacing between mesh points
+	float z[MESH_SIZE][MESH_SIZE]; // measured bed height at each point, indexed [y][x]
+	bool valid;		// false until the bed has been probed
+} MeshDat;
+
+
+
+
+
+
+
 // general information
-uint64_t tickTime = 15000; // number of usecs between each time a system update tick occurs
+extern uint64_t tickTime; // number of usecs between each time a system update tick occurs
 
 
 // Axis data
-AxisDat axisADat =
-{
-	.enc = { .ppi = 200, .inv = false },
-	.mot = { .period = 7500, .low = 1000, .high = 2000, .deadband = 200, .inv = false },
-	.pid = { .kp = 0, .ki = 0, .kd = 0 },
-	.et = { .zPos = 21, .inv = true },
-	.eb = { .zPos = 2, .inv = true }, .axisX = 10, .axisY = 12
-};
+extern AxisDat axisADat;
+extern AxisDat axisBDat;
+extern AxisDat axisCDat;
 
 
-AxisDat axisBDat =
-{
-	.enc = { .ppi = 200, .inv = false },
-	.mot = { .period = 7500, .low = 1000, .high = 2000, .deadband = 200, .inv = false },
-	.pid = { .kp = 0, .ki = 0, .kd = 0 },
-	.et = { .zPos = 21, .inv = true },
-	.eb = { .zPos = 2, .inv = true }, .axisX = 10, .axisY = 12
-};
+// Extruder data
+extern ExtDat ext1Dat; // driven by the Step1 outputs
+extern ExtDat ext2Dat; // driven by the Step2 outputs
 
 
-AxisDat axisCDat =
-{
-	.enc = { .ppi = 200, .inv = false },
-	.mot = { .period = 7500, .low = 1000, .high = 2000, .deadband = 200, .inv = false },
-	.pid = { .kp = 0, .ki = 0, .kd = 0 },
-	.et = { .zPos = 21, .inv = true },
-	.eb = { .zPos = 2, .inv = true }, .axisX = 10, .axisY = 12
-};
+// Bed leveling data
+extern MeshDat bedMesh;
 
 
+// Kinematics data
+extern float kin_segRate; // number of time slices per second cartesian moves are split into
 
 
 // Thermocouple module data
-uint32_t thermo_clk = 100000;
-uint32_t thermo_bitsPerFrame = 16;
-uint32_t thermo_comMode = SSI_FRF_MOTO_MODE_3;
-float thermo_tempScl = 0.25;
+extern uint32_t thermo_clk;
+extern uint32_t thermo_bitsPerFrame;
+extern uint32_t thermo_comMode;
+extern float thermo_tempScl;
 
-void initConfig(); // loads everything from a configuration file. Probably won't get implemented till the very end!
+// initConfig() in config.h loads all of these from the on chip store or the configuration file
 
 
 
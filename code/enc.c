@@ -0,0 +1,242 @@
+/*
+ * enc.c
+ */
+
+#include "code/enc.h"
+#include "code/hwIO.h"
+#include "code/timebase.h"
+#include "code/util.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <driverlib/interrupt.h>
+#include "code/noalloc.h"
+
+EncHealth encHealth[ENC_NUM_AXES];
+
+static volatile uint32_t encSeq;	// bumped by every counted edge, on any axis
+static EncSnap encSnap;				// only written by enc_latch()
+
+static volatile uint8_t encLost;	// axes that have lost counts since they were homed
+static uint8_t encStopped;			// lost axes enc_service() has already acted on
+
+
+
+
+/**
+ * Works out the count change from the last phase to this one. The phases
+ * go 0-1-2-3-0 going forward, so the step is the difference mod 4
+ *
+ * @param axis which encoder
+ * @param phase new phase, from encQuadToState()
+ *
+ * @return +1 or -1, or 0 if the phase didn't move or skipped one
+ */
+RAMFUNC int8_t enc_edge(uint8_t axis, uint8_t phase)
+{
+	EncHealth *h = &encHealth[axis];
+	uint8_t step = (phase - h->phase) & 3;
+	uint32_t now, period;
+
+	h->phase = phase;
+
+	if(step == 0)
+	{
+		h->overruns++;
+		return 0;
+	}
+
+	if(step == 2)
+	{
+		h->illegal++;
+		encLost |= 1 << axis;
+		return 0;
+	}
+
+	now = cycleCount();
+	period = now - h->lastEdge;
+	if(h->edges && (!h->minPeriod || period < h->minPeriod)) { h->minPeriod = period; }
+
+	h->lastEdge = now;
+	h->edges++;
+	encSeq++;
+
+	return step == 1 ? 1 : -1;
+}
+
+
+
+
+/**
+ * @param phase current phase of the encoder, so the next edge decodes right
+ */
+void enc_reset(uint8_t axis, uint8_t phase)
+{
+	EncHealth *h = &encHealth[axis];
+
+	h->edges = 0;
+	h->illegal = 0;
+	h->overruns = 0;
+	h->minPeriod = 0;
+	h->phase = phase;
+}
+
+
+
+
+uint32_t enc_getMaxRate(uint8_t axis)
+{
+	uint32_t period = encHealth[axis].minPeriod;
+	return period ? timebase_getClk() / period : 0;
+}
+
+
+
+bool enc_isLost(uint8_t axis)
+{
+	return encLost & (1 << axis);
+}
+
+
+
+
+/**
+ * The health counters are kept, so the history survives the re-home. The
+ * motors aren't turned back on here, that is up to the caller (for now the
+ * "enc homed" command in tune.h, since there is no homing routine yet)
+ */
+void enc_homed(uint8_t axis)
+{
+	encStopped &= ~(1 << axis);
+	encLost &= ~(1 << axis);
+}
+
+
+
+
+/**
+ * Acts on axes that have lost counts since the last call. The motors are
+ * shut off rather than left chasing a position that is off by an unknown
+ * amount, and stay off (writeMotX() still runs, but the generators are
+ * disabled) until every lost axis has been homed again
+ */
+void enc_service()
+{
+	uint8_t lost = encLost, fresh = lost & ~encStopped, i;
+	if(!fresh) { return; }
+
+	setMotorsEnabled(false);
+	encStopped |= fresh;
+
+	for(i = 0; i < ENC_NUM_AXES; i++)
+	{
+		if(fresh & (1 << i))
+			System_printf("enc: axis%c lost counts, motors off until it is homed\n", 'A' + i);
+	}
+
+	enc_report();
+}
+
+
+
+
+void enc_report()
+{
+	uint8_t i;
+	EncSnap snap;
+
+	for(i = 0; i < ENC_NUM_AXES; i++)
+	{
+		System_printf("enc: axis%c %d edges, %d illegal, %d overruns, max %d edges/s\n", 'A' + i,
+				encHealth[i].edges, encHealth[i].illegal, encHealth[i].overruns, enc_getMaxRate(i));
+	}
+
+	enc_copySnap(&snap);
+	System_printf("enc: snapshot A %d, B %d, C %d, %d retries, %d masked\n",
+			snap.cts[ENC_AXIS_A], snap.cts[ENC_AXIS_B], snap.cts[ENC_AXIS_C], snap.retries, snap.masked);
+
+	System_flush();
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////// Snapshots /////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Copies the counts and edge times. The encoder ISRs all run at the same
+ * priority, above this, so any that come in during the copy finish before it
+ * goes on. If the sequence number is the same on both sides of the copy, no
+ * edge was counted in between, and the copy is the state as of the stamp.
+ * The window is a few dozen cycles, so a retry takes edges on several axes
+ * within well under a microsecond of each other
+ */
+RAMFUNC static bool enc_tryCopy(EncSnap *s)
+{
+	uint32_t seq = encSeq;
+
+	s->cts[ENC_AXIS_A] = encA_cts;
+	s->cts[ENC_AXIS_B] = encB_cts;
+	s->cts[ENC_AXIS_C] = encC_cts;
+	s->edge[ENC_AXIS_A] = encHealth[ENC_AXIS_A].lastEdge;
+	s->edge[ENC_AXIS_B] = encHealth[ENC_AXIS_B].lastEdge;
+	s->edge[ENC_AXIS_C] = encHealth[ENC_AXIS_C].lastEdge;
+	s->stamp = cycleCount();
+	s->seq = seq;
+
+	return encSeq == seq;
+}
+
+
+
+
+/**
+ * Latches every axis at once. If the lock free copy keeps getting
+ * interrupted, the last try is done with every interrupt masked, zero latency
+ * ones included, which holds the encoders off for about as long as the copy
+ * takes
+ */
+RAMFUNC void enc_latch()
+{
+	uint8_t i;
+	bool wasMasked;
+
+	for(i = 0; i < ENC_SNAP_TRIES; i++)
+	{
+		if(enc_tryCopy(&encSnap)) { return; }
+		encSnap.retries++;
+	}
+
+	wasMasked = IntMasterDisable();
+	enc_tryCopy(&encSnap);
+	if(!wasMasked) { IntMasterEnable(); }
+
+	encSnap.masked++;
+}
+
+
+
+
+RAMFUNC const EncSnap *enc_getSnap()
+{
+	return &encSnap;
+}
+
+
+
+
+/**
+ * Hwi_disable() holds off the servo tick, so the snapshot can't change
+ * partway through the copy
+ */
+void enc_copySnap(EncSnap *out)
+{
+	UInt key = Hwi_disable();
+	*out = encSnap;
+	Hwi_restore(key);
+}
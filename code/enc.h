@@ -0,0 +1,84 @@
+/*
+ * enc.h
+ *
+ * Quadrature decoding and health counters for the axis encoders. Every edge
+ * on either encoder pin should move the phase one step forward or back, so
+ * anything else means the ISR fell behind the encoder:
+ *
+ *  - illegal: the phase moved two steps. An edge on each pin came in before
+ *    the ISR read them, so the direction, and 2 counts, are lost
+ *  - overrun: the ISR ran and the phase hadn't moved. A pin went and came
+ *    back before it was read (or bounced). The count is still right, but the
+ *    ISR is running too close to the edge rate
+ *
+ * The shortest time between good edges is kept too, which gives the highest
+ * edge rate the axis has seen. Lost counts mean the axis position can't be
+ * trusted, so enc_service() stops the motors and holds them off until the
+ * axis is homed again
+ *
+ * The ISRs update the counts with no locking, so reading them one at a time
+ * from the servo can mix counts from before and after an edge. enc_latch()
+ * runs first thing in each servo tick, and copies all three counts, the time
+ * of each one's last edge, and the time of the copy, as one snapshot. Every
+ * counted edge bumps a sequence number, and the copy is retried if it moved
+ * while the counts were being read. The encoder ISRs are zero latency, so
+ * they can't be held off with Hwi_disable() anyway, and only get masked
+ * outright if the copy keeps getting interrupted
+ */
+
+#ifndef CODE_ENC_H_
+#define CODE_ENC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ENC_AXIS_A		0
+#define ENC_AXIS_B		1
+#define ENC_AXIS_C		2
+#define ENC_NUM_AXES	3
+
+#define ENC_SNAP_TRIES	4	// lock free copies enc_latch() tries before masking interrupts
+
+
+typedef struct EncHealth
+{
+	uint32_t edges;			// good transitions
+	uint32_t illegal;		// transitions that skipped a phase
+	uint32_t overruns;		// ISR runs with no transition
+	uint32_t minPeriod;		// shortest time between good edges (cycles), 0 if there haven't been two yet
+	uint32_t lastEdge;		// cycle count at the last good edge
+	uint8_t phase;			// phase as of the last ISR
+} EncHealth;
+
+extern EncHealth encHealth[ENC_NUM_AXES]; // only written from the encoder ISRs, and enc_reset()
+
+
+/**
+ * Encoder state at one instant
+ */
+typedef struct EncSnap
+{
+	int32_t cts[ENC_NUM_AXES];		// counts
+	uint32_t edge[ENC_NUM_AXES];	// cycle count at each axis's last good edge
+	uint32_t stamp;					// cycle count the counts were latched at
+	uint32_t seq;					// edges counted since boot, as of the latch
+	uint32_t retries;				// copies enc_latch() had to redo, since boot
+	uint32_t masked;				// times enc_latch() had to mask interrupts, since boot
+} EncSnap;
+
+
+int8_t enc_edge(uint8_t axis, uint8_t phase); // decodes a new phase from an encoder ISR, returns the count change
+void enc_reset(uint8_t axis, uint8_t phase); // clears the counters, and starts from the given phase
+
+uint32_t enc_getMaxRate(uint8_t axis); // highest edge rate seen (edges/s)
+bool enc_isLost(uint8_t axis); // true if counts have been lost since the axis was last homed
+void enc_homed(uint8_t axis); // clears the lost state. Run once the axis has been homed and its count set
+void enc_service(); // stops the motors on a newly lost axis. Run periodically from a task
+void enc_report(); // prints the counters for every axis
+
+void enc_latch(); // snapshots every axis. Run as the first servo job
+const EncSnap *enc_getSnap(); // last snapshot. Only consistent from the servo group
+void enc_copySnap(EncSnap *out); // copies the last snapshot out, from any lower priority context
+
+
+#endif /* CODE_ENC_H_ */
@@ -21,15 +21,45 @@
 #include <driverlib/ssi.h>
 #include <driverlib/pwm.h>
 #include "driverlib/interrupt.h"
+#include <inc/hw_types.h>
+#include <inc/hw_gpio.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
 #include "code/hwIO.h"
+#include "code/stepper.h"
+#include "code/config.h"
+#include "code/tune.h"
+#include "code/boot.h"
+#include "code/timebase.h"
+#include "code/isrlat.h"
+#include "code/enc.h"
+#include "code/pool.h"
+#include "code/prof.h"
+#include "code/pins.h"
+#include <ti/sysbios/knl/Task.h>
+#include "code/noalloc.h"
+
+#define HWIO_SWAP_WAIT	10		// ms hwIO_applyConfig() waits for the servo tick to take new settings
+
+volatile int32_t encA_cts;
+volatile int32_t encB_cts;
+volatile int32_t encC_cts;
+
+int32_t encA_cts_prev;
+int32_t encB_cts_prev;
+int32_t encC_cts_prev;
+
+static float thermoTemps[2];	// last reading of each thermocouple module, from hwIO_pollThermo()
+static bool motEnabled;			// last state set with setMotorsEnabled()
 
 
 /**
- * Initializes all of the board peripherals, such as GPIOs, PWMs, etc.
- * This is essentially the global board initialization routine.
+ * Initializes everything needed to hold the machine safe and start the servo.
+ * This is the critical part of the board initialization, and runs from main()
+ * before BIOS starts. Anything that can wait goes in hwIO_init_late().
  *
- * NOTE: if using initConfig() in dat.h, that should go after the SD init
- * routines and berfore all the other ones
+ * NOTE: the motion init routines run off the compiled in defaults in dat.c.
+ * Loading the config waits for hwIO_init_late(), which applies it over them
  */
 void hwIO_init()
 {
@@ -37,12 +67,20 @@ void hwIO_init()
 	uint32_t foo = 0;
 	foo =	SysCtlClockFreqSet(SYSCTL_CFG_VCO_480 | SYSCTL_USE_PLL | SYSCTL_XTAL_25MHZ | SYSCTL_OSC_MAIN, 120000000);
 
-	usecsToClockCycles(foo);
+	// cache it for all of the timing math, since SysCtlClockGet() doesn't work on this part
+	timebase_init(foo);
+
+	// start timing the boot. This also starts the cycle counter used for profiling
+	boot_start();
+
+	// memory pools, before anything can allocate from them
+	pool_initAll();
 
 
 	// enable the GPIOs
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOC);
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOD);
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOE);
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOF);
@@ -55,22 +93,24 @@ void hwIO_init()
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOP);
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOQ);
 
-	// Enable the other peripherals
+	// Enable the peripherals needed for motion. The rest wait for hwIO_init_late()
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER3);
-	SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI1);
-	SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI3);
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER5);
 	SysCtlPeripheralEnable(SYSCTL_PERIPH_PWM0);
-	SysCtlPeripheralEnable(SYSCTL_PERIPH_EMAC0);
-	SysCtlPeripheralEnable(SYSCTL_PERIPH_EPHY0);
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_EEPROM0);
 
 	// Setup the FPU, with lazy stacking
 	FPUEnable();
 	FPULazyStackingEnable();
 
+	// start the system time clock, for currTime()
+	timebase_startTimer();
+
 
 	// run the GPIO init routines
 	hwIO_init_portA();
 	hwIO_init_portB();
+	hwIO_init_portC();
 	hwIO_init_portD();
 	hwIO_init_portE();
 	hwIO_init_portF();
@@ -83,407 +123,227 @@ void hwIO_init()
 	hwIO_init_portP();
 	hwIO_init_portQ();
 
-	// run any other init() routines
-	//hwIO_init_SD();
-	hwIO_init_Thermo();
-	hwIO_init_PWM();
-}
-
+	// start decoding from wherever the encoder is sitting
+	enc_reset(ENC_AXIS_A, encQuadToState(PIN_READ(AXA_ENCA), PIN_READ(AXA_ENCB)));
 
+	// the outputs all come up low (heaters off). Make sure the motor pulses are too
+	setMotorsEnabled(false);
+	boot_mark(BOOT_MARK_SAFE);
 
+	// run the motion init() routines, on the compiled in defaults
+	tune_init();
+	hwIO_init_PWM();
+	stepper_init(foo);
+	boot_mark(BOOT_MARK_MOTION);
+}
 
 
-///////////////////////////////////////////////////////////////////////////
-////////////////////////////// GPIO Port Init /////////////////////////////
-///////////////////////////////////////////////////////////////////////////
 
 
-/*
- * CONTENTS:
- * LED1 - pin4 - out
- * Step1.en - pin5 - out
- * GPIO_GEN_5 - pin6 - in
+/**
+ * Initializes everything that isn't needed to move, from boot_lateTask()
+ * once BIOS is running. The config is loaded and applied over the defaults
+ * the motion init ran on, then networking, the thermocouples and the UART
+ * come up
  */
-void hwIO_init_portA()
+void hwIO_init_late()
 {
-	GPIODirModeSet(GPIO_PORTA_BASE, // outputs
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_DIR_MODE_OUT );
-
-	GPIODirModeSet(GPIO_PORTA_BASE, // inputs
-			GPIO_PIN_6,
-			GPIO_DIR_MODE_IN );
-
-	GPIOPadConfigSet(GPIO_PORTA_BASE, // setup the outputs
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
-
-	GPIOPadConfigSet(GPIO_PORTA_BASE, // setup the inputs
-			GPIO_PIN_6,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD_WPU);
-
-	GPIOIntEnable(GPIO_PORTA_BASE, //enable interrupts
-			GPIO_PIN_6);
-
-	GPIOIntTypeSet(GPIO_PORTA_BASE, // set interrupt mode tto both edges
-			GPIO_PIN_6,
-			GPIO_BOTH_EDGES);
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI3);
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_EMAC0);
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_EPHY0);
+
+	// the on chip store is tried first. If that had a good copy, check the
+	// file on the SD card for edits since
+	hwIO_init_SD();
+	if(initConfig() == CONFIG_SRC_NV) { config_syncSD(); }
+	hwIO_applyConfig();
+	boot_mark(BOOT_MARK_CONFIG);
+
+	hwIO_init_EMAC();
+	hwIO_init_UART();
+	hwIO_init_Thermo();
 }
 
 
 
 
-/*
- * CONTENTS:
- * GPIO_GEN_1 - pin2 - in
- * GPIO_GEN_2 - pin3 - in
- * SD.CS - pin4 - HW
- * SD.CLK - pin5 - HW
+/**
+ * Puts freshly loaded config variables into effect. The motor outputs are
+ * held off while the PWM generators are set up again, and the servo tick
+ * picks up the new axis settings at its next tick. Nothing may be moving
  */
-void hwIO_init_portB()
+void hwIO_applyConfig()
 {
-	GPIODirModeSet(GPIO_PORTB_BASE, // HW
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_DIR_MODE_HW );
-
-	GPIODirModeSet(GPIO_PORTB_BASE, // inputs
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_DIR_MODE_IN );
-
-	GPIOPinTypeSSI(GPIO_PORTB_BASE, // setup the HW pins as SSI, for the SD Card
-			GPIO_PIN_4 |
-			GPIO_PIN_5);
-
-	// configure the pin config to use the SSI pins for the SD card
-	GPIOPinConfigure(GPIO_PB4_SSI1FSS);
-	GPIOPinConfigure(GPIO_PB5_SSI1CLK);
-
-	GPIOPadConfigSet(GPIO_PORTB_BASE, // setup the inputs
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD_WPU);
-
-	GPIOIntEnable(GPIO_PORTB_BASE, //enable interrupts
-			GPIO_PIN_2 |
-			GPIO_PIN_3);
-
-	GPIOIntTypeSet(GPIO_PORTB_BASE, // set interrupt mode to both edges
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_BOTH_EDGES);
-
-	// bind input interrupts
-//	GPIOIntRegister(GPIO_PORTB_BASE, &portB_ISR);
-}
+	bool wasEnabled = motEnabled;
+	uint32_t swaps = tune_getSwaps(), waited;
 
+	setMotorsEnabled(false);
 
+	// the outputs are set up from the live settings, so give the servo tick
+	// a few ms to take the new ones first
+	tune_reload();
+	for(waited = 0; tune_getSwaps() == swaps && waited < HWIO_SWAP_WAIT; waited++)
+		Task_sleep(1);
 
+	hwIO_init_PWM();
+	stepper_loadConfig();
 
+	setMotorsEnabled(wasEnabled);
+}
 
-/*
- * CONTENTS:
- * AxB.et - pin0 - in
- * AxA.encB - pin1 - in
- * Step1.dir - pin4 - out
- * Step1.step - pin5 - HW
- * AIN_GEN_1 - pin7 - analog
- */
-void hwIO_init_portD()
-{
-	GPIODirModeSet(GPIO_PORTD_BASE, // HW
-			GPIO_PIN_5,
-			GPIO_DIR_MODE_HW );
 
-	GPIODirModeSet(GPIO_PORTD_BASE, // inputs
-			GPIO_PIN_0 |
-			GPIO_PIN_1,
-			GPIO_DIR_MODE_IN );
 
-	GPIOPinTypeTimer(GPIO_PORTD_BASE, // setup the HW pin as a timer CCP
-			GPIO_PIN_5);
 
-	// configure the pin config to use the SSI pins for the SD card
-	GPIOPinConfigure(GPIO_PD5_T3CCP1);
 
-	GPIOPadConfigSet(GPIO_PORTD_BASE, // setup the inputs
-			GPIO_PIN_0 |
-			GPIO_PIN_1,
-			GPIO_STRENGTH_4MA,
-			GPIO_PIN_TYPE_STD_WPU);
+///////////////////////////////////////////////////////////////////////////
+////////////////////////////// GPIO Port Init /////////////////////////////
+///////////////////////////////////////////////////////////////////////////
 
-	GPIOPinTypeADC(GPIO_PORTD_BASE, // enable pin 7 as analog input
-			GPIO_PIN_7);
 
-	GPIOIntEnable(GPIO_PORTD_BASE, //enable interrupts
-			GPIO_PIN_0 |
-			GPIO_PIN_1);
+// Pin setup for each port comes from the pin table in pins.h
 
-	GPIOIntTypeSet(GPIO_PORTD_BASE, // set interrupt mode to both edges
-			GPIO_PIN_0 |
-			GPIO_PIN_1,
-			GPIO_BOTH_EDGES);
+void hwIO_init_portA() { pins_initPort(GPIO_PORTA_BASE); }
+void hwIO_init_portB() { pins_initPort(GPIO_PORTB_BASE); }
+void hwIO_init_portC() { pins_initPort(GPIO_PORTC_BASE); }
+void hwIO_init_portD() { pins_initPort(GPIO_PORTD_BASE); }
+void hwIO_init_portE() { pins_initPort(GPIO_PORTE_BASE); }
+void hwIO_init_portF() { pins_initPort(GPIO_PORTF_BASE); }
+void hwIO_init_portG() { pins_initPort(GPIO_PORTG_BASE); }
+void hwIO_init_portH() { pins_initPort(GPIO_PORTH_BASE); }
+void hwIO_init_portK() { pins_initPort(GPIO_PORTK_BASE); }
+void hwIO_init_portL() { pins_initPort(GPIO_PORTL_BASE); }
+void hwIO_init_portM() { pins_initPort(GPIO_PORTM_BASE); }
+void hwIO_init_portN() { pins_initPort(GPIO_PORTN_BASE); }
+void hwIO_init_portP() { pins_initPort(GPIO_PORTP_BASE); }
+void hwIO_init_portQ() { pins_initPort(GPIO_PORTQ_BASE); }
 
-	// bind input interrupts
-//	GPIOIntRegister(GPIO_PORTD_BASE, &portD_ISR);
-}
 
 
 
+/////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// Other INITs ///////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
 
 /**
- * CONTENTS:
- * AIN_GEN_5 - pin0 - analog
- * AIN_GEN_4 - pin1 - analog
- * AIN_GEN_3 - pin2 - analog
- * AIN_GEN_2 - pin3 - analog
- * SD.MOSI - pin4 - HW
- * SD.MISO - pin5 - HW
+ * Initializes the SD card SPI driver. The card itself is mounted by SD_mount()
  */
-void hwIO_init_portE()
+void hwIO_init_SD()
 {
-	GPIODirModeSet(GPIO_PORTE_BASE, // HW
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_DIR_MODE_HW );
-
-	GPIOPinTypeADC(GPIO_PORTE_BASE, // analog
-			GPIO_PIN_0 |
-			GPIO_PIN_1 |
-			GPIO_PIN_2 |
-			GPIO_PIN_3);
-
-	GPIOPinTypeSSI(GPIO_PORTE_BASE, // setup the HW pins as SSI, for the SD Card
-			GPIO_PIN_4 |
-			GPIO_PIN_5);
-
-	// configure the pin config to use the SSI pins for the SD card
-	GPIOPinConfigure(GPIO_PE4_SSI1XDAT0);
-	GPIOPinConfigure(GPIO_PE5_SSI1XDAT1);
+	Board_initSDSPI();
 }
 
 
 
 
 /**
- * CONTENTS:
- * AxB.Mot - pin1 - PWM
- * AxA.Mot - pin2 - PWM
- * AxC.Mot - pin3 - PWM
+ * Initializes the ethernet driver, for the NDK stack
  */
-void hwIO_init_portF()
+void hwIO_init_EMAC()
 {
-	GPIOPinTypePWM(GPIO_PORTF_BASE,
-			GPIO_PIN_1 |
-			GPIO_PIN_2 |
-			GPIO_PIN_3);
-
-	// configure the pin config to use PWM for te pins
-	GPIOPinConfigure(GPIO_PF1_M0PWM1);
-	GPIOPinConfigure(GPIO_PF2_M0PWM2);
-	GPIOPinConfigure(GPIO_PF3_M0PWM3);
+	Board_initEMAC();
 }
 
 
 
 
-
 /**
- * CONTENTS:
- * Hotend1 - pin1 - out
+ * Initializes the UART driver. UART0 is used by the tuning service
  */
-void hwIO_init_portG()
+void hwIO_init_UART()
 {
-	// configure pin 1 as an 8ma output
-	GPIODirModeSet(GPIO_PORTG_BASE,
-			GPIO_PIN_1,
-			GPIO_DIR_MODE_OUT);
-
-	GPIOPadConfigSet(GPIO_PORTG_BASE,
-			GPIO_PIN_1,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
+	Board_initUART();
 }
 
 
 
 
 
-/*
- * CONTENTS:
- * Step2.MS3 - pin0 - out
- * Step2.MS2 - pin1 - out
- * AxA.eb - pin2 - in
- * AxA.encA - pin 3 - in
+/**
+ * Initialized the thermocouple bank. Clock speeds and other parameters are set
+ * in dat.h
  */
-void hwIO_init_portH()
+void hwIO_init_Thermo()
 {
-	GPIODirModeSet(GPIO_PORTH_BASE, // outputs
-			GPIO_PIN_0 |
-			GPIO_PIN_1,
-			GPIO_DIR_MODE_OUT );
-
-	GPIODirModeSet(GPIO_PORTH_BASE, // inputs
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_DIR_MODE_IN );
-
-	GPIOPadConfigSet(GPIO_PORTH_BASE, // setup the outputs
-			GPIO_PIN_0 |
-			GPIO_PIN_1,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
-
-	GPIOPadConfigSet(GPIO_PORTH_BASE, // setup the inputs
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_STRENGTH_4MA,
-			GPIO_PIN_TYPE_STD_WPU);
-
-	GPIOIntEnable(GPIO_PORTH_BASE, //enable interrupts
-			GPIO_PIN_2 |
-			GPIO_PIN_3);
-
-	GPIOIntTypeSet(GPIO_PORTH_BASE, // set interrupt mode to both edges
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_BOTH_EDGES);
-
-	// bind input interrupts
-//	GPIOIntRegister(GPIO_PORTH_BASE, &portH_ISR);
-}
-
-
-
-
+	SSIConfigSetExpClk(SSI3_BASE,
+			timebase_getClk(),
+			thermo_comMode,
+			SSI_MODE_MASTER,
+			thermo_clk,
+			thermo_bitsPerFrame);
 
+	// turn off both modules to start off
+	PIN_WRITE(THERMO1_SEL, 1);
+	PIN_WRITE(THERMO2_SEL, 1);
 
-/*
- * CONTENTS:
- * Thermist1 - pin0 - analog
- * Thermist2 - pin1 - analog
- * LED3 - pin2 - out
- * LED2 - pin3 - out
- * Hotend2 - pin4 - out
- * Bed - pin5 - out
- * Step2.MS1 - pin6 - out
- * Step2.en - pin7 - out
- */
-void hwIO_init_portK()
-{
-	GPIODirModeSet(GPIO_PORTK_BASE, // outputs
-			GPIO_PIN_2 |
-			GPIO_PIN_3 |
-			GPIO_PIN_4 |
-			GPIO_PIN_5 |
-			GPIO_PIN_6 |
-			GPIO_PIN_7,
-			GPIO_DIR_MODE_OUT );
-
-
-	GPIOPadConfigSet(GPIO_PORTK_BASE, // setup the outputs
-			GPIO_PIN_2 |
-			GPIO_PIN_3 |
-			GPIO_PIN_4 |
-			GPIO_PIN_5 |
-			GPIO_PIN_6 |
-			GPIO_PIN_7,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
-
-	GPIOPinTypeADC(GPIO_PORTK_BASE, // setup the analog inputs
-			GPIO_PIN_0 |
-			GPIO_PIN_1);
+//	SSIEnable(SSI3_BASE);
 }
 
 
 
 
 
-/*
- * CONTENTS:
- * AxC.encA - pin0 - in
- * AxC.encB - pin1 - in
- * AxC.eb - pin2 - in
- * AxC.et - pin3 - in
- * proxSensor - pin4 - in
+/**
+ * Converts a motor period to PWM generator counts, clamped to what the 16 bit
+ * counter can hold
  */
-void hwIO_init_portL()
+static uint32_t hwIO_pwmPeriod(uint32_t usecs)
 {
-	GPIODirModeSet(GPIO_PORTL_BASE, // inputs
-			GPIO_PIN_0 |
-			GPIO_PIN_1 |
-			GPIO_PIN_2 |
-			GPIO_PIN_3 |
-			GPIO_PIN_4,
-			GPIO_DIR_MODE_IN );
-
-
-	GPIOPadConfigSet(GPIO_PORTL_BASE, // setup the inputs
-			GPIO_PIN_0 |
-			GPIO_PIN_1 |
-			GPIO_PIN_2 |
-			GPIO_PIN_3 |
-			GPIO_PIN_4,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD_WPU);
-
-	// bind input interrupts
-//	GPIOIntRegister(GPIO_PORTL_BASE, &portL_ISR);
-}
+	uint32_t ticks = timebase_usToPwm(usecs);
 
+	if(ticks > 0xffff)
+	{
+		System_printf("hwIO: motor PWM period too long, clamped\n");
+		ticks = 0xffff;
+	}
 
+	return ticks;
+}
 
 
 
 
-/*
- * CONTENTS:
- * Step2.dir - pin1 - out
- * Step2.step - pin2 - TIMER PWM
- * AxA.et - pin3 - in
- * GPIO_GEN_4 - pin4 - in
- * GPIO_GEN_3 - pin5 - in
+/**
+ * Initializes the PWM Outputs. Generator 0 drives axis B, and generator 1
+ * axes A and C, so each generator runs at its own axes' period (A and C are
+ * checked to match by the config). That way an axis can be in RC mode on a
+ * long period while another runs an H-bridge at 20kHz or more. The PWM clock
+ * divider is shared though, so it is picked to fit the longer period
  */
-void hwIO_init_portM()
+void hwIO_init_PWM()
 {
-	GPIODirModeSet(GPIO_PORTM_BASE, // input
-			GPIO_PIN_3 |
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_DIR_MODE_IN );
-
-	GPIOPadConfigSet(GPIO_PORTM_BASE, // setup the input
-			GPIO_PIN_3 |
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD_WPU);
+	static const uint32_t divCfg[] =
+	{
+		PWM_SYSCLK_DIV_1, PWM_SYSCLK_DIV_2, PWM_SYSCLK_DIV_4, PWM_SYSCLK_DIV_8,
+		PWM_SYSCLK_DIV_16, PWM_SYSCLK_DIV_32, PWM_SYSCLK_DIV_64
+	};
 
+	uint32_t longest = axisADat.mot.period > axisBDat.mot.period ? axisADat.mot.period : axisBDat.mot.period;
 
-	GPIODirModeSet(GPIO_PORTM_BASE, // output
-			GPIO_PIN_1,
-			GPIO_DIR_MODE_OUT );
+	// the generator counters are 16 bits, so slow the PWM clock down until the period fits
+	uint32_t cycles = timebase_usToCycles(longest);
+	uint32_t div = 1, i = 0;
 
-	GPIOPadConfigSet(GPIO_PORTM_BASE, // setup the output
-			GPIO_PIN_1,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
+	while(div < TIMEBASE_PWM_MAX_DIV && cycles / div > 0xffff)
+	{
+		div <<= 1;
+		i++;
+	}
 
+	PWMClockSet(PWM0_BASE, divCfg[i]);
+	timebase_setPwmDiv(div);
 
-	GPIOPinTypeTimer(GPIO_PORTM_BASE, // setup the timer PWM pin
-			GPIO_PIN_2);
+	// setup generators 0 and 1
+	PWMGenConfigure(PWM0_BASE, PWM_GEN_0, PWM_GEN_MODE_DOWN | PWM_GEN_MODE_NO_SYNC);
+	PWMGenConfigure(PWM0_BASE, PWM_GEN_1, PWM_GEN_MODE_DOWN | PWM_GEN_MODE_NO_SYNC);
 
-	GPIOPinConfigure(GPIO_PM2_T3CCP0);
+	//set the periods
+	PWMGenPeriodSet(PWM0_BASE, PWM_GEN_0, hwIO_pwmPeriod(axisBDat.mot.period));
+	PWMGenPeriodSet(PWM0_BASE, PWM_GEN_1, hwIO_pwmPeriod(axisADat.mot.period));
 
-	// bind input interrupts
-//	GPIOIntRegister(GPIO_PORTM_BASE, &portM_ISR);
+	// set to a safe starting value
+	writeMotA(0);
+	writeMotB(0);
+	writeMotC(0);
 }
 
 
@@ -491,284 +351,187 @@ void hwIO_init_portM()
 
 
 
-/*
- * CONTENTS:
- * AxB.eb - pin2 - in
- * AxB.encA - pin3 - in
- * Step1.MS1 - pin4 - out
- * Step1.MS2 - pin5 - out
- */
-void hwIO_init_portN()
-{
-	GPIODirModeSet(GPIO_PORTN_BASE, // input
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_DIR_MODE_IN );
-
-	GPIOPadConfigSet(GPIO_PORTN_BASE, // setup the input
-			GPIO_PIN_2 |
-			GPIO_PIN_3,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD_WPU);
-
-
-	GPIODirModeSet(GPIO_PORTN_BASE, // output
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_DIR_MODE_OUT );
-
-	GPIOPadConfigSet(GPIO_PORTN_BASE, // setup the output
-			GPIO_PIN_4 |
-			GPIO_PIN_5,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
-
-	// bind input interrupts
-//	GPIOIntRegister(GPIO_PORTN_BASE, &portN_ISR);
-}
-
-
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////// raw ISRs ////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
 
 
-/*
- * CONTENTS:
- * AxB.encB - pin2 - in
- * Thermo1.sel - pin3 - out
- * Step1.MS3 - pin4 - out
+/**
+ * Pin handlers for each port. A handler runs when any of its pins has a
+ * pending interrupt, and gets the port's pin states as they were read at the
+ * start of the dispatch
  */
-void hwIO_init_portP()
+RAMDATA static const GpioDisp portADisp[] =
 {
-	GPIODirModeSet(GPIO_PORTP_BASE, // input
-			GPIO_PIN_2,
-			GPIO_DIR_MODE_IN );
-
-	GPIOPadConfigSet(GPIO_PORTP_BASE, // setup the input
-			GPIO_PIN_2,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD_WPU);
-
-
-	GPIODirModeSet(GPIO_PORTP_BASE, // output
-			GPIO_PIN_3 |
-			GPIO_PIN_4,
-			GPIO_DIR_MODE_OUT );
-
-	GPIOPadConfigSet(GPIO_PORTP_BASE, // setup the output
-			GPIO_PIN_3 |
-			GPIO_PIN_4,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
-
-	// bind input interrupts
-//	GPIOIntRegister(GPIO_PORTP_BASE, &portP_ISR);
-}
-
-
-
+	{ PIN_MASK_GEN5,				gpio_gen5_ISR },	// GPIO_GEN_5
+};
 
-
-/*
- * CONTENTS:
- * Thermo.CLK - pin0 - HW
- * Thermo2.sel - pin1 - out
- * Thermo.DAT - pin3 - HW
- */
-void hwIO_init_portQ()
+RAMDATA static const GpioDisp portBDisp[] =
 {
-	GPIODirModeSet(GPIO_PORTQ_BASE, // output
-			GPIO_PIN_1,
-			GPIO_DIR_MODE_OUT );
-
-	GPIOPadConfigSet(GPIO_PORTN_BASE, // setup the output
-			GPIO_PIN_1,
-			GPIO_STRENGTH_8MA,
-			GPIO_PIN_TYPE_STD);
-
-
-	// setup the SSI pins
-	GPIOPinTypeSSI(GPIO_PORTQ_BASE,
-			GPIO_PIN_0 |
-			GPIO_PIN_3);
-
-	GPIOPinConfigure(GPIO_PQ0_SSI3CLK);
-	GPIOPinConfigure(GPIO_PQ3_SSI3XDAT1);
-}
+	{ PIN_MASK_GEN1,				gpio_gen1_ISR },	// GPIO_GEN_1
+	{ PIN_MASK_GEN2,				gpio_gen2_ISR },	// GPIO_GEN_2
+};
 
+RAMDATA static const GpioDisp portDDisp[] =
+{
+	{ PIN_MASK_AXB_ET,			axisB_et_ISR },		// top endstop of axis B
+	{ PIN_MASK_AXA_ENCB,			axisA_enc_ISR },	// encoder A, channel B
+};
 
+RAMDATA static const GpioDisp portHDisp[] =
+{
+	{ PIN_MASK_AXA_EB,			axisA_eb_ISR },		// bottom endstop of axis A
+	{ PIN_MASK_AXA_ENCA,			axisA_enc_ISR },	// encoder A, channel A
+};
 
+RAMDATA static const GpioDisp portLDisp[] =
+{
+	{ PIN_MASK_AXC_ENCA | PIN_MASK_AXC_ENCB,	axisC_enc_ISR },	// encoder C
+	{ PIN_MASK_AXC_EB,			axisC_eb_ISR },		// bottom endstop of axis C
+	{ PIN_MASK_AXC_ET,			axisC_et_ISR },		// top endstop of axis C
+	{ PIN_MASK_PROX,				proxSensor_ISR },	// proximity sensor
+};
 
-/////////////////////////////////////////////////////////////////////////////////
-///////////////////////////////// Other INITs ///////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////
+RAMDATA static const GpioDisp portMDisp[] =
+{
+	{ PIN_MASK_AXA_ET,			axisA_et_ISR },		// top endstop of axis A
+	{ PIN_MASK_GEN4,				gpio_gen4_ISR },	// GPIO_GEN_4
+	{ PIN_MASK_GEN3,				gpio_gen3_ISR },	// GPIO_GEN_3
+};
 
-/**
- * Initialized the thermocouple bank. Clock speeds and other parameters are set
- * in dat.h
- */
-void hwIO_init_Thermo()
+RAMDATA static const GpioDisp portNDisp[] =
 {
-	SSIConfigSetExpClk(SSI3_BASE,
-			SysCtlClockGet(),
-			thermo_comMode,
-			SSI_MODE_MASTER,
-			thermo_clk,
-			thermo_bitsPerFrame);
+	{ PIN_MASK_AXB_EB,			axisB_eb_ISR },		// bottom endstop of axis B
+	{ PIN_MASK_AXB_ENCA,			axisB_enc_ISR },	// Axis B encoder
+};
 
-	// turn off both modules to start off
-	GPIOPinWrite(GPIO_PORTP_BASE, GPIO_PIN_3, GPIO_PIN_3);
-	GPIOPinWrite(GPIO_PORTQ_BASE, GPIO_PIN_1, GPIO_PIN_1);
+RAMDATA static const GpioDisp portPDisp[] =
+{
+	{ PIN_MASK_AXB_ENCB,			axisB_enc_ISR },	// Axis B encoder
+};
 
-//	SSIEnable(SSI3_BASE);
-}
+#define GPIO_DISP_LEN(tbl) (sizeof(tbl) / sizeof(tbl[0]))
 
+volatile uint32_t gpio_spurious; // interrupts on pins no handler owns
 
 
 
 
 /**
- * Initializes the PWM Outputs
+ * Handles one port interrupt. The masked status is read once, and only the
+ * bits that were set are cleared, before the pins are read. An edge that
+ * comes in after that point sets its bit again and re-enters the ISR,
+ * instead of being wiped out by a blanket clear
+ *
+ * @param base GPIO port base address
+ * @param tbl the port's pin handlers
+ * @param n number of entries in tbl
  */
-void hwIO_init_PWM()
+RAMFUNC static inline void gpio_dispatch(uint32_t base, const GpioDisp *tbl, uint8_t n)
 {
-	uint32_t periodTicks = usecsToClockCycles(axisADat.mot.period);
+	uint32_t mis = HWREG(base + GPIO_O_MIS), owned = 0;
+	uint8_t i;
 
-	// setup generators 0 and 1
-	PWMGenConfigure(PWM0_BASE, PWM_GEN_0, PWM_GEN_MODE_DOWN | PWM_GEN_MODE_SYNC);
-	PWMGenConfigure(PWM0_BASE, PWM_GEN_1, PWM_GEN_MODE_DOWN | PWM_GEN_MODE_SYNC);
+	HWREG(base + GPIO_O_ICR) = mis;
+	uint32_t pins = HWREG(base + GPIO_O_DATA + (0xff << 2)); // address bits 9:2 mask the read, all 8 pins
 
-	//set the periods
-	PWMGenPeriodSet(PWM0_BASE, PWM_GEN_0, periodTicks);
-	PWMGenPeriodSet(PWM0_BASE, PWM_GEN_1, periodTicks);
+	for(i = 0; i < n; i++)
+	{
+		owned |= tbl[i].pins;
+		if(mis & tbl[i].pins) { tbl[i].fxn(pins); }
+	}
 
-	// set to a safe starting value
-	writeMotA(0);
-	writeMotB(0);
-	writeMotC(0);
+	// nothing services these, so they are cleared anyway, or they would fire forever
+	if(mis & ~owned) { gpio_spurious++; }
 }
 
 
 
 
-
-
-/////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////// raw ISRs ////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////
-
-
-void portA_ISR() // handles and directs all interrupts on port A
+RAMFUNC void portA_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTA_BASE, true);
-
-	GPIOIntClear(GPIO_PORTA_BASE, 0xff); // clear interrupt status
-
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & GPIO_PIN_6) { gpio_gen5_ISR(); }  // GPIO_GEN_5
+	ISRLAT_ENTER(ISRLAT_PORTA);
+	gpio_dispatch(GPIO_PORTA_BASE, portADisp, GPIO_DISP_LEN(portADisp));
 }
 
 
 
-void portB_ISR() // handles and directs all interrupts on port B
+RAMFUNC void portB_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTB_BASE, true);
-
-	GPIOIntClear(GPIO_PORTB_BASE, 0xff); // clear interrupt status
-
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & GPIO_PIN_2) { gpio_gen1_ISR(); }  // GPIO_GEN_1
-	if(intStat & GPIO_PIN_3) { gpio_gen2_ISR(); }  // GPIO_GEN_1
+	ISRLAT_ENTER(ISRLAT_PORTB);
+	gpio_dispatch(GPIO_PORTB_BASE, portBDisp, GPIO_DISP_LEN(portBDisp));
 }
 
 
 
-void portD_ISR() // handles and directs all interrupts on port D
+RAMFUNC void portD_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTD_BASE, true);
+	ISRLAT_ENTER(ISRLAT_PORTD);
+	uint32_t t = PROF_BEGIN();
 
-	GPIOIntClear(GPIO_PORTD_BASE, 0xff); // clear interrupt status
+	gpio_dispatch(GPIO_PORTD_BASE, portDDisp, GPIO_DISP_LEN(portDDisp));
 
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & GPIO_PIN_0) { axisB_et_ISR(); }  // top endstop of axis B
-	if(intStat & GPIO_PIN_3) { axisA_enc_ISR(); }  // encoder A
+	PROF_END(PROF_PORT, t);
 }
 
 
 
-void portH_ISR() // handles and directs all interrupts on port H
+RAMFUNC void portH_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTH_BASE, true);
+	ISRLAT_ENTER(ISRLAT_PORTH);
+	uint32_t t = PROF_BEGIN();
 
-	GPIOIntClear(GPIO_PORTH_BASE, 0xff); // clear interrupt status
+	gpio_dispatch(GPIO_PORTH_BASE, portHDisp, GPIO_DISP_LEN(portHDisp));
 
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & GPIO_PIN_2) { axisA_eb_ISR(); }  // bottom endstop of axis A
-	if(intStat & GPIO_PIN_3) { axisA_enc_ISR(); }  // encoder A
+	PROF_END(PROF_PORT, t);
 }
 
 
 
-
-void portL_ISR() // handles and directs all interrupts on port L
+RAMFUNC void portL_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTL_BASE, true);
+	ISRLAT_ENTER(ISRLAT_PORTL);
+	uint32_t t = PROF_BEGIN();
 
-	GPIOIntClear(GPIO_PORTL_BASE, 0xff); // clear interrupt status
+	gpio_dispatch(GPIO_PORTL_BASE, portLDisp, GPIO_DISP_LEN(portLDisp));
 
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & (GPIO_PIN_0 || GPIO_PIN_1)) { axisC_enc_ISR(); }  // encoder C
-	if(intStat & GPIO_PIN_2) { axisC_eb_ISR(); }  // bottom endstop of axis C
-	if(intStat & GPIO_PIN_3) { axisC_et_ISR(); }  // top endstop of axis C
-	if(intStat & GPIO_PIN_4) { proxSensor_ISR(); }  // proximity sensor
+	PROF_END(PROF_PORT, t);
 }
 
 
 
-void portM_ISR() // handles and directs all interrupts on port M
+RAMFUNC void portM_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTM_BASE, true);
+	ISRLAT_ENTER(ISRLAT_PORTM);
+	uint32_t t = PROF_BEGIN();
 
-	GPIOIntClear(GPIO_PORTM_BASE, 0xff); // clear interrupt status
+	gpio_dispatch(GPIO_PORTM_BASE, portMDisp, GPIO_DISP_LEN(portMDisp));
 
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & GPIO_PIN_3) { axisA_et_ISR(); }  // top endstop of axis A
-	if(intStat & GPIO_PIN_4) { gpio_gen4_ISR(); }  // GPIO_GEN_4
-	if(intStat & GPIO_PIN_5) { gpio_gen3_ISR(); }  // GPIO_GEN_3
+	PROF_END(PROF_PORT, t);
 }
 
 
 
-
-
-void portN_ISR() // handles and directs all interrupts on port N
+RAMFUNC void portN_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTN_BASE, true);
+	ISRLAT_ENTER(ISRLAT_PORTN);
+	uint32_t t = PROF_BEGIN();
 
-	GPIOIntClear(GPIO_PORTN_BASE, 0xff); // clear interrupt status
+	gpio_dispatch(GPIO_PORTN_BASE, portNDisp, GPIO_DISP_LEN(portNDisp));
 
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & GPIO_PIN_2) { axisB_eb_ISR(); }  // bottom endstop of axis B
-	if(intStat & GPIO_PIN_3) { axisB_enc_ISR(); }  // Axis B encoder
+	PROF_END(PROF_PORT, t);
 }
 
 
 
-
-void portP_ISR() // handles and directs all interrupts on port P
+RAMFUNC void portP_ISR()
 {
-	// read the masked interrupt status
-	uint32_t intStat = GPIOIntStatus(GPIO_PORTP_BASE, true);
+	ISRLAT_ENTER(ISRLAT_PORTP);
+	uint32_t t = PROF_BEGIN();
 
-	GPIOIntClear(GPIO_PORTP_BASE, 0xff); // clear interrupt status
+	gpio_dispatch(GPIO_PORTP_BASE, portPDisp, GPIO_DISP_LEN(portPDisp));
 
-	//see which interrupts have fired, and run an corresponding handlers
-	if(intStat & GPIO_PIN_2) { axisB_enc_ISR(); }  // Axis B encoder
+	PROF_END(PROF_PORT, t);
 }
 
 
@@ -787,7 +550,7 @@ void portP_ISR() // handles and directs all interrupts on port P
  * A,!B = 3
  *
  */
-uint8_t encQuadToState(bool pinA, bool pinB)
+RAMFUNC uint8_t encQuadToState(bool pinA, bool pinB)
 {
 	uint8_t phase;
 
@@ -804,11 +567,11 @@ uint8_t encQuadToState(bool pinA, bool pinB)
 /////////////////// Specific ISRs ///////////////////
 
 // General GPIO ISRs. Change the implementation of these as needed
-void gpio_gen1_ISR();
-void gpio_gen2_ISR();
-void gpio_gen3_ISR();
-void gpio_gen4_ISR();
-void gpio_gen5_ISR();
+void gpio_gen1_ISR(uint32_t pins);
+void gpio_gen2_ISR(uint32_t pins);
+void gpio_gen3_ISR(uint32_t pins);
+void gpio_gen4_ISR(uint32_t pins);
+void gpio_gen5_ISR(uint32_t pins);
 
 
 /** Encoder ISRs
@@ -816,50 +579,43 @@ void gpio_gen5_ISR();
  *  These run whenever either pin updates. They read both pins and update the encoder accordingly
  */
 
-void axisA_enc_ISR()
+RAMFUNC void axisA_enc_ISR(uint32_t pins)
 {
-	static uint8_t prev = 0;
+	uint32_t t = PROF_BEGIN();
 
-	// read pin states
-	bool pinA = GPIOPinRead(GPIO_PORTH_BASE, GPIO_PIN_3);
-	bool pinB = GPIOPinRead(GPIO_PORTD_BASE, GPIO_PIN_1);
+	// the two channels are on different ports, so only one of them is in the
+	// snapshot. Both are read straight from their data register aliases instead
+	bool pinA = PIN_READ(AXA_ENCA);
+	bool pinB = PIN_READ(AXA_ENCB);
 
-	// convert to phase
-	uint8_t curr = encQuadToState(pinA, pinB);
+	// convert to phase, and update encoder counts. Skipped phases and
+	// repeated ISRs are counted by enc_edge()
+	encA_cts += enc_edge(ENC_AXIS_A, encQuadToState(pinA, pinB));
 
-	//update encoder counts
-	if(curr > prev || (curr == 0 && prev == 4)) // should increment
-	{
-		encA_cts++;
-	} else if(curr != prev) // should decrement
-	{
-		encA_cts--;
-	} else {} // illegal state. this would require interrupts to either be picked up multiple times or missed entirely
-
-	prev = curr;
+	PROF_END(PROF_ENC, t);
 }
 
 
 
 // TODO implement all of these
-void axisA_et_ISR() {}
-void axisA_eb_ISR() {}
+void axisA_et_ISR(uint32_t pins) {}
+void axisA_eb_ISR(uint32_t pins) {}
 
-void axisB_enc_ISR() {}
-void axisB_et_ISR() {}
-void axisB_eb_ISR() {}
+void axisB_enc_ISR(uint32_t pins) {}
+void axisB_et_ISR(uint32_t pins) {}
+void axisB_eb_ISR(uint32_t pins) {}
 
-void axisC_enc_ISR() {}
-void axisC_et_ISR() {}
-void axisC_eb_ISR() {}
+void axisC_enc_ISR(uint32_t pins) {}
+void axisC_et_ISR(uint32_t pins) {}
+void axisC_eb_ISR(uint32_t pins) {}
 
-void proxSensor_ISR() {}
+void proxSensor_ISR(uint32_t pins) {}
 
-void gpio_gen1_ISR() {}
-void gpio_gen2_ISR() {}
-void gpio_gen3_ISR() {}
-void gpio_gen4_ISR() {}
-void gpio_gen5_ISR() {}
+void gpio_gen1_ISR(uint32_t pins) {}
+void gpio_gen2_ISR(uint32_t pins) {}
+void gpio_gen3_ISR(uint32_t pins) {}
+void gpio_gen4_ISR(uint32_t pins) {}
+void gpio_gen5_ISR(uint32_t pins) {}
 
 
 
@@ -881,15 +637,8 @@ float getThermoTemp(bool isModule1)
 {
 	 // pull thermo1 select low if isModule1 is true, high otherwise
 	 // pull thermo2 select low if isModule1 is false, high otherwise
-	if(isModule1)
-	{
-		GPIOPinWrite(GPIO_PORTP_BASE, GPIO_PIN_3, 0);
-		GPIOPinWrite(GPIO_PORTQ_BASE, GPIO_PIN_1, 0xff);
-	} else
-	{
-		GPIOPinWrite(GPIO_PORTP_BASE, GPIO_PIN_3, 0xff);
-		GPIOPinWrite(GPIO_PORTQ_BASE, GPIO_PIN_1, 0);
-	}
+	PIN_WRITE(THERMO1_SEL, !isModule1);
+	PIN_WRITE(THERMO2_SEL, isModule1);
 
 	// read from the thermocouple
 	uint32_t rawDat = 0;
@@ -899,8 +648,8 @@ float getThermoTemp(bool isModule1)
 	SSIDisable(SSI3_BASE);
 
 	// turn off both modules
-	GPIOPinWrite(GPIO_PORTP_BASE, GPIO_PIN_3, GPIO_PIN_3);
-	GPIOPinWrite(GPIO_PORTQ_BASE, GPIO_PIN_1, GPIO_PIN_1);
+	PIN_WRITE(THERMO1_SEL, 1);
+	PIN_WRITE(THERMO2_SEL, 1);
 
 	// extract temperature information
 	rawDat >>= 1;
@@ -914,87 +663,205 @@ float getThermoTemp(bool isModule1)
 
 
 
-void writeMotA(float output)
+/**
+ * Reads both thermocouple modules into the cached temperatures. This is the
+ * thermal rate group job. The SSI isn't set up until the late init is done,
+ * so until then it does nothing
+ */
+void hwIO_pollThermo()
 {
-	// constrain the output to be on [-1, 1]
-	constrainf(output, -1, 1);
+	if(!boot_reached(BOOT_MARK_LATE)) { return; }
 
-	// adjust for deadband
-	uint32_t adjLow = axisADat.mot.low + axisADat.mot.deadband;
-	uint32_t adjHigh = axisADat.mot.high - axisADat.mot.deadband;
-
-	uint32_t usecsHigh = mapf(output, -1, 1, adjLow, adjHigh); // convert from output % to usecs high
+	thermoTemps[0] = getThermoTemp(true);
+	thermoTemps[1] = getThermoTemp(false);
+}
 
-	// add back deadband time if output != 0
-	if(output > 0) { usecsHigh += axisADat.mot.deadband; }
-	else if(output < 0) { usecsHigh -= axisADat.mot.deadband; }
 
-	//convert to clock cycles
-	uint32_t ticksHigh = usecsToClockCycles(usecsHigh);
 
-	//write that value to the PWM output
-	PWMPulseWidthSet(PWM0_BASE, PWM_OUT_2, ticksHigh);
+float getThermoLast(bool isModule1)
+{
+	return thermoTemps[isModule1 ? 0 : 1];
 }
 
 
 
 
-void writeMotB(float output)
+
+/**
+ * PWM output and direction pin of each axis, and where its H-bridge output
+ * is in the off, wait and on sequence
+ */
+typedef struct HwMot
+{
+	uint32_t out;		// PWM_OUT_x
+	uint32_t bit;		// PWM_OUT_x_BIT
+	uint32_t dirAddr;	// data register alias of the direction pin
+	bool fwd;			// direction pin state
+	bool on;			// H-bridge output is driving
+	bool waiting;		// H-bridge output is held off until a new compare has latched
+	uint32_t since;		// cycle count the wait started at
+} HwMot;
+
+RAMDATA static HwMot hwMots[TUNE_NUM_AXES] =
 {
-	// constrain the output to be on [-1, 1]
-	constrainf(output, -1, 1);
+	{ PWM_OUT_2, PWM_OUT_2_BIT, PIN_ADDR_AXA_DIR },
+	{ PWM_OUT_1, PWM_OUT_1_BIT, PIN_ADDR_AXB_DIR },
+	{ PWM_OUT_3, PWM_OUT_3_BIT, PIN_ADDR_AXC_DIR }
+};
+
+
+
 
+/**
+ * Works out the generator compare count for an RC style motor output on
+ * [-1, 1], a pulse between low and high, centered on no motion
+ */
+RAMFUNC static uint32_t hwIO_rcTicks(const MotDat *mot, float output)
+{
 	// adjust for deadband
-	uint32_t adjLow = axisBDat.mot.low + axisBDat.mot.deadband;
-	uint32_t adjHigh = axisBDat.mot.high - axisBDat.mot.deadband;
+	uint32_t adjLow = mot->low + mot->deadband;
+	uint32_t adjHigh = mot->high - mot->deadband;
 
 	uint32_t usecsHigh = mapf(output, -1, 1, adjLow, adjHigh); // convert from output % to usecs high
 
 	// add back deadband time if output != 0
-	if(output > 0) { usecsHigh += axisBDat.mot.deadband; }
-	else if(output < 0) { usecsHigh -= axisBDat.mot.deadband; }
+	if(output > 0) { usecsHigh += mot->deadband; }
+	else if(output < 0) { usecsHigh -= mot->deadband; }
+
+	//convert to PWM clock cycles
+	return timebase_usToPwm(usecsHigh);
+}
+
+
+
+
+/**
+ * Drives an H-bridge axis with a duty cycle of the whole period, and the
+ * direction pin high for forward and low for reverse.
+ *
+ * The generator can't do 0% duty, so zero turns the output off instead. A
+ * new compare only latches when the counter next reloads, so after a
+ * reversal, or coming back on from zero, the output is held off for a whole
+ * period. Otherwise the old duty would drive the bridge the new way until the
+ * reload
+ */
+RAMFUNC static void hwIO_writeHb(HwMot *m, const MotDat *mot, float output)
+{
+	uint32_t periodTicks = timebase_usToPwm(mot->period);
+	uint32_t dbTicks = timebase_usToPwm(mot->deadband);
+	float mag = output < 0 ? -output : output;
+	bool fwd = output >= 0;
+	uint32_t now = cycleCount();
+
+	if(mag == 0)
+	{
+		if(m->on) { PWMOutputState(PWM0_BASE, m->bit, false); }
+		m->on = false;
+		m->waiting = false;
+		return;
+	}
+
+	// any nonzero output starts from the deadband on time, and is kept one
+	// count in from 100%, which the generator can't do either
+	uint32_t ticks = dbTicks + (uint32_t)(mag * (periodTicks - dbTicks));
+	if(ticks < 1) { ticks = 1; }
+	if(ticks > periodTicks - 1) { ticks = periodTicks - 1; }
+	PWMPulseWidthSet(PWM0_BASE, m->out, ticks);
+
+	if(m->on && fwd == m->fwd) { return; }
+
+	if(fwd != m->fwd)
+	{
+		if(m->on) { PWMOutputState(PWM0_BASE, m->bit, false); }
+		HWREG(m->dirAddr) = fwd ? 0xff : 0;
+
+		m->fwd = fwd;
+		m->on = false;
+		m->waiting = false;
+	}
+
+	if(!m->waiting)
+	{
+		m->waiting = true;
+		m->since = now;
+		return;
+	}
 
-	//convert to clock cycles
-	uint32_t ticksHigh = usecsToClockCycles(usecsHigh);
+	if(now - m->since < timebase_usToCycles(mot->period)) { return; }
 
-	//write that value to the PWM output
-	PWMPulseWidthSet(PWM0_BASE, PWM_OUT_1, ticksHigh);
+	m->waiting = false;
+	m->on = true;
+	if(motEnabled) { PWMOutputState(PWM0_BASE, m->bit, true); }
 }
 
 
 
 
-void writeMotC(float output)
+/**
+ * @param axis TUNE_AXIS_x
+ * @param output on [-1, 1]. Anything outside is clamped
+ */
+RAMFUNC static void hwIO_writeMot(uint8_t axis, float output)
 {
-	// constrain the output to be on [-1, 1]
-	constrainf(output, -1, 1);
+	const MotDat *mot = &tune_getAxis(axis)->mot; // live settings, which tune_tick() can swap out between ticks
+	HwMot *m = &hwMots[axis];
 
-	// adjust for deadband
-	uint32_t adjLow = axisCDat.mot.low + axisCDat.mot.deadband;
-	uint32_t adjHigh = axisCDat.mot.high - axisCDat.mot.deadband;
+	output = constrainf(output, -1, 1);
 
-	uint32_t usecsHigh = mapf(output, -1, 1, adjLow, adjHigh); // convert from output % to usecs high
+	if(mot->mode == MOT_MODE_HBRIDGE)
+		hwIO_writeHb(m, mot, output);
+	else
+		PWMPulseWidthSet(PWM0_BASE, m->out, hwIO_rcTicks(mot, output));
+}
 
-	// add back deadband time if output != 0
-	if(output > 0) { usecsHigh += axisCDat.mot.deadband; }
-	else if(output < 0) { usecsHigh -= axisCDat.mot.deadband; }
 
-	//convert to clock cycles
-	uint32_t ticksHigh = usecsToClockCycles(usecsHigh);
 
-	//write that value to the PWM output
-	PWMPulseWidthSet(PWM0_BASE, PWM_OUT_3, ticksHigh);
+
+RAMFUNC void writeMotA(float output)
+{
+	hwIO_writeMot(TUNE_AXIS_A, output);
 }
 
 
 
 
+RAMFUNC void writeMotB(float output)
+{
+	hwIO_writeMot(TUNE_AXIS_B, output);
+}
+
+
+
+
+RAMFUNC void writeMotC(float output)
+{
+	hwIO_writeMot(TUNE_AXIS_C, output);
+}
+
+
+
+
+/**
+ * H-bridge outputs that are off (zero output, or waiting out a reversal)
+ * stay off when the motors are enabled
+ */
 void setMotorsEnabled(bool enable)
 {
+	uint32_t bits = 0;
+	uint8_t i;
+
+	motEnabled = enable;
+
 	if(enable) { PWMGenEnable(PWM0_BASE, PWM_GEN_0 | PWM_GEN_1); }
 	else { PWMGenDisable(PWM0_BASE, PWM_GEN_0 | PWM_GEN_1); }
 
-	PWMOutputState(PWM0_BASE, PWM_OUT_1_BIT | PWM_OUT_2_BIT | PWM_OUT_3_BIT, enable);
+	for(i = 0; i < TUNE_NUM_AXES; i++)
+	{
+		if(tune_getAxis(i)->mot.mode != MOT_MODE_HBRIDGE || hwMots[i].on) { bits |= hwMots[i].bit; }
+	}
+
+	PWMOutputState(PWM0_BASE, PWM_OUT_1_BIT | PWM_OUT_2_BIT | PWM_OUT_3_BIT, false);
+	if(enable) { PWMOutputState(PWM0_BASE, bits, true); }
 }
 
 
@@ -1003,7 +870,7 @@ void setMotorsEnabled(bool enable)
 
 float getEncAPos()
 {
-	float ret = ((float) encA_cts) / axisADat.enc.ppi; // convert counts to distance
+	float ret = ((float) enc_getSnap()->cts[ENC_AXIS_A]) / axisADat.enc.ppi; // convert counts to distance, as of the tick start
 	if(axisADat.enc.inv) { ret *= -1; } // invert if necessary
 
 	return ret;
@@ -1013,17 +880,9 @@ float getEncAPos()
 
 void setStatusLEDs(bool b1, bool b2, bool b3)
 {
-	GPIOPinWrite(GPIO_PORTA_BASE,
-			GPIO_PIN_4,
-			b1 << 4);
-
-	GPIOPinWrite(GPIO_PORTK_BASE,
-			GPIO_PIN_3,
-			b2 << 3);
-
-	GPIOPinWrite(GPIO_PORTK_BASE,
-			GPIO_PIN_2,
-			b3 << 2);
+	PIN_WRITE(LED1, b1);
+	PIN_WRITE(LED2, b2);
+	PIN_WRITE(LED3, b3);
 
 }
 
@@ -16,15 +16,16 @@
 
 // useful fields
 
-// current counts on the encoders
-int32_t encA_cts;
-int32_t encB_cts;
-int32_t encC_cts;
+// current counts on the encoders. Only written by the encoder ISRs, with no
+// locking. The servo works from enc_latch()'s snapshot of them instead
+extern volatile int32_t encA_cts;
+extern volatile int32_t encB_cts;
+extern volatile int32_t encC_cts;
 
 // encoder counts from the last call of hwIO_update()
-int32_t encA_cts_prev;
-int32_t encB_cts_prev;
-int32_t encC_cts_prev;
+extern int32_t encA_cts_prev;
+extern int32_t encB_cts_prev;
+extern int32_t encC_cts_prev;
 
 
 // Raw GPIO ISRs
@@ -38,26 +39,37 @@ void portN_ISR();
 void portP_ISR();
 
 
-// functions for specific pin interrupts
-void axisA_enc_ISR();
-void axisA_et_ISR();
-void axisA_eb_ISR();
+// functions for specific pin interrupts. pins is the port's GPIODATA, read
+// once when the port ISR started
+typedef void (*GpioHandler)(uint32_t pins);
 
-void axisB_enc_ISR();
-void axisB_et_ISR();
-void axisB_eb_ISR();
+typedef struct GpioDisp
+{
+	uint8_t pins;		// pins the handler is for
+	GpioHandler fxn;
+} GpioDisp;
 
-void axisC_enc_ISR();
-void axisC_et_ISR();
-void axisC_eb_ISR();
+extern volatile uint32_t gpio_spurious; // port interrupts on pins with no handler
 
-void proxSensor_ISR();
+void axisA_enc_ISR(uint32_t pins);
+void axisA_et_ISR(uint32_t pins);
+void axisA_eb_ISR(uint32_t pins);
 
-void gpio_gen1_ISR();
-void gpio_gen2_ISR();
-void gpio_gen3_ISR();
-void gpio_gen4_ISR();
-void gpio_gen5_ISR();
+void axisB_enc_ISR(uint32_t pins);
+void axisB_et_ISR(uint32_t pins);
+void axisB_eb_ISR(uint32_t pins);
+
+void axisC_enc_ISR(uint32_t pins);
+void axisC_et_ISR(uint32_t pins);
+void axisC_eb_ISR(uint32_t pins);
+
+void proxSensor_ISR(uint32_t pins);
+
+void gpio_gen1_ISR(uint32_t pins);
+void gpio_gen2_ISR(uint32_t pins);
+void gpio_gen3_ISR(uint32_t pins);
+void gpio_gen4_ISR(uint32_t pins);
+void gpio_gen5_ISR(uint32_t pins);
 
 //helper functions, used in intermediate processing
 uint8_t encQuadToState(bool pinA, bool pinB); // converts from quadrature to phase position on the encoders
@@ -88,6 +100,8 @@ bool getAxC_eb(); //fetches the current state of the bottom endstop on axis A
 bool getProxSensor(); // gets the current state of the proximity sensor
 
 float getThermoTemp(bool isModule1); // reads the temperature of thermocouple module
+float getThermoLast(bool isModule1); // last temperature hwIO_pollThermo() read from a module
+void hwIO_pollThermo(); // reads both thermocouple modules
 
 void setMotorsEnabled(bool enable); // turn on and off the pwm generator
 
@@ -99,11 +113,14 @@ void setStatusLEDs(bool b1, bool b2, bool b3); // sets the states of the 3 statu
 
 
 void hwIO_update(); // run once per tick, updates all time domain hwIO stuff
-void hwIO_init(); // initializes all pin modes, as well as any relevant peripherals
+void hwIO_init(); // initializes all pin modes, and the peripherals needed to move
+void hwIO_init_late(); // initializes the peripherals that can wait until BIOS is running
+void hwIO_applyConfig(); // puts reloaded config variables into effect. Only while nothing is moving
 
 // GPIO port setups
 void hwIO_init_portA();
 void hwIO_init_portB();
+void hwIO_init_portC();
 void hwIO_init_portD();
 void hwIO_init_portE();
 void hwIO_init_portF();
@@ -117,6 +134,8 @@ void hwIO_init_portP();
 void hwIO_init_portQ();
 
 void hwIO_init_SD();	// initialized the SD card communications
+void hwIO_init_EMAC();	// initializes the ethernet driver
+void hwIO_init_UART();	// initializes the UART driver
 void hwIO_init_Thermo();// initializes the thermocouple bank
 void hwIO_init_PWM();
 
@@ -0,0 +1,204 @@
+/*
+ * isrlat.c
+ */
+
+#include "code/isrlat.h"
+#include "code/timebase.h"
+#include "code/util.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_ints.h>
+#include <driverlib/sysctl.h>
+#include <driverlib/interrupt.h>
+#include <driverlib/timer.h>
+#include "code/noalloc.h"
+
+
+static const char * const isrlatNames[ISRLAT_NUM_SRC] =
+{
+	"portA", "portB", "portD", "portH", "portL", "portM", "portN", "portP"
+};
+
+RAMDATA static const uint32_t isrlatInts[ISRLAT_NUM_SRC] =
+{
+	INT_GPIOA, INT_GPIOB, INT_GPIOD, INT_GPIOH, INT_GPIOL, INT_GPIOM, INT_GPION, INT_GPIOP0
+};
+
+volatile uint8_t isrlat_armed[ISRLAT_NUM_SRC];
+
+static uint32_t isrlatStamp[ISRLAT_NUM_SRC];	// cycle count when each source was pended
+static volatile uint32_t isrlatMax[ISRLAT_NUM_SRC];		// worst latency, in cycles
+static volatile uint32_t isrlatSamples[ISRLAT_NUM_SRC];
+static uint8_t isrlatNext;
+static uint16_t isrlatLfsr;
+static volatile bool isrlatRunning;
+
+
+
+
+/**
+ * Next trigger interval. A 16 bit LFSR is plenty to keep the triggers from
+ * beating against the step timers or the clock tick
+ */
+RAMFUNC static uint32_t isrlat_interval()
+{
+	isrlatLfsr = (isrlatLfsr >> 1) ^ (-(isrlatLfsr & 1) & 0xb400);
+	return timebase_usToCycles(ISRLAT_MIN_US + isrlatLfsr % (ISRLAT_MAX_US - ISRLAT_MIN_US));
+}
+
+
+
+
+/**
+ * Sets Timer4A up as a one shot, and fires the first trigger. The cycle
+ * counter has to be running, which boot_start() takes care of
+ */
+void isrlat_start()
+{
+	uint8_t i;
+
+	isrlat_stop();
+
+	for(i = 0; i < ISRLAT_NUM_SRC; i++)
+	{
+		isrlatMax[i] = 0;
+		isrlatSamples[i] = 0;
+	}
+
+	isrlatNext = 0;
+	isrlatLfsr = 0xace1;
+
+	if(!SysCtlPeripheralReady(SYSCTL_PERIPH_TIMER4))
+	{
+		SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER4);
+		while(!SysCtlPeripheralReady(SYSCTL_PERIPH_TIMER4));
+	}
+
+	TimerConfigure(TIMER4_BASE, TIMER_CFG_ONE_SHOT);
+	TimerIntEnable(TIMER4_BASE, TIMER_TIMA_TIMEOUT);
+	TimerLoadSet(TIMER4_BASE, TIMER_A, isrlat_interval());
+
+	isrlatRunning = true;
+	TimerEnable(TIMER4_BASE, TIMER_A);
+}
+
+
+
+
+void isrlat_stop()
+{
+	uint8_t i;
+
+	isrlatRunning = false;
+
+	if(SysCtlPeripheralReady(SYSCTL_PERIPH_TIMER4))
+	{
+		TimerDisable(TIMER4_BASE, TIMER_A);
+		TimerIntDisable(TIMER4_BASE, TIMER_TIMA_TIMEOUT);
+	}
+
+	for(i = 0; i < ISRLAT_NUM_SRC; i++) { isrlat_armed[i] = 0; }
+}
+
+
+
+bool isrlat_running()
+{
+	return isrlatRunning;
+}
+
+
+
+uint32_t isrlat_getMaxNs(uint8_t src)
+{
+	return src < ISRLAT_NUM_SRC ? timebase_cyclesToNs(isrlatMax[src]) : 0;
+}
+
+
+
+uint32_t isrlat_getSamples(uint8_t src)
+{
+	return src < ISRLAT_NUM_SRC ? isrlatSamples[src] : 0;
+}
+
+
+
+int8_t isrlat_findSrc(const char *name)
+{
+	uint8_t i;
+
+	for(i = 0; i < ISRLAT_NUM_SRC; i++)
+	{
+		if(!strcmp(name, isrlatNames[i])) { return i; }
+	}
+
+	return -1;
+}
+
+
+
+
+void isrlat_report()
+{
+	uint8_t i;
+
+	for(i = 0; i < ISRLAT_NUM_SRC; i++)
+		System_printf("isrlat: %s max %d ns over %d samples\n", isrlatNames[i], isrlat_getMaxNs(i), isrlat_getSamples(i));
+
+	System_flush();
+}
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// ISRs /////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Records the latency for a source that was pended by the trigger. Called
+ * through ISRLAT_ENTER(), so only when the source is armed
+ */
+RAMFUNC void isrlat_enter(uint8_t src)
+{
+	uint32_t lat = cycleCount() - isrlatStamp[src];
+	isrlat_armed[src] = 0;
+
+	if(lat > isrlatMax[src]) { isrlatMax[src] = lat; }
+	isrlatSamples[src]++;
+}
+
+
+
+
+/**
+ * Zero latency, so no BIOS calls in here. Pends the next port in turn, unless
+ * its last trigger still hasn't been taken (then it gets skipped this round,
+ * and its pending stamp stays valid)
+ */
+RAMFUNC void isrlat_trigger_ISR()
+{
+	uint8_t src = isrlatNext;
+
+	TimerIntClear(TIMER4_BASE, TIMER_TIMA_TIMEOUT);
+	if(!isrlatRunning) { return; }
+
+	isrlatNext = (src + 1) % ISRLAT_NUM_SRC;
+
+	if(!isrlat_armed[src])
+	{
+		isrlatStamp[src] = cycleCount();
+		isrlat_armed[src] = 1;
+		IntTrigger(isrlatInts[src]);
+	}
+
+	TimerLoadSet(TIMER4_BASE, TIMER_A, isrlat_interval());
+	TimerEnable(TIMER4_BASE, TIMER_A);
+}
@@ -0,0 +1,59 @@
+/*
+ * isrlat.h
+ *
+ * Latency measurement mode for the GPIO ISRs. While it runs, a zero latency
+ * timer (Timer4A) pends each GPIO port interrupt in turn through the NVIC, at
+ * a randomized interval, and stamps the cycle counter when it does. The port
+ * ISR stamps it again on entry, and the worst case between the two is kept
+ * for each port. That is the time from a pin edge latching to its handler
+ * running, less the few cycles the GPIO module takes to raise the interrupt.
+ *
+ * The trigger timer shares the top priority level with the encoder ports, so
+ * time they spend blocking the trigger itself isn't seen. Everything below
+ * them (the step timers, comms, Hwi_disable() sections) is
+ */
+
+#ifndef CODE_ISRLAT_H_
+#define CODE_ISRLAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// measured sources, one per GPIO port Hwi
+#define ISRLAT_PORTA	0
+#define ISRLAT_PORTB	1
+#define ISRLAT_PORTD	2
+#define ISRLAT_PORTH	3
+#define ISRLAT_PORTL	4
+#define ISRLAT_PORTM	5
+#define ISRLAT_PORTN	6
+#define ISRLAT_PORTP	7
+#define ISRLAT_NUM_SRC	8
+
+#define ISRLAT_MIN_US	50	// range of the randomized trigger interval
+#define ISRLAT_MAX_US	150
+
+
+extern volatile uint8_t isrlat_armed[ISRLAT_NUM_SRC]; // set while a source has a pended trigger it hasn't taken
+
+
+/**
+ * Run first thing in a port ISR. Costs one load and branch when the
+ * measurement isn't running
+ */
+#define ISRLAT_ENTER(src) do { if(isrlat_armed[src]) { isrlat_enter(src); } } while(0)
+
+
+void isrlat_start(); // clears the stats, and starts triggering
+void isrlat_stop();
+bool isrlat_running();
+uint32_t isrlat_getMaxNs(uint8_t src); // worst latency seen since isrlat_start()
+uint32_t isrlat_getSamples(uint8_t src);
+int8_t isrlat_findSrc(const char *name); // looks up a source by name ("portA"...), -1 if there isn't one
+void isrlat_report(); // prints the stats for every source
+
+void isrlat_enter(uint8_t src);
+void isrlat_trigger_ISR();
+
+
+#endif /* CODE_ISRLAT_H_ */
@@ -0,0 +1,430 @@
+/*
+ * job.c
+ */
+
+#include "code/job.h"
+#include "code/SD.h"
+#include "code/pool.h"
+#include "code/timebase.h"
+#include "code/wpq.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/mw/fatfs/ff.h>
+
+#define JOB_RING		8		// chunk slots. Must be a power of 2, and at least JOB_DEPTH_MAX
+#define JOB_SECTOR		512
+
+static FIL jobFil;
+static volatile bool jobOpen;
+static volatile bool jobEof;		// the last chunk has been read
+static volatile bool jobClosing;	// job_close() is waiting on the reader
+
+static uint8_t *jobRing[JOB_RING];
+static uint32_t jobLen[JOB_RING];
+static volatile uint32_t jobHead;	// chunks read
+static volatile uint32_t jobOut;	// chunks given out
+static volatile uint32_t jobTail;	// chunks released
+
+static Semaphore_Struct jobFillSem;	// a post for every chunk read, and one at the end
+static Semaphore_Struct jobWakeSem;	// the reader has something to do
+static Semaphore_Struct jobDoneSem;	// the reader has closed the file
+static Semaphore_Struct jobPlaySem;	// a job has been handed to the player
+
+static volatile bool jobPlaying;
+static volatile bool jobStopReq;
+
+static uint64_t jobWinStart;
+static uint32_t jobWinBytes;		// released in the current rate window
+
+static JobStats jobStats;
+
+
+
+
+/**
+ * Sets up the semaphores. Run once, before anything else here
+ */
+void job_init()
+{
+	Semaphore_Params semParams;
+
+	Semaphore_Params_init(&semParams);
+	Semaphore_construct(&jobFillSem, 0, &semParams);
+
+	semParams.mode = Semaphore_Mode_BINARY;
+	Semaphore_construct(&jobWakeSem, 0, &semParams);
+	Semaphore_construct(&jobDoneSem, 0, &semParams);
+	Semaphore_construct(&jobPlaySem, 0, &semParams);
+}
+
+
+
+
+/**
+ * The chunk is as much of a cluster as fits in a block. Both are a power of 2
+ * sectors, so chunk aligned reads never cross into the next cluster
+ */
+bool job_open(const char *path)
+{
+	uint32_t cluster;
+
+	job_close();
+
+	if(!SD_mount()) { return false; }
+	if(f_open(&jobFil, path, FA_READ) != FR_OK) { return false; }
+
+	cluster = jobFil.fs->csize * JOB_SECTOR;
+
+	memset(&jobStats, 0, sizeof(jobStats));
+	jobStats.chunkSize = cluster < POOL_FILE_SIZE ? cluster : POOL_FILE_SIZE;
+	jobStats.depth = JOB_DEPTH_MAX; // nothing to go on yet, so read as far ahead as possible
+
+	jobHead = jobOut = jobTail = 0;
+	jobEof = false;
+	jobWinStart = currTime();
+	jobWinBytes = 0;
+	Semaphore_reset(Semaphore_handle(&jobFillSem), 0);
+
+	jobOpen = true;
+	Semaphore_post(Semaphore_handle(&jobWakeSem));
+	return true;
+}
+
+
+
+
+void job_close()
+{
+	if(!jobOpen) { return; }
+
+	jobClosing = true;
+	Semaphore_post(Semaphore_handle(&jobWakeSem));
+	Semaphore_pend(Semaphore_handle(&jobDoneSem), BIOS_WAIT_FOREVER);
+}
+
+
+
+
+bool job_isOpen()
+{
+	return jobOpen;
+}
+
+
+
+
+/**
+ * @param len set to the bytes in the chunk. Only the last one is short
+ * @param timeoutMs longest wait for the chunk to be read
+ *
+ * @return the chunk, or NULL if there are none left, or none came in time
+ */
+const uint8_t *job_next(uint32_t *len, uint32_t timeoutMs)
+{
+	uint32_t i;
+
+	if(!jobOpen || (jobOut == jobHead && jobEof)) { return NULL; }
+
+	if(jobOut == jobHead) { jobStats.waits++; }
+	if(!Semaphore_pend(Semaphore_handle(&jobFillSem), timeoutMs) || jobOut == jobHead) { return NULL; }
+
+	i = jobOut++ & (JOB_RING - 1);
+	*len = jobLen[i];
+	return jobRing[i];
+}
+
+
+
+
+/**
+ * Frees the block, and re-sizes the read-ahead once a whole rate window has
+ * gone by. It is kept at JOB_LEAD_MS of parsing at the last window's rate,
+ * plus the chunk being parsed
+ */
+void job_release(const uint8_t *chunk)
+{
+	uint32_t i = jobTail & (JOB_RING - 1), depth;
+	uint64_t now = currTime(), el = now - jobWinStart;
+
+	if(jobTail == jobOut || jobRing[i] != chunk)
+	{
+		System_printf("job: chunk released out of order\n");
+		return;
+	}
+
+	jobWinBytes += jobLen[i];
+	pool_free(&poolFile, jobRing[i]);
+	jobTail++;
+
+	if(el >= JOB_RATE_US)
+	{
+		jobStats.rate = (uint32_t)((uint64_t)jobWinBytes * 1000000 / el);
+		depth = (uint32_t)((uint64_t)jobStats.rate * JOB_LEAD_MS / 1000 / jobStats.chunkSize) + 1;
+
+		if(depth < JOB_DEPTH_MIN) { depth = JOB_DEPTH_MIN; }
+		if(depth > JOB_DEPTH_MAX) { depth = JOB_DEPTH_MAX; }
+		jobStats.depth = depth;
+
+		jobWinStart = now;
+		jobWinBytes = 0;
+	}
+
+	Semaphore_post(Semaphore_handle(&jobWakeSem));
+}
+
+
+
+
+bool job_atEnd()
+{
+	return jobEof && jobOut == jobHead;
+}
+
+
+
+
+const JobStats *job_getStats()
+{
+	return &jobStats;
+}
+
+
+
+
+/**
+ * Reads the next chunk into a new block. The end of the file, or a failed
+ * read, ends the job, and wakes the parser so it sees that
+ *
+ * @return true if there could be more to read
+ */
+static bool job_readChunk()
+{
+	uint8_t *buf = pool_alloc(&poolFile);
+	uint64_t start;
+	uint32_t i, us;
+	UINT got = 0;
+
+	if(!buf) { return false; }
+
+	start = currTime();
+	if(f_read(&jobFil, buf, jobStats.chunkSize, &got) != FR_OK)
+	{
+		jobStats.errors++;
+		got = 0;
+	}
+
+	us = (uint32_t)(currTime() - start);
+	if(us > jobStats.readUs) { jobStats.readUs = us; }
+
+	if(!got)
+	{
+		pool_free(&poolFile, buf);
+		jobEof = true;
+		Semaphore_post(Semaphore_handle(&jobFillSem));
+		return false;
+	}
+
+	i = jobHead & (JOB_RING - 1);
+	jobRing[i] = buf;
+	jobLen[i] = got;
+	jobStats.chunks++;
+	jobStats.bytes += got;
+
+	if(got < jobStats.chunkSize) { jobEof = true; }
+	jobHead++;
+
+	Semaphore_post(Semaphore_handle(&jobFillSem));
+	return !jobEof;
+}
+
+
+
+
+/**
+ * Hands back every block still read ahead or given out, and closes the file
+ */
+static void job_drop()
+{
+	while(jobTail != jobHead)
+	{
+		pool_free(&poolFile, jobRing[jobTail & (JOB_RING - 1)]);
+		jobTail++;
+	}
+
+	f_close(&jobFil);
+	jobOpen = false;
+	jobClosing = false;
+}
+
+
+
+
+/**
+ * Sleeps until a job is opened or a chunk is released, then reads until
+ * there are depth chunks held, counting the ones given out
+ */
+void job_task(UArg arg0, UArg arg1)
+{
+	while(1)
+	{
+		Semaphore_pend(Semaphore_handle(&jobWakeSem), BIOS_WAIT_FOREVER);
+
+		if(jobClosing)
+		{
+			job_drop();
+			Semaphore_post(Semaphore_handle(&jobDoneSem));
+			continue;
+		}
+
+		while(jobOpen && !jobEof && !jobClosing && jobHead - jobTail < jobStats.depth)
+		{
+			if(!job_readChunk()) { break; }
+		}
+	}
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Player ///////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * @param path waypoint job file
+ *
+ * @return false if a job is already playing, or the file couldn't be opened
+ */
+bool job_run(const char *path)
+{
+	if(jobPlaying || !job_open(path)) { return false; }
+
+	jobStopReq = false;
+	jobPlaying = true;
+	Semaphore_post(Semaphore_handle(&jobPlaySem));
+	return true;
+}
+
+
+
+
+/**
+ * Takes effect within JOB_PLAY_WAIT_MS. Whatever was already submitted is
+ * left in the queue, "wpq flush" drops it
+ */
+void job_stop()
+{
+	jobStopReq = true;
+}
+
+
+
+
+bool job_isPlaying()
+{
+	return jobPlaying;
+}
+
+
+
+
+/**
+ * Waits for a queue block. The pool has fewer blocks than the queue has
+ * slots, so once one is free the submit can't find the queue full
+ *
+ * @return the block, or NULL if the player was stopped first
+ */
+static WpqBatch *job_waitBlock()
+{
+	WpqBatch *b;
+
+	while(!(b = wpq_alloc()))
+	{
+		if(jobStopReq) { return NULL; }
+		Task_sleep(JOB_PLAY_POLL_MS);
+	}
+
+	return b;
+}
+
+
+
+
+/**
+ * Copies the open job into the waypoint queue a batch at a time. Batches
+ * run across chunk boundaries, so each one is put back together in its queue
+ * block. The header comes first, and says how much more the batch needs
+ */
+static void job_play()
+{
+	WpqBatch *b = NULL;
+	uint32_t have = 0, want = WPQ_HDR_SIZE, len, off, n;
+	const uint8_t *chunk;
+
+	while(job_isOpen() && !job_atEnd() && !jobStopReq)
+	{
+		if(!(chunk = job_next(&len, JOB_PLAY_WAIT_MS))) { continue; }
+
+		for(off = 0; off < len && !jobStopReq; off += n)
+		{
+			if(!b && !(b = job_waitBlock())) { break; }
+
+			n = want - have < len - off ? want - have : len - off;
+			memcpy((uint8_t *)b + have, chunk + off, n);
+			have += n;
+
+			if(have < want) { continue; }
+
+			if(want == WPQ_HDR_SIZE)
+			{
+				if(b->magic != WPQ_MAGIC || !b->n || b->n > WPQ_BATCH_PTS)
+				{
+					System_printf("job: bad batch after %u good ones\n", jobStats.batches);
+					jobStats.bad++;
+					jobStopReq = true;
+					break;
+				}
+
+				want = WPQ_HDR_SIZE + b->n * sizeof(WpqPoint);
+				continue;
+			}
+
+			wpq_submit(b, have); // takes the block, and counts it if it is refused
+			jobStats.batches++;
+
+			b = NULL;
+			have = 0;
+			want = WPQ_HDR_SIZE;
+		}
+
+		job_release(chunk);
+	}
+
+	if(b) { wpq_release(b); }
+	job_close();
+}
+
+
+
+
+/**
+ * Plays each job job_run() hands over, then goes back to waiting
+ */
+void job_playTask(UArg arg0, UArg arg1)
+{
+	while(1)
+	{
+		Semaphore_pend(Semaphore_handle(&jobPlaySem), BIOS_WAIT_FOREVER);
+
+		job_play();
+		jobPlaying = false;
+	}
+}
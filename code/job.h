@@ -0,0 +1,85 @@
+/*
+ * job.h
+ *
+ * Job file reader. Streams a job off the SD card ahead of the parser, so the
+ * parser never waits on the card. The file is read in chunks of whole
+ * sectors, at chunk aligned offsets, straight into poolFile blocks. A chunk
+ * is a whole cluster, or a power of 2 part of one when clusters are bigger
+ * than a block, so no read ever straddles two clusters, and FatFs passes each
+ * one to the card as a single multi-sector read, without going through its
+ * own sector buffer.
+ *
+ * The reading is done by job_task(), which keeps a number of chunks filled
+ * ahead of the parser. How many is worked out from how fast the parser has
+ * been releasing them, so there are always about JOB_LEAD_MS worth read
+ * ahead, and blocks the parser doesn't need are left free.
+ *
+ * The parser gets the chunks themselves, in file order:
+ *
+ *   while((p = job_next(&len, timeout)))
+ *   {
+ *       ... parse len bytes at p ...
+ *       job_release(p);
+ *   }
+ *
+ * More than one chunk can be held at once (eg. for a line that runs over
+ * the end of one), but they have to be released in the order they were
+ * given out. Only one job is open at a time, and it is read from one task.
+ *
+ * The consumer on the board is the waypoint player, job_playTask(). A job
+ * file there is wpq.h batches back to back, in the same layout as the link's
+ * waypoint packets (the header, then n waypoints), and the player copies each
+ * one into a queue block and submits it, waiting for a free block whenever
+ * the queue is full. "job run <path>" starts one, and "job stop" ends it
+ */
+
+#ifndef CODE_JOB_H_
+#define CODE_JOB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include "code/pool.h"
+
+#define JOB_DEPTH_MAX	POOL_FILE_BLKS	// most chunks read ahead
+#define JOB_DEPTH_MIN	2
+#define JOB_LEAD_MS		250				// read-ahead wanted, in parser time
+#define JOB_RATE_US		500000			// consumption rate measurement window
+#define JOB_PLAY_WAIT_MS	100			// player's wait for a chunk, between checks for a stop
+#define JOB_PLAY_POLL_MS	2			// player's wait for a free queue block
+
+
+typedef struct JobStats
+{
+	uint32_t chunks;		// chunks read
+	uint32_t bytes;
+	uint32_t chunkSize;		// bytes, for the open file
+	uint32_t depth;			// chunks being kept read ahead
+	uint32_t rate;			// bytes/s the parser released over the last whole window
+	uint32_t readUs;		// longest single chunk read
+	uint32_t waits;			// times job_next() found nothing read yet
+	uint32_t errors;		// failed reads. The job ends at the first one
+	uint32_t batches;		// waypoint batches the player submitted
+	uint32_t bad;			// batches the player found malformed. Playing stops at the first one
+} JobStats;
+
+
+void job_init(); // run once, before BIOS starts
+bool job_open(const char *path); // mounts the card if need be, opens the file, and starts reading ahead. false if it couldn't
+void job_close(); // stops reading and hands back every chunk. Anything job_next() gave out is gone
+bool job_isOpen();
+
+const uint8_t *job_next(uint32_t *len, uint32_t timeoutMs); // next chunk. NULL at the end of the file, or if none was read in time
+void job_release(const uint8_t *chunk); // hands back the oldest chunk job_next() gave out
+bool job_atEnd(); // every chunk has been given out
+
+const JobStats *job_getStats();
+void job_task(UArg arg0, UArg arg1); // does the reading. Runs forever
+
+bool job_run(const char *path); // opens a waypoint job and hands it to the player. false if it couldn't, or one is playing
+void job_stop(); // stops the player, which closes the job
+bool job_isPlaying();
+void job_playTask(UArg arg0, UArg arg1); // feeds waypoint jobs to wpq.h. Runs forever
+
+
+#endif /* CODE_JOB_H_ */
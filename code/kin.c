@@ -0,0 +1,181 @@
+/*
+ * kin.c
+ */
+
+#include "code/kin.h"
+#include "code/motion.h"
+#include "code/dat.h"
+#include "code/util.h"
+#include "code/timebase.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "code/noalloc.h"
+
+
+// slice timing statistics
+static uint32_t kin_slices;
+static uint64_t kin_cycSum;
+static uint32_t kin_cycMax;
+
+
+
+
+/**
+ * Finds the carriage heights that put the effector at a tool position
+ *
+ * @param p tool position
+ * @param carr filled with the A, B and C carriage heights
+ *
+ * @return false if the position is out of reach of any of the rods
+ */
+bool kin_inverse(const ToolPos *p, float *carr)
+{
+	const AxisDat *ax[3] = { &axisADat, &axisBDat, &axisCDat };
+	uint8_t i;
+
+	for(i = 0; i < 3; i++)
+	{
+		float dx = p->x - ax[i]->axisX;
+		float dy = p->y - ax[i]->axisY;
+		float h2 = ax[i]->rodLen * ax[i]->rodLen - dx*dx - dy*dy;
+
+		if(h2 < 0) { return false; }
+
+		carr[i] = p->z + sqrtf(h2);
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Sets up a straight tool space move to be sliced
+ *
+ * @param start current tool position
+ * @param end target tool position
+ * @param feed speed along the move (in / sec). Used along E for extrude only moves
+ *
+ * @return false if the move has no length or feed
+ */
+bool kin_initMove(KinGen *g, const ToolPos *start, const ToolPos *end, float feed)
+{
+	g->start = *start;
+	g->delta.x = end->x - start->x;
+	g->delta.y = end->y - start->y;
+	g->delta.z = end->z - start->z;
+	g->delta.e = end->e - start->e;
+	g->i = 0;
+	g->err = false;
+
+	float len = sqrtf(g->delta.x*g->delta.x + g->delta.y*g->delta.y + g->delta.z*g->delta.z);
+	if(len == 0) { len = fabsf(g->delta.e); }
+	if(len == 0 || feed <= 0) { return false; }
+
+	float t = len / feed;
+
+	g->totDur = (uint64_t)(t * timebase_getClk());
+	g->n = (uint32_t)ceilf(t * kin_segRate);
+	if(g->n == 0) { g->n = 1; }
+
+	// the only divisions for the move; slices then just add the quotient and
+	// carry the remainder, which gives the same durations as totDur*i/n would
+	g->durQ = (uint32_t)(g->totDur / g->n);
+	g->durR = (uint32_t)(g->totDur % g->n);
+	g->durAcc = 0;
+	g->invN = 1.0f / g->n;
+
+	return true;
+}
+
+
+
+
+/**
+ * Gets the next slice of the move. Slice lengths are spread so they add up to
+ * exactly the length of the move
+ *
+ * @param out filled with the slice
+ *
+ * @return false once all slices have been output, or if one is out of reach
+ */
+bool kin_next(KinGen *g, CarrSeg *out)
+{
+	if(g->i >= g->n || g->err) { return false; }
+
+	uint32_t c0 = cycleCount();
+
+	uint32_t dur = g->durQ;
+	g->durAcc += g->durR;
+	if(g->durAcc >= g->n)
+	{
+		g->durAcc -= g->n;
+		dur++;
+	}
+	g->i++;
+
+	float f = g->i == g->n ? 1.0f : g->i * g->invN;
+	ToolPos p;
+	p.x = g->start.x + g->delta.x * f;
+	p.y = g->start.y + g->delta.y * f;
+	p.z = g->start.z + g->delta.z * f;
+	p.e = g->start.e + g->delta.e * f;
+
+	if(!kin_inverse(&p, out->c))
+	{
+		g->err = true;
+		return false;
+	}
+
+	out->e = p.e;
+	out->dur = dur;
+
+	uint32_t cyc = cycleCount() - c0;
+	kin_slices++;
+	kin_cycSum += cyc;
+	if(cyc > kin_cycMax) { kin_cycMax = cyc; }
+
+	return true;
+}
+
+
+
+
+/**
+ * Fraction of the CPU slicing takes at the current kin_segRate, based on the
+ * average cycles per slice so far
+ */
+float kin_getLoad()
+{
+	if(!kin_slices) { return 0; }
+	return ((float)kin_cycSum / kin_slices) * kin_segRate / timebase_getClk();
+}
+
+
+
+
+/**
+ * Densest slice rate that keeps slicing inside a CPU budget, based on the worst
+ * case cycles per slice so far
+ *
+ * @param budget fraction of the CPU that can be spent on slicing
+ */
+float kin_getMaxSegRate(float budget)
+{
+	if(!kin_cycMax) { return 0; }
+	return budget * timebase_getClk() / kin_cycMax;
+}
+
+
+
+
+uint32_t kin_getMaxCycles() { return kin_cycMax; }
+
+void kin_resetStats()
+{
+	kin_slices = 0;
+	kin_cycSum = 0;
+	kin_cycMax = 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * kin.h
+ *
+ * Linear delta kinematics. A straight line in tool space is a curve in carriage
+ * space, so moves are split into fixed length time slices, and the inverse
+ * kinematics are run at the end of each one. The carriages then move linearly
+ * between slice end points.
+ *
+ * The slice rate (kin_segRate in dat.h) sets the path accuracy. The cycles spent
+ * on each slice are tracked, so the load at a given rate can be read back and
+ * the densest rate the CPU can sustain picked from it
+ */
+
+#ifndef CODE_KIN_H_
+#define CODE_KIN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "code/motion.h"
+
+
+/**
+ * A single time slice in carriage space
+ */
+typedef struct CarrSeg
+{
+	float c[3];		// carriage A, B and C heights at the end of the slice
+	float e;		// extruder position at the end of the slice
+	uint32_t dur;	// length of the slice (in clock cycles)
+} CarrSeg;
+
+
+
+typedef struct KinGen
+{
+	ToolPos start;
+	ToolPos delta;	// end - start
+	uint64_t totDur;// length of the whole move (in clock cycles)
+	uint32_t n;		// number of slices
+	uint32_t i;		// slices output so far
+	uint32_t durQ;	// totDur / n
+	uint32_t durR;	// totDur % n
+	uint32_t durAcc;// remainder carried between slices, always < n
+	float invN;		// 1 / n
+	bool err;		// a slice end point was out of reach
+} KinGen;
+
+
+
+bool kin_inverse(const ToolPos *p, float *carr); // tool position to carriage heights. false if out of reach
+
+bool kin_initMove(KinGen *g, const ToolPos *start, const ToolPos *end, float feed);
+bool kin_next(KinGen *g, CarrSeg *out); // gets the next slice. false once the move is done, or on error
+
+float kin_getLoad(); // fraction of the CPU used by slicing at kin_segRate
+float kin_getMaxSegRate(float budget); // slice rate that would use the given fraction of the CPU
+uint32_t kin_getMaxCycles(); // worst case cycles taken by a single slice
+void kin_resetStats();
+
+
+#endif /* CODE_KIN_H_ */
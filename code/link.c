@@ -0,0 +1,465 @@
+/*
+ * link.c
+ */
+
+#include "code/link.h"
+#include "code/wpq.h"
+#include "code/timebase.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef HOST_SIM
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include "code/tune.h"
+#include "code/enc.h"
+#include "code/sched.h"
+#include "code/mon.h"
+#else
+#include <stdio.h>
+#define System_printf printf
+#define System_snprintf snprintf
+#define System_flush()
+#endif
+
+#define LINK_RESP_MAX	96	// longest response line
+
+static LinkPort *linkPorts[LINK_MAX_PORTS];
+static uint8_t linkCount;
+
+
+
+
+/**
+ * Adds a port to the list link_find() and link_report() go through
+ */
+static void link_register(LinkPort *port)
+{
+	uint8_t i;
+
+	for(i = 0; i < linkCount; i++)
+	{
+		if(linkPorts[i] == port) { return; }
+	}
+
+	if(linkCount < LINK_MAX_PORTS) { linkPorts[linkCount++] = port; }
+}
+
+
+
+
+/**
+ * Rolls the rate window once it is a whole LINK_RATE_US long
+ */
+static void link_updateRates(LinkPort *port)
+{
+	LinkStats *s = &port->stats;
+	uint64_t now = currTime(), el = now - port->winStart;
+
+	if(el < LINK_RATE_US) { return; }
+
+	s->rxRate = (uint32_t)((s->rxBytes - port->winRx) * 1000000 / el);
+	s->txRate = (uint32_t)((s->txBytes - port->winTx) * 1000000 / el);
+	if(s->rxRate > s->rxPeak) { s->rxPeak = s->rxRate; }
+	if(s->txRate > s->txPeak) { s->txPeak = s->txRate; }
+
+	port->winStart = now;
+	port->winRx = s->rxBytes;
+	port->winTx = s->txBytes;
+}
+
+
+
+
+/**
+ * Reads exactly len bytes, once a packet has started. The sender is already
+ * partway through it, so the rest is waited on for as long as it takes. If
+ * the link drops partway, the rest comes from the next connection, and the
+ * resync sorts it out
+ */
+static void link_readAll(LinkPort *port, void *buf, uint32_t len)
+{
+	uint8_t *p = buf;
+	uint32_t n;
+
+	while(len)
+	{
+		n = port->read(p, len, LINK_POLL_MS);
+		p += n;
+		len -= n;
+		port->stats.rxBytes += n;
+
+		if(port->idle) { port->idle(); }
+	}
+}
+
+
+
+
+bool link_send(LinkPort *port, uint8_t type, const void *payload, uint16_t len)
+{
+	uint8_t hdr[LINK_HDR_SIZE] = { LINK_SYNC, type, len & 0xff, len >> 8 };
+
+	if(!port->write(hdr, LINK_HDR_SIZE)) { return false; }
+	if(len && !port->write(payload, len)) { return false; }
+
+	port->stats.txBytes += LINK_HDR_SIZE + len;
+	port->stats.txPkts++;
+	return true;
+}
+
+
+
+
+static void link_sendTelem(LinkPort *port)
+{
+	LinkTelem t;
+	const WpqTarget *tgt = wpq_getTarget();
+	const WpqStats *ws = wpq_getStats();
+	uint8_t i;
+
+	memset(&t, 0, sizeof(t));
+	t.seq = port->telemSeq++;
+	t.usecs = (uint32_t)currTime();
+
+	// the target is only written by the servo, so a copy could straddle a
+	// tick. It is only for display, so that is fine
+	memcpy(t.target, tgt->c, sizeof(tgt->c));
+	t.target[3] = tgt->e;
+
+	t.wpqQueued = wpq_getQueued();
+	t.wpqFree = wpq_getFree();
+	t.wpqUnderruns = ws->underruns;
+	t.wpqTaken = wpq_getTaken();
+
+#ifndef HOST_SIM
+	EncSnap snap;
+	enc_copySnap(&snap);
+	for(i = 0; i < 3; i++) { t.cts[i] = snap.cts[i]; }
+	for(i = 0; i < SCHED_NUM_GROUPS; i++) { t.load[i] = sched_getStats(i)->load; }
+
+	const MonSample *latest = mon_getLatest();
+	MonSample smp;
+	if(latest && mon_getSample(latest->seq, &smp))
+	{
+		t.monSeq = smp.seq + 1;
+		t.cpuLoad = smp.cpuLoad;
+		t.hwiStackPeak = smp.hwiStackPeak;
+		t.heapUsed = smp.heapUsed;
+		t.heapPeak = smp.heapPeak;
+	}
+#else
+	(void)i;
+#endif
+
+	link_send(port, LINK_PKT_TELEM, &t, sizeof(t));
+}
+
+
+
+
+/**
+ * The room for more input. The batch counts are read without a lock, so
+ * free could be one behind taken, which only ever errs on the short side
+ */
+static void link_sendCredit(LinkPort *port)
+{
+	LinkCredit c;
+
+	c.seq = port->creditSeq++;
+	c.bytesTaken = (uint32_t)port->stats.rxBytes;
+	c.bytesFree = port->rxCap;
+	c.segsTaken = wpq_getTaken();
+	c.segsFree = wpq_getFree();
+
+	port->creditBytes = c.bytesTaken;
+	port->creditSegs = c.segsTaken + c.segsFree;
+	port->creditLast = currTime();
+
+	link_send(port, LINK_PKT_CREDIT, &c, sizeof(c));
+}
+
+
+
+
+/**
+ * Sends a credit once the sender's window has moved far enough to matter,
+ * or the last one is getting old
+ */
+static void link_creditIfDue(LinkPort *port)
+{
+	uint32_t taken = (uint32_t)port->stats.rxBytes;
+
+	if(!port->framed) { return; }
+
+	if(taken - port->creditBytes >= port->rxCap / 4 ||
+			wpq_getTaken() + wpq_getFree() != port->creditSegs ||
+			currTime() - port->creditLast >= (uint64_t)LINK_CREDIT_MS * 1000)
+		link_sendCredit(port);
+}
+
+
+
+
+/**
+ * Splits the next whitespace separated word off of a string
+ *
+ * @return the word, or NULL if there are none left
+ */
+static char *link_nextWord(char **s)
+{
+	char *p = *s, *word;
+
+	while(*p == ' ' || *p == '\t') { p++; }
+	if(!*p) { return NULL; }
+
+	word = p;
+	while(*p && *p != ' ' && *p != '\t') { p++; }
+	if(*p) { *p++ = 0; }
+
+	*s = p;
+	return word;
+}
+
+
+
+
+/**
+ * "link telem <ms>|off", "link source on|off" and "link credit", for the
+ * port the command came in on
+ */
+static bool link_command(LinkPort *port, char *args, char *resp, uint32_t respLen)
+{
+	char *what = link_nextWord(&args);
+	char *val = link_nextWord(&args);
+
+	if(what && !strcmp(what, "credit"))
+	{
+		port->creditLast = 0; // due straight after the resp
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	if(what && val && !strcmp(what, "telem"))
+	{
+		port->telemMs = strcmp(val, "off") ? strtoul(val, NULL, 10) : 0;
+		port->telemLast = currTime();
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	if(what && val && !strcmp(what, "source"))
+	{
+		port->source = !strcmp(val, "on");
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	System_snprintf(resp, respLen, "err unknown link option");
+	return false;
+}
+
+
+
+
+static void link_runLine(LinkPort *port, char *line, char *resp, uint32_t respLen)
+{
+	if(!strncmp(line, "link ", 5))
+		link_command(port, line + 5, resp, respLen);
+	else
+	{
+#ifndef HOST_SIM
+		tune_handleLine(line, resp, respLen);
+#else
+		System_snprintf(resp, respLen, "err no tune commands in the simulation");
+#endif
+	}
+}
+
+
+
+
+static void link_handleCmd(LinkPort *port, char *line)
+{
+	char resp[LINK_RESP_MAX];
+
+	link_runLine(port, line, resp, sizeof(resp));
+	link_send(port, LINK_PKT_RESP, resp, strlen(resp));
+}
+
+
+
+
+/**
+ * Takes one byte of a plain command line on a text port. Lines end with
+ * either \r or \n, and the response goes back as a plain line
+ */
+static void link_textByte(LinkPort *port, char c)
+{
+	char resp[LINK_RESP_MAX];
+
+	if(c != '\r' && c != '\n')
+	{
+		if(port->textLen < LINK_TEXT_MAX) { port->textLine[port->textLen++] = c; }
+		else { port->textLen = 0xff; }
+		return;
+	}
+
+	if(!port->textLen) { return; }
+
+	// a truncated line could still parse as something else, so it is refused whole
+	if(port->textLen == 0xff)
+		System_snprintf(resp, sizeof(resp), "err line too long");
+	else
+	{
+		port->textLine[port->textLen] = 0;
+		link_runLine(port, port->textLine, resp, sizeof(resp));
+	}
+
+	port->textLen = 0;
+	port->write(resp, strlen(resp));
+	port->write("\r\n", 2);
+	port->stats.txBytes += strlen(resp) + 2;
+}
+
+
+
+
+/**
+ * Reads and acts on one packet, once its header is in. Waypoint batches are
+ * read straight into a queue block, so they are never copied. Everything
+ * else goes through the port's buffer
+ */
+static void link_handlePkt(LinkPort *port, uint8_t type, uint16_t len)
+{
+	WpqBatch *b;
+
+	if(len > LINK_MAX_PAYLOAD)
+	{
+		// skip it in buffer sized pieces
+		while(len)
+		{
+			uint16_t n = len > LINK_MAX_PAYLOAD ? LINK_MAX_PAYLOAD : len;
+			link_readAll(port, port->buf, n);
+			len -= n;
+		}
+
+		port->stats.bad++;
+		return;
+	}
+
+	if(type == LINK_PKT_WPQ && (b = wpq_alloc()))
+	{
+		link_readAll(port, b, len);
+		wpq_submit(b, len);
+		return;
+	}
+
+	link_readAll(port, port->buf, len);
+
+	switch(type)
+	{
+	case LINK_PKT_CMD:
+		port->buf[len] = 0;
+		link_handleCmd(port, (char *)port->buf);
+		break;
+
+	case LINK_PKT_WPQ:
+		wpq_submitCopy(port->buf, len); // no block free, so this is counted as full
+		break;
+
+	case LINK_PKT_SINK:
+		break;
+
+	default:
+		port->stats.bad++;
+		break;
+	}
+}
+
+
+
+
+/**
+ * Runs the port forever. Between packets it sends telemetry, credits and
+ * filler as they are due, and only waits for the next packet when there is
+ * no filler to send
+ */
+void link_serve(LinkPort *port)
+{
+	uint8_t hdr[LINK_HDR_SIZE];
+	uint64_t now;
+
+	link_register(port);
+	port->winStart = currTime();
+
+	while(1)
+	{
+		if(port->idle) { port->idle(); }
+
+		now = currTime();
+		if(port->telemMs && now - port->telemLast >= (uint64_t)port->telemMs * 1000)
+		{
+			port->telemLast = now;
+			link_sendTelem(port);
+		}
+
+		link_creditIfDue(port);
+
+		if(port->source) { link_send(port, LINK_PKT_SOURCE, port->buf, LINK_MAX_PAYLOAD); }
+
+		link_updateRates(port);
+
+		// hunt for a sync byte
+		if(!port->read(hdr, 1, port->source ? 0 : LINK_POLL_MS)) { continue; }
+		port->stats.rxBytes++;
+
+		if(hdr[0] != LINK_SYNC)
+		{
+			if(port->text) { link_textByte(port, (char)hdr[0]); }
+			else { port->stats.bad++; }
+			continue;
+		}
+
+		link_readAll(port, hdr + 1, LINK_HDR_SIZE - 1);
+		port->stats.rxPkts++;
+		port->framed = true;
+
+		link_handlePkt(port, hdr[1], hdr[2] | (hdr[3] << 8));
+	}
+}
+
+
+
+
+LinkPort *link_find(const char *name)
+{
+	uint8_t i;
+
+	for(i = 0; i < linkCount; i++)
+	{
+		if(!strcmp(name, linkPorts[i]->name)) { return linkPorts[i]; }
+	}
+
+	return NULL;
+}
+
+
+
+
+void link_report()
+{
+	uint8_t i;
+
+	for(i = 0; i < linkCount; i++)
+	{
+		const LinkStats *s = &linkPorts[i]->stats;
+		System_printf("link: %s in %d B/s (peak %d), out %d B/s (peak %d), %d pkts in, %d out, %d bad\n",
+				linkPorts[i]->name, s->rxRate, s->rxPeak, s->txRate, s->txPeak, s->rxPkts, s->txPkts, s->bad);
+	}
+
+	System_flush();
+}
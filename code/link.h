@@ -0,0 +1,164 @@
+/*
+ * link.h
+ *
+ * Packet framing for the binary host links (USB, TCP, UART, and the host
+ * simulation's stand-in). The transport is just a byte stream, given by a
+ * LinkPort's read and write functions, and link_serve() runs the protocol
+ * over it from the port's own task.
+ *
+ * Every packet is a 4 byte header, then up to LINK_MAX_PAYLOAD bytes:
+ *
+ *   sync (0xA5), type, payload length (16 bits, little endian)
+ *
+ * A bad sync byte or an oversized packet is counted and skipped, and the
+ * reader hunts for the next sync byte. Packet types:
+ *
+ *   cmd     in   a tune command line (see tune.h), without a line ending.
+ *                Answered with a resp packet. "link telem <ms>|off",
+ *                "link source on|off" and "link credit" are handled by the
+ *                link itself
+ *   resp    out  the response line to a cmd
+ *   wpq     in   a WpqBatch, read straight into a queue block (see wpq.h)
+ *   sink    in   counted and thrown away. For measuring the inbound rate
+ *   telem   out  a LinkTelem, every telemMs while it is turned on
+ *   source  out  filler, sent back to back while it is turned on. For
+ *                measuring the outbound rate
+ *   credit  out  a LinkCredit, the room the board has for more input
+ *
+ * Flow control is by credits, so a sender never has to wait on a reply per
+ * packet. Each credit packet gives how many bytes the port has read so far,
+ * and how many more the transport can hold past that (rxCap), along with
+ * how many waypoint batches have been taken in, and how many free blocks
+ * there are for more. The sender keeps what it has sent within
+ * bytesTaken + bytesFree and segsTaken + segsFree, and can keep the pipe full
+ * up to there. The counts are cumulative, so a lost or late credit only ever
+ * leaves the sender short of room, never over.
+ *
+ * Credits are only sent on a port once it has had a packet in, so a plain
+ * terminal on a text port never sees them. After that they are sent
+ * whenever a quarter of rxCap has been read, when a batch block frees up,
+ * and every LINK_CREDIT_MS regardless. "link credit" sends one right after
+ * its resp, which is how a new sender lines its counts up with the board's:
+ * everything it sent before has been read by then. Batch blocks are shared
+ * by every port, so only one port should stream waypoints at a time.
+ *
+ * A text port (the UART) also takes plain command lines, ending in \r or \n,
+ * between packets, and answers them with a plain line, so a terminal still
+ * works on it.
+ *
+ * Both directions are timed, and the rate over the last second is kept, so
+ * the sustained throughput of each port can be read back with "link <port>"
+ */
+
+#ifndef CODE_LINK_H_
+#define CODE_LINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "code/wpq.h"
+
+#define LINK_SYNC			0xA5
+#define LINK_HDR_SIZE		4
+#define LINK_MAX_PAYLOAD	sizeof(WpqBatch)	// largest packet, a full waypoint batch
+#define LINK_MAX_PORTS		4
+
+#define LINK_POLL_MS		10		// longest wait for a packet to start, between periodic work
+#define LINK_RATE_US		1000000	// throughput measurement window
+#define LINK_CREDIT_MS		100		// longest time between credits
+#define LINK_TEXT_MAX		96		// longest plain command line on a text port
+
+// packet types
+#define LINK_PKT_CMD		1
+#define LINK_PKT_RESP		2
+#define LINK_PKT_WPQ		3
+#define LINK_PKT_SINK		4
+#define LINK_PKT_TELEM		5
+#define LINK_PKT_SOURCE		6
+#define LINK_PKT_CREDIT		7
+
+
+typedef struct LinkStats
+{
+	uint64_t rxBytes;	// including headers
+	uint64_t txBytes;
+	uint32_t rxPkts;
+	uint32_t txPkts;
+	uint32_t bad;		// bytes skipped hunting for a sync, plus oversized and unknown packets
+	uint32_t rxRate;	// bytes/s over the last whole window
+	uint32_t txRate;
+	uint32_t rxPeak;	// best window seen
+	uint32_t txPeak;
+} LinkStats;
+
+
+/**
+ * Telemetry packet payload
+ */
+typedef struct LinkTelem
+{
+	uint32_t seq;
+	uint32_t usecs;			// system time, low word
+	int32_t cts[3];			// encoder counts, as of the last servo tick
+	float target[4];		// waypoint target carriage heights and extruder position
+	uint32_t wpqQueued;		// batches queued
+	uint32_t wpqFree;		// free batch blocks
+	uint32_t wpqUnderruns;
+	uint32_t wpqTaken;		// batches taken in, whether or not they were queued
+	uint16_t load[4];		// rate group loads, in 1/10ths of a percent
+	uint32_t monSeq;		// monitor sample the rest come from, see mon.h. 0 before the first one
+	uint32_t cpuLoad;		// in 1/10ths of a percent
+	uint32_t hwiStackPeak;	// system stack high water mark (bytes)
+	uint32_t heapUsed;
+	uint32_t heapPeak;
+} LinkTelem;
+
+
+/**
+ * Credit packet payload. All counts wrap at 32 bits
+ */
+typedef struct LinkCredit
+{
+	uint32_t seq;
+	uint32_t bytesTaken;	// bytes read off the port, headers and skipped bytes included
+	uint32_t bytesFree;		// bytes the transport holds past bytesTaken
+	uint32_t segsTaken;		// waypoint batches taken in, from any port
+	uint32_t segsFree;		// free batch blocks
+} LinkCredit;
+
+
+typedef struct LinkPort
+{
+	const char *name;
+	uint32_t (*read)(void *buf, uint32_t len, uint32_t timeoutMs); // bytes read. Short if nothing came in for timeoutMs
+	bool (*write)(const void *buf, uint32_t len); // blocks until it is all sent. false if the link dropped
+	void (*idle)(); // run between packets, and at least every LINK_POLL_MS. Can be NULL
+	uint32_t rxCap;			// bytes the transport buffers ahead of the reader. Has to be at least a whole packet
+	bool text;				// also takes plain command lines
+
+	LinkStats stats;
+	uint32_t telemMs;		// telemetry period, 0 if off
+	bool source;			// sending filler
+	uint32_t telemSeq;
+	uint64_t telemLast;
+	uint64_t winStart;		// start of the current rate window (usecs)
+	uint64_t winRx;			// byte counts at the window start
+	uint64_t winTx;
+	bool framed;			// a packet has come in, so credits are wanted
+	uint32_t creditSeq;
+	uint32_t creditBytes;	// bytesTaken in the last credit
+	uint32_t creditSegs;	// segsTaken + segsFree in the last credit
+	uint64_t creditLast;
+	uint8_t textLen;		// plain line so far, 0xff once it has overflowed
+	char textLine[LINK_TEXT_MAX + 1];
+	uint8_t buf[LINK_MAX_PAYLOAD + 1]; // payloads that aren't read in place. Room for a terminator
+} LinkPort;
+
+
+void link_serve(LinkPort *port); // runs the protocol forever. Call from the port's task
+bool link_send(LinkPort *port, uint8_t type, const void *payload, uint16_t len); // sends one packet. Only from the port's task
+
+LinkPort *link_find(const char *name); // NULL if no port by that name is being served
+void link_report(); // prints the stats of every port
+
+
+#endif /* CODE_LINK_H_ */
@@ -0,0 +1,393 @@
+/*
+ * mon.c
+ */
+
+#include "code/mon.h"
+#include "code/timebase.h"
+#include "code/util.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <xdc/runtime/Memory.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Swi.h>
+#include <ti/sysbios/family/arm/m3/Hwi.h>
+#include "code/noalloc.h"
+
+#define MON_MAX_DEPTH	16	// Swis and Hwis nested on top of a task
+
+
+static MonSlot monSlots[MON_MAX_SLOTS];
+static uint8_t monNumSlots;
+
+static Int monTaskId, monSwiId, monHwiId;	// hook set ids
+
+// Swis and Hwis in progress, innermost last
+static uint32_t monStart[MON_MAX_DEPTH];
+static uint32_t monNestAt[MON_MAX_DEPTH];
+static uint8_t monDepth;
+static volatile uint32_t monIsrTotal;	// cycles used by every Swi and Hwi
+
+// the running task's time slice
+static MonSlot *monTaskSlot;
+static uint32_t monSliceStart;
+static uint32_t monSliceIsr;
+
+static MonSample monHist[MON_HIST];
+static uint32_t monSeq;			// samples taken
+static uint32_t monLastSample;	// cycle count at the last sample
+static uint32_t monHeapPeak;
+static volatile uint32_t monHeapSize;	// from the last mon_pollHeap()
+static volatile uint32_t monHeapUsed;
+static uint8_t monCalls;
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Hooks ////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Gives a thread a slot, the first time it runs. Interrupts have to be off
+ */
+static MonSlot *mon_newSlot(uint8_t kind, void *handle, const char *name)
+{
+	MonSlot *s;
+
+	if(monNumSlots >= MON_MAX_SLOTS)
+		return &monSlots[MON_MAX_SLOTS - 1];
+
+	s = &monSlots[monNumSlots++];
+	s->kind = kind;
+	s->handle = handle;
+	s->name = monNumSlots == MON_MAX_SLOTS ? "other" : (name && *name ? name : "?");
+
+	return s;
+}
+
+
+
+
+/**
+ * Starts timing a Swi or Hwi, on top of whatever it preempted
+ */
+RAMFUNC static void mon_push()
+{
+	if(monDepth < MON_MAX_DEPTH)
+	{
+		monStart[monDepth] = cycleCount();
+		monNestAt[monDepth] = monIsrTotal;
+	}
+
+	monDepth++;
+}
+
+
+
+
+/**
+ * Stops timing the innermost Swi or Hwi, and charges it to its slot less
+ * anything that was nested inside of it
+ */
+RAMFUNC static void mon_pop(MonSlot *s)
+{
+	if(!monDepth) { return; }
+
+	if(--monDepth < MON_MAX_DEPTH)
+	{
+		uint32_t used = (cycleCount() - monStart[monDepth]) - (monIsrTotal - monNestAt[monDepth]);
+		monIsrTotal += used;
+		if(s) { s->total += used; }
+	}
+}
+
+
+
+
+void mon_taskRegister(Int id)
+{
+	monTaskId = id;
+}
+
+
+
+/**
+ * Charges the outgoing task for its slice, less the Swis and Hwis that ran
+ * in it
+ */
+RAMFUNC void mon_taskSwitch(Task_Handle prev, Task_Handle next)
+{
+	UInt key = Hwi_disable();
+	uint32_t now = cycleCount(), isr = monIsrTotal;
+
+	if(monTaskSlot) { monTaskSlot->total += (now - monSliceStart) - (isr - monSliceIsr); }
+
+	MonSlot *s = Task_getHookContext(next, monTaskId);
+	if(!s)
+	{
+		s = mon_newSlot(MON_TASK, next, Task_Handle_name(next));
+		Task_setHookContext(next, monTaskId, s);
+	}
+
+	monTaskSlot = s;
+	monSliceStart = now;
+	monSliceIsr = isr;
+
+	Hwi_restore(key);
+}
+
+
+
+
+void mon_swiRegister(Int id)
+{
+	monSwiId = id;
+}
+
+
+
+RAMFUNC void mon_swiBegin(Swi_Handle swi)
+{
+	UInt key = Hwi_disable();
+	mon_push();
+	Hwi_restore(key);
+}
+
+
+
+RAMFUNC void mon_swiEnd(Swi_Handle swi)
+{
+	UInt key = Hwi_disable();
+
+	MonSlot *s = Swi_getHookContext(swi, monSwiId);
+	if(!s)
+	{
+		s = mon_newSlot(MON_SWI, swi, Swi_Handle_name(swi));
+		Swi_setHookContext(swi, monSwiId, s);
+	}
+
+	mon_pop(s);
+	Hwi_restore(key);
+}
+
+
+
+
+void mon_hwiRegister(Int id)
+{
+	monHwiId = id;
+}
+
+
+
+RAMFUNC void mon_hwiBegin(Hwi_Handle hwi)
+{
+	UInt key = Hwi_disable();
+	mon_push();
+	Hwi_restore(key);
+}
+
+
+
+RAMFUNC void mon_hwiEnd(Hwi_Handle hwi)
+{
+	UInt key = Hwi_disable();
+
+	MonSlot *s = Hwi_getHookContext(hwi, monHwiId);
+	if(!s)
+	{
+		s = mon_newSlot(MON_HWI, hwi, Hwi_Handle_name(hwi));
+		Hwi_setHookContext(hwi, monHwiId, s);
+	}
+
+	mon_pop(s);
+	Hwi_restore(key);
+}
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Sampling /////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+void mon_service()
+{
+	if(++monCalls < MON_PERIOD) { return; }
+
+	monCalls = 0;
+	mon_sample();
+}
+
+
+
+
+/**
+ * Reads the heap use for the next sample. Memory_getStats() goes through the
+ * heap's gate, a GateMutex by default, which can't be entered from the
+ * housekeeping Swi, so a task has to call this. Once a second is plenty
+ */
+void mon_pollHeap()
+{
+	Memory_Stats heap;
+	Memory_getStats(NULL, &heap);
+
+	UInt key = Hwi_disable();
+	monHeapSize = heap.totalSize;
+	monHeapUsed = heap.totalSize - heap.totalFreeSize;
+	Hwi_restore(key);
+}
+
+
+
+
+/**
+ * Works out the loads over the time since the last sample, and records the
+ * stack use, and the heap use from the last mon_pollHeap(). Task_stat() scans
+ * each task's stack for the fill pattern, which is most of the time this takes
+ */
+void mon_sample()
+{
+	MonSample *smp = &monHist[monSeq % MON_HIST];
+	uint32_t now = cycleCount(), window = now - monLastSample;
+	uint16_t idle = 0;
+	uint8_t i, n = monNumSlots;
+
+	Hwi_StackInfo stk;
+	Task_Stat stat;
+
+	monLastSample = now;
+	if(!window) { return; }
+
+	smp->seq = monSeq;
+	smp->timeMs = (uint32_t)(currTime() / 1000);
+	smp->numSlots = n;
+
+	for(i = 0; i < n; i++)
+	{
+		MonSlot *s = &monSlots[i];
+		uint32_t total = s->total;
+
+		s->load = (uint16_t)(((uint64_t)(total - s->windowStart) * 1000) / window);
+		s->windowStart = total;
+		if(s->load > s->maxLoad) { s->maxLoad = s->load; }
+
+		if(s->kind == MON_TASK)
+		{
+			Task_stat(s->handle, &stat);
+			s->stackSize = stat.stackSize;
+			s->stackPeak = stat.used;
+			if(s->handle == Task_getIdleTask()) { idle = s->load; }
+		}
+
+		smp->load[i] = s->load;
+		smp->stackPeak[i] = s->stackPeak;
+	}
+
+	smp->cpuLoad = idle < 1000 ? 1000 - idle : 0;
+
+	Hwi_getStackInfo(&stk, TRUE);
+	smp->hwiStackSize = stk.hwiStackSize;
+	smp->hwiStackPeak = stk.hwiStackPeak;
+
+	smp->heapSize = monHeapSize;
+	smp->heapUsed = monHeapUsed;
+	if(smp->heapUsed > monHeapPeak) { monHeapPeak = smp->heapUsed; }
+	smp->heapPeak = monHeapPeak;
+
+	monSeq++;
+}
+
+
+
+
+uint8_t mon_getNumSlots()
+{
+	return monNumSlots;
+}
+
+
+
+const MonSlot *mon_getSlot(uint8_t slot)
+{
+	return slot < monNumSlots ? &monSlots[slot] : NULL;
+}
+
+
+
+int8_t mon_findSlot(const char *name)
+{
+	uint8_t i;
+
+	for(i = 0; i < monNumSlots; i++)
+	{
+		if(!strcmp(name, monSlots[i].name)) { return i; }
+	}
+
+	return -1;
+}
+
+
+
+const MonSample *mon_getLatest()
+{
+	return monSeq ? &monHist[(monSeq - 1) % MON_HIST] : NULL;
+}
+
+
+
+
+/**
+ * @param seq sample number, counting from 0
+ * @param out where to copy the sample
+ *
+ * @return false if the sample hasn't been taken yet, or is too old to still be kept
+ */
+bool mon_getSample(uint32_t seq, MonSample *out)
+{
+	UInt key = Hwi_disable();
+	bool ok = seq < monSeq && monSeq - seq <= MON_HIST;
+
+	if(ok) { *out = monHist[seq % MON_HIST]; }
+
+	Hwi_restore(key);
+	return ok;
+}
+
+
+
+
+void mon_report()
+{
+	const MonSample *smp = mon_getLatest();
+	uint8_t i;
+
+	if(!smp)
+	{
+		System_printf("mon: no samples yet\n");
+		System_flush();
+		return;
+	}
+
+	System_printf("mon: cpu %d.%d%%, system stack %d/%d, heap %d/%d (peak %d)\n", smp->cpuLoad / 10, smp->cpuLoad % 10,
+			smp->hwiStackPeak, smp->hwiStackSize, smp->heapUsed, smp->heapSize, smp->heapPeak);
+
+	for(i = 0; i < smp->numSlots; i++)
+	{
+		const MonSlot *s = &monSlots[i];
+
+		if(s->kind == MON_TASK)
+			System_printf("mon: task %s %d.%d%%, stack %d/%d\n", s->name, smp->load[i] / 10, smp->load[i] % 10, s->stackPeak, s->stackSize);
+		else
+			System_printf("mon: %s %s %d.%d%%\n", s->kind == MON_SWI ? "swi" : "hwi", s->name, smp->load[i] / 10, smp->load[i] % 10);
+	}
+
+	System_flush();
+}
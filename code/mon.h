@@ -0,0 +1,93 @@
+/*
+ * mon.h
+ *
+ * CPU load, stack and heap monitor. BIOS hooks time every task, Swi and Hwi
+ * with the cycle counter, each one less whatever preempted it, so every
+ * thread only carries its own time. Once a second the housekeeping group
+ * turns the totals into loads, checks the task and system stack high water
+ * marks and the heap, and adds a sample to the telemetry ring. The heap is
+ * read by a task (mon_pollHeap()), since its gate can't be taken in a Swi.
+ * The link telemetry carries the latest sample's totals.
+ *
+ * Zero latency Hwis bypass the BIOS dispatcher, so they don't run the hooks.
+ * Their time is counted against whatever they interrupted (isrlat.h covers
+ * them instead). Threads get a slot the first time they run, in that order,
+ * and anything past MON_MAX_SLOTS shares the last one
+ */
+
+#ifndef CODE_MON_H_
+#define CODE_MON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Swi.h>
+#include <ti/sysbios/family/arm/m3/Hwi.h>
+
+#define MON_MAX_SLOTS	24		// threads that are tracked separately
+#define MON_HIST		4		// samples kept in the telemetry ring
+#define MON_PERIOD		10		// housekeeping runs per sample (1s)
+
+// thread kinds
+#define MON_TASK		0
+#define MON_SWI			1
+#define MON_HWI			2
+
+
+typedef struct MonSlot
+{
+	uint8_t kind;
+	const char *name;
+	void *handle;
+	uint32_t total;			// cycles used since startup. Wraps
+	uint32_t windowStart;	// total at the last sample
+	uint16_t load;			// fraction of the CPU over the last sample, in 1/10ths of a percent
+	uint16_t maxLoad;
+	uint32_t stackSize;		// tasks only (bytes)
+	uint32_t stackPeak;		// most of the stack ever used (bytes)
+} MonSlot;
+
+
+/**
+ * One telemetry sample. The slot arrays line up with mon_getSlot()
+ */
+typedef struct MonSample
+{
+	uint32_t seq;
+	uint32_t timeMs;		// currTime() at the sample
+	uint16_t cpuLoad;		// everything but the idle task, in 1/10ths of a percent
+	uint8_t numSlots;
+	uint16_t load[MON_MAX_SLOTS];
+	uint16_t stackPeak[MON_MAX_SLOTS];
+	uint32_t hwiStackSize;	// system stack, shared by the Hwis and Swis
+	uint32_t hwiStackPeak;
+	uint32_t heapSize;
+	uint32_t heapUsed;
+	uint32_t heapPeak;		// most of the heap ever in use, as of the samples
+} MonSample;
+
+
+void mon_service(); // takes a sample every MON_PERIOD calls. The housekeeping group job
+void mon_sample(); // takes a sample now
+void mon_pollHeap(); // reads the heap use for the samples. Task context only
+
+uint8_t mon_getNumSlots();
+const MonSlot *mon_getSlot(uint8_t slot);
+int8_t mon_findSlot(const char *name); // -1 if no thread by that name has run yet
+const MonSample *mon_getLatest(); // NULL before the first sample
+bool mon_getSample(uint32_t seq, MonSample *out); // copies out an older sample. false if it has been overwritten
+void mon_report(); // prints the latest sample
+
+// BIOS hook functions, set up in empty.cfg
+void mon_taskRegister(Int id);
+void mon_taskSwitch(Task_Handle prev, Task_Handle next);
+void mon_swiRegister(Int id);
+void mon_swiBegin(Swi_Handle swi);
+void mon_swiEnd(Swi_Handle swi);
+void mon_hwiRegister(Int id);
+void mon_hwiBegin(Hwi_Handle hwi);
+void mon_hwiEnd(Hwi_Handle hwi);
+
+
+#endif /* CODE_MON_H_ */
@@ -0,0 +1,24 @@
+/*
+ * motion.h
+ *
+ * Types shared by everything that generates or consumes tool space motion
+ */
+
+#ifndef CODE_MOTION_H_
+#define CODE_MOTION_H_
+
+
+/**
+ * A position of the tool (effector) in cartesian space, along with the
+ * extruder position. Same units as everything else (inches)
+ */
+typedef struct ToolPos
+{
+	float x;
+	float y;
+	float z;
+	float e;
+} ToolPos;
+
+
+#endif /* CODE_MOTION_H_ */
@@ -0,0 +1,47 @@
+/*
+ * noalloc.h
+ *
+ * Keeps the control path allocation free. Every file with Hwi, servo tick or
+ * rate group code includes this last, after all of its other includes. It
+ * turns the heap calls into calls to functions that don't exist anywhere, so
+ * an allocation that sneaks into one of those files fails the link, naming the
+ * call it came from (eg. "unresolved symbol noalloc_malloc").
+ *
+ * Fixed size blocks come from the pools in pool.h instead, which never touch
+ * the heap
+ */
+
+#ifndef CODE_NOALLOC_H_
+#define CODE_NOALLOC_H_
+
+#include <stddef.h>
+
+extern void *noalloc_malloc(size_t size);
+extern void *noalloc_calloc(size_t n, size_t size);
+extern void *noalloc_realloc(void *p, size_t size);
+extern void noalloc_free(void *p);
+extern void *noalloc_Memory_alloc();
+extern void *noalloc_Memory_calloc();
+extern void *noalloc_Memory_valloc();
+extern void noalloc_Memory_free();
+
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#undef Memory_alloc
+#undef Memory_calloc
+#undef Memory_valloc
+#undef Memory_free
+
+#define malloc			noalloc_malloc
+#define calloc			noalloc_calloc
+#define realloc			noalloc_realloc
+#define free(p)			noalloc_free(p)
+#define Memory_alloc	noalloc_Memory_alloc
+#define Memory_calloc	noalloc_Memory_calloc
+#define Memory_valloc	noalloc_Memory_valloc
+#define Memory_free		noalloc_Memory_free
+
+
+#endif /* CODE_NOALLOC_H_ */
@@ -0,0 +1,504 @@
+/*
+ * nvstore.c
+ */
+
+#include "code/nvstore.h"
+#include "code/util.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <driverlib/eeprom.h>
+#include <driverlib/flash.h>
+#include <driverlib/sysctl.h>
+
+#define NV_MAGIC	0x564e	// "NV"
+#define NV_CHUNK	64		// bytes moved through the word buffer at a time. Must be a multiple of 4
+
+
+/**
+ * Header at the start of every record. The payload follows it, padded out to
+ * a whole number of words
+ */
+typedef struct NvRecHdr
+{
+	uint16_t magic;
+	uint8_t type;	// NV_REC_xxx
+	uint8_t ver;	// version of the payload layout, set by the owner of the type
+	uint32_t len;	// payload length, before padding
+	uint32_t seq;	// store wide sequence number
+	uint32_t crc;	// CRC-32 of the rest of the header and the payload
+} NvRecHdr;
+
+#define NV_HDR_LEN		sizeof(NvRecHdr)
+#define NV_PAD(len)		(((len) + 3) & ~3)
+
+
+static uint8_t nvBackend = NV_BACKEND_NONE;
+static uint32_t nvBankLen;
+static uint8_t nvBank;			// active bank
+static uint32_t nvWrPos;		// offset of the end of the log in the active bank
+static uint32_t nvSeq;			// newest sequence number in use
+static uint32_t nvLatest[NV_NUM_TYPES]; // offset of the newest record of each type in the active bank. 0 if there isn't one
+static uint32_t nvCompactions;
+static uint32_t nvBuf[NV_CHUNK / 4];
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////// Backing memory ////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+static uint32_t nv_addr(uint8_t bank, uint32_t off)
+{
+	return bank * nvBankLen + off;
+}
+
+
+
+static void nv_readWords(uint32_t addr, uint32_t *buf, uint32_t len)
+{
+	if(nvBackend == NV_BACKEND_EEPROM)
+		EEPROMRead(buf, addr, len);
+	else
+		memcpy(buf, (const void *)(NV_FLASH_BASE + addr), len);
+}
+
+
+
+static bool nv_progWords(uint32_t addr, uint32_t *buf, uint32_t len)
+{
+	if(nvBackend == NV_BACKEND_EEPROM)
+		return EEPROMProgram(buf, addr, len) == 0;
+	else
+		return FlashProgram(buf, NV_FLASH_BASE + addr, len) == 0;
+}
+
+
+
+
+/**
+ * Reads any number of bytes into an unaligned buffer. addr must be word aligned
+ */
+static void nv_readBytes(uint32_t addr, void *buf, uint32_t len)
+{
+	uint8_t *p = (uint8_t *)buf;
+
+	while(len)
+	{
+		uint32_t n = len < NV_CHUNK ? len : NV_CHUNK;
+		nv_readWords(addr, nvBuf, NV_PAD(n));
+		memcpy(p, nvBuf, n);
+
+		p += n;
+		addr += n;
+		len -= n;
+	}
+}
+
+
+
+
+/**
+ * Programs any number of bytes from an unaligned buffer. The last word is
+ * padded with 0xff. addr must be word aligned
+ */
+static bool nv_progBytes(uint32_t addr, const void *buf, uint32_t len)
+{
+	const uint8_t *p = (const uint8_t *)buf;
+
+	while(len)
+	{
+		uint32_t n = len < NV_CHUNK ? len : NV_CHUNK;
+		memset(nvBuf, 0xff, NV_CHUNK);
+		memcpy(nvBuf, p, n);
+
+		if(!nv_progWords(addr, nvBuf, NV_PAD(n))) { return false; }
+
+		p += n;
+		addr += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+
+
+
+static uint32_t nv_crcRange(uint32_t crc, uint32_t addr, uint32_t len)
+{
+	while(len)
+	{
+		uint32_t n = len < NV_CHUNK ? len : NV_CHUNK;
+		nv_readWords(addr, nvBuf, NV_PAD(n));
+		crc = crc32(crc, nvBuf, n);
+
+		addr += n;
+		len -= n;
+	}
+
+	return crc;
+}
+
+
+
+
+static bool nv_isBlank(uint32_t addr, uint32_t len)
+{
+	while(len)
+	{
+		uint32_t n = len < NV_CHUNK ? len : NV_CHUNK, i;
+		nv_readWords(addr, nvBuf, n);
+
+		for(i = 0; i < n / 4; i++)
+		{
+			if(nvBuf[i] != 0xffffffff) { return false; }
+		}
+
+		addr += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Copies a word aligned range from one spot in the store to another
+ */
+static bool nv_copy(uint32_t dst, uint32_t src, uint32_t len)
+{
+	while(len)
+	{
+		uint32_t n = len < NV_CHUNK ? len : NV_CHUNK;
+		nv_readWords(src, nvBuf, n);
+
+		if(!nv_progWords(dst, nvBuf, n)) { return false; }
+
+		src += n;
+		dst += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Brings a bank back to the blank state. The EEPROM doesn't need erasing to
+ * be rewritten, but the scan expects unused space to read back as 0xff. A bank
+ * that already reads back blank is left alone, to save the wear and the time
+ */
+static bool nv_eraseBank(uint8_t bank)
+{
+	uint32_t off;
+
+	if(nv_isBlank(nv_addr(bank, 0), nvBankLen)) { return true; }
+
+	if(nvBackend == NV_BACKEND_FLASH)
+		return FlashErase(NV_FLASH_BASE + nv_addr(bank, 0)) == 0;
+
+	memset(nvBuf, 0xff, NV_CHUNK);
+	for(off = 0; off < nvBankLen; off += NV_CHUNK)
+	{
+		if(!nv_progWords(nv_addr(bank, off), nvBuf, NV_CHUNK)) { return false; }
+	}
+
+	return true;
+}
+
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////// Records ////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Reads and checks the record at an offset in a bank
+ *
+ * @return true if there is a complete record there with a good CRC
+ */
+static bool nv_readRec(uint8_t bank, uint32_t off, NvRecHdr *hdr)
+{
+	if(off + NV_HDR_LEN > nvBankLen) { return false; }
+
+	nv_readBytes(nv_addr(bank, off), hdr, NV_HDR_LEN);
+	if(hdr->magic != NV_MAGIC || hdr->len > nvBankLen - NV_HDR_LEN - off) { return false; }
+
+	uint32_t crc = crc32(0, hdr, offsetof(NvRecHdr, crc));
+	crc = nv_crcRange(crc, nv_addr(bank, off + NV_HDR_LEN), hdr->len);
+
+	return crc == hdr->crc;
+}
+
+
+
+
+/**
+ * Writes a record to a bank. The payload goes first, so the record doesn't
+ * exist until the header lands on top of it. Takes the next sequence number
+ * if it succeeds
+ */
+static bool nv_writeRec(uint8_t bank, uint32_t off, uint8_t type, uint8_t ver, const void *buf, uint32_t len)
+{
+	NvRecHdr hdr = { .magic = NV_MAGIC, .type = type, .ver = ver, .len = len, .seq = nvSeq + 1 };
+	NvRecHdr chk;
+
+	hdr.crc = crc32(crc32(0, &hdr, offsetof(NvRecHdr, crc)), buf, len);
+
+	if(!nv_progBytes(nv_addr(bank, off + NV_HDR_LEN), buf, len)) { return false; }
+	if(!nv_progBytes(nv_addr(bank, off), &hdr, NV_HDR_LEN)) { return false; }
+	if(!nv_readRec(bank, off, &chk) || chk.seq != hdr.seq) { return false; }
+
+	nvSeq = hdr.seq;
+	return true;
+}
+
+
+
+
+/**
+ * Erases a bank and marks it as the active one. Only used when the store is blank
+ */
+static bool nv_format(uint8_t bank)
+{
+	if(!nv_eraseBank(bank) || !nv_writeRec(bank, 0, NV_REC_BANK, 0, NULL, 0)) { return false; }
+
+	memset(nvLatest, 0, sizeof(nvLatest));
+	nvBank = bank;
+	nvWrPos = NV_HDR_LEN;
+	return true;
+}
+
+
+
+
+/**
+ * Copies the newest record of each type into the other bank, then marks that
+ * bank active. Nothing changes if it is interrupted, since the marker that
+ * makes the new bank live is the last thing written
+ */
+static bool nv_compact()
+{
+	uint8_t dst = nvBank ^ 1;
+	uint32_t newLatest[NV_NUM_TYPES] = { 0 };
+	uint32_t off = NV_HDR_LEN;
+	uint8_t t;
+
+	if(!nv_eraseBank(dst)) { return false; }
+
+	for(t = 0; t < NV_NUM_TYPES; t++)
+	{
+		NvRecHdr hdr;
+		if(!nvLatest[t]) { continue; }
+
+		nv_readBytes(nv_addr(nvBank, nvLatest[t]), &hdr, NV_HDR_LEN);
+		uint32_t recLen = NV_HDR_LEN + NV_PAD(hdr.len);
+
+		if(!nv_copy(nv_addr(dst, off), nv_addr(nvBank, nvLatest[t]), recLen)) { return false; }
+
+		newLatest[t] = off;
+		off += recLen;
+	}
+
+	if(!nv_writeRec(dst, 0, NV_REC_BANK, 0, NULL, 0)) { return false; }
+
+	memcpy(nvLatest, newLatest, sizeof(nvLatest));
+	nvBank = dst;
+	nvWrPos = off;
+	nvCompactions++;
+	return true;
+}
+
+
+
+
+/**
+ * Finds the active bank, and walks its log to find the newest record of each
+ * type and the end of the log. Formats the store if neither bank is marked
+ */
+static bool nv_scan()
+{
+	NvRecHdr hdr;
+	uint32_t markSeq[2];
+	bool marked[2];
+	uint8_t b;
+
+	for(b = 0; b < 2; b++)
+	{
+		marked[b] = nv_readRec(b, 0, &hdr) && hdr.type == NV_REC_BANK;
+		markSeq[b] = hdr.seq;
+	}
+
+	if(!marked[0] && !marked[1])
+	{
+		System_printf("nvstore: formatting\n");
+		nvSeq = 0;
+		return nv_format(0);
+	}
+
+	// if both are marked, the newer one is the result of the last compaction
+	if(marked[0] && marked[1])
+		nvBank = (int32_t)(markSeq[1] - markSeq[0]) > 0;
+	else
+		nvBank = marked[1];
+
+	memset(nvLatest, 0, sizeof(nvLatest));
+	nvSeq = markSeq[nvBank];
+	nvWrPos = NV_HDR_LEN;
+
+	while(nv_readRec(nvBank, nvWrPos, &hdr))
+	{
+		if(hdr.type < NV_NUM_TYPES && hdr.type != NV_REC_BANK) { nvLatest[hdr.type] = nvWrPos; }
+		if((int32_t)(hdr.seq - nvSeq) > 0) { nvSeq = hdr.seq; }
+
+		nvWrPos += NV_HDR_LEN + NV_PAD(hdr.len);
+	}
+
+	return true;
+}
+
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////// Public /////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Starts the EEPROM, falling back to flash if it won't come up, and finds the
+ * newest records. SYSCTL_PERIPH_EEPROM0 must already be enabled
+ *
+ * @return true if the store is ready to use
+ */
+bool nv_init()
+{
+	if(EEPROMInit() == EEPROM_INIT_OK && EEPROMSizeGet() >= 2 * NV_EEPROM_BANK)
+	{
+		nvBackend = NV_BACKEND_EEPROM;
+		nvBankLen = NV_EEPROM_BANK;
+	} else
+	{
+		System_printf("nvstore: EEPROM failed, using flash\n");
+		nvBackend = NV_BACKEND_FLASH;
+		nvBankLen = NV_FLASH_BANK;
+	}
+
+	nvCompactions = 0;
+
+	if(!nv_scan())
+	{
+		System_printf("nvstore: no usable storage\n");
+		nvBackend = NV_BACKEND_NONE;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Reads the newest record of a type
+ *
+ * @param type NV_REC_xxx
+ * @param ver payload version the caller understands. Records of any other version are ignored
+ * @param buf where to put the payload
+ * @param maxLen size of buf
+ * @param len if not NULL, gets the length of the payload
+ *
+ * @return true if a good record was found and fit in buf
+ */
+bool nv_read(uint8_t type, uint8_t ver, void *buf, uint32_t maxLen, uint32_t *len)
+{
+	NvRecHdr hdr;
+
+	if(nvBackend == NV_BACKEND_NONE || type >= NV_NUM_TYPES || !nvLatest[type]) { return false; }
+	if(!nv_readRec(nvBank, nvLatest[type], &hdr) || hdr.ver != ver || hdr.len > maxLen) { return false; }
+
+	nv_readBytes(nv_addr(nvBank, nvLatest[type] + NV_HDR_LEN), buf, hdr.len);
+	if(len) { *len = hdr.len; }
+
+	return true;
+}
+
+
+
+
+/**
+ * Appends a new record, which supersedes any older one of the same type. The
+ * active bank is compacted first if there isn't room, or if an interrupted
+ * write left the end of the log dirty. Blocks for the whole write, so don't
+ * call it while moving
+ *
+ * @return true if the record was written and read back good
+ */
+bool nv_write(uint8_t type, uint8_t ver, const void *buf, uint32_t len)
+{
+	if(nvBackend == NV_BACKEND_NONE || type == NV_REC_BANK || type >= NV_NUM_TYPES) { return false; }
+
+	uint32_t recLen = NV_HDR_LEN + NV_PAD(len);
+
+	if(nvWrPos + recLen > nvBankLen || !nv_isBlank(nv_addr(nvBank, nvWrPos), recLen))
+	{
+		if(!nv_compact())
+		{
+			System_printf("nvstore: compaction failed\n");
+			return false;
+		}
+
+		if(nvWrPos + recLen > nvBankLen)
+		{
+			System_printf("nvstore: no room for a %d byte record\n", len);
+			return false;
+		}
+	}
+
+	// a failed write leaves the end of the log dirty, so the next one compacts past it
+	if(!nv_writeRec(nvBank, nvWrPos, type, ver, buf, len)) { return false; }
+
+	nvLatest[type] = nvWrPos;
+	nvWrPos += recLen;
+	return true;
+}
+
+
+
+
+uint8_t nv_getBackend()
+{
+	return nvBackend;
+}
+
+
+
+uint32_t nv_getFree()
+{
+	return nvBackend == NV_BACKEND_NONE ? 0 : nvBankLen - nvWrPos;
+}
+
+
+
+uint32_t nv_getCompactions()
+{
+	return nvCompactions;
+}
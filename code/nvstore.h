@@ -0,0 +1,50 @@
+/*
+ * nvstore.h
+ *
+ * Persistent storage for the config and calibration data in the on chip
+ * EEPROM, so they are available within a few ms of reset without having to
+ * bring up the SD card. If the EEPROM fails to initialize, the last two flash
+ * sectors are used instead.
+ *
+ * The store is an append only log of records, each tagged with a type,
+ * a version and a CRC-32. Reading a type returns its newest good record. The
+ * store is split into two banks, and when the active one fills up the newest
+ * record of each type is copied to the other, so every word is written once per
+ * pass over the store. A bank only becomes active once its copy is complete,
+ * and records are only visible once their header is written (after the
+ * payload), so losing power part way through a write leaves the previous
+ * contents intact
+ */
+
+#ifndef CODE_NVSTORE_H_
+#define CODE_NVSTORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// backing memory in use
+#define NV_BACKEND_NONE		0
+#define NV_BACKEND_EEPROM	1
+#define NV_BACKEND_FLASH	2
+
+#define NV_EEPROM_BANK		0x0c00	// half of the 6K EEPROM
+#define NV_FLASH_BASE		0xf8000	// last two flash sectors. Kept out of the image by EK_TM4C1294XL.cmd
+#define NV_FLASH_BANK		0x4000	// one flash sector
+
+// record types
+#define NV_REC_BANK			0	// marks a bank as complete. Used internally
+#define NV_REC_CONFIG		1	// binary config image, as made by config_pack()
+#define NV_REC_MESH			2	// bed mesh, MeshDat
+#define NV_NUM_TYPES		4
+
+
+bool nv_init(); // finds the backing memory and scans it for records. false if neither is usable
+bool nv_read(uint8_t type, uint8_t ver, void *buf, uint32_t maxLen, uint32_t *len); // reads the newest record of a type
+bool nv_write(uint8_t type, uint8_t ver, const void *buf, uint32_t len); // appends a new record of a type
+
+uint8_t nv_getBackend(); // NV_BACKEND_xxx
+uint32_t nv_getFree(); // bytes left in the active bank before it is compacted
+uint32_t nv_getCompactions(); // times a bank was compacted since nv_init()
+
+
+#endif /* CODE_NVSTORE_H_ */
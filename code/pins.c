@@ -0,0 +1,84 @@
+/*
+ * pins.c
+ */
+
+#include "code/pins.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <inc/hw_memmap.h>
+#include <driverlib/gpio.h>
+#include <driverlib/pin_map.h>
+
+#define PIN_DESC(name, port, pin, mode, drive, irq, af) \
+	{ GPIO_PORT##port##_BASE, GPIO_PIN_##pin, mode, irq, GPIO_STRENGTH_##drive, af },
+
+static const PinDesc pinsTbl[] = { PINS_TABLE(PIN_DESC) };
+
+#define PINS_NUM (sizeof(pinsTbl) / sizeof(pinsTbl[0]))
+
+
+
+
+static void pins_initPin(const PinDesc *p)
+{
+	switch(p->mode)
+	{
+	case PIN_OUT:
+		GPIODirModeSet(p->base, p->pin, GPIO_DIR_MODE_OUT);
+		GPIOPadConfigSet(p->base, p->pin, p->drive, GPIO_PIN_TYPE_STD);
+		break;
+
+	case PIN_IN:
+		GPIODirModeSet(p->base, p->pin, GPIO_DIR_MODE_IN);
+		GPIOPadConfigSet(p->base, p->pin, p->drive, GPIO_PIN_TYPE_STD_WPU);
+		break;
+
+	case PIN_ANALOG:
+		GPIOPinTypeADC(p->base, p->pin);
+		break;
+
+	case PIN_SSI:
+		GPIOPinTypeSSI(p->base, p->pin);
+		break;
+
+	case PIN_TIMER:
+		GPIOPinTypeTimer(p->base, p->pin);
+		break;
+
+	case PIN_PWM:
+		GPIOPinTypePWM(p->base, p->pin);
+		break;
+	}
+
+	if(p->af) { GPIOPinConfigure(p->af); }
+
+	// set the edge mode and drop anything latched while the pin was
+	// floating, before the interrupt is unmasked
+	if(p->irq)
+	{
+		GPIOIntTypeSet(p->base, p->pin, GPIO_BOTH_EDGES);
+		GPIOIntClear(p->base, p->pin);
+		GPIOIntEnable(p->base, p->pin);
+	}
+}
+
+
+
+
+/**
+ * @param base GPIO port base address. The port has to be enabled already
+ */
+void pins_initPort(uint32_t base)
+{
+	uint32_t i;
+
+	// ports P and Q have a vector per pin unless summary mode is on. Their
+	// pin handlers all sit on the pin 0 vector (empty.cfg), so turn it on
+	// before any pin's interrupt is unmasked
+	if(base == GPIO_PORTP_BASE || base == GPIO_PORTQ_BASE) { HWREG(base + GPIO_O_SI) = 1; }
+
+	for(i = 0; i < PINS_NUM; i++)
+	{
+		if(pinsTbl[i].base == base) { pins_initPin(&pinsTbl[i]); }
+	}
+}
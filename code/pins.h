@@ -0,0 +1,153 @@
+/*
+ * pins.h
+ *
+ * The board's pin table. Every GPIO pin the firmware uses is listed once in
+ * PINS_TABLE, which both sets the pins up (pins_initPort()) and gives each
+ * one a fixed data register address for the fast accessors.
+ *
+ * The GPIODATA register is aliased over 256 addresses, and bits 9:2 of the
+ * address mask which pins a read or write touches. A pin's own alias reads
+ * back only that pin and writes only that pin, so PIN_READ() and PIN_WRITE()
+ * are a single load or store, with no read-modify-write and no driverlib call
+ */
+
+#ifndef CODE_PINS_H_
+#define CODE_PINS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_types.h>
+#include <inc/hw_gpio.h>
+#include <driverlib/gpio.h>
+#include <driverlib/pin_map.h>
+
+// pin modes
+#define PIN_OUT			0	// push-pull output
+#define PIN_IN			1	// input, weak pull up
+#define PIN_ANALOG		2	// ADC input
+#define PIN_SSI			3	// alternate functions
+#define PIN_TIMER		4
+#define PIN_PWM			5
+
+
+/**
+ * name, port, pin, mode, drive strength, interrupt on both edges, alternate
+ * function (for GPIOPinConfigure(), 0 if none). The drive strength only
+ * means anything for inputs and outputs
+ */
+#define PINS_TABLE(X) \
+	X(LED1,			A, 4, PIN_OUT,		8MA, 0, 0) \
+	X(STEP1_EN,		A, 5, PIN_OUT,		8MA, 0, 0) \
+	X(GEN5,			A, 6, PIN_IN,		8MA, 1, 0) \
+	\
+	X(GEN1,			B, 2, PIN_IN,		8MA, 1, 0) \
+	X(GEN2,			B, 3, PIN_IN,		8MA, 1, 0) \
+	X(SD_CS,		B, 4, PIN_OUT,		8MA, 0, 0)	/* driven by the SDSPI driver */ \
+	X(SD_CLK,		B, 5, PIN_SSI,		8MA, 0, GPIO_PB5_SSI1CLK) \
+	\
+	X(AXA_DIR,		C, 4, PIN_OUT,		8MA, 0, 0)	/* H-bridge direction, see MOT_MODE_HBRIDGE */ \
+	X(AXB_DIR,		C, 5, PIN_OUT,		8MA, 0, 0) \
+	X(AXC_DIR,		C, 6, PIN_OUT,		8MA, 0, 0) \
+	\
+	X(AXB_ET,		D, 0, PIN_IN,		4MA, 1, 0) \
+	X(AXA_ENCB,		D, 1, PIN_IN,		4MA, 1, 0) \
+	X(STEP1_DIR,	D, 4, PIN_OUT,		8MA, 0, 0) \
+	X(STEP1_STEP,	D, 5, PIN_TIMER,	8MA, 0, GPIO_PD5_T3CCP1) \
+	X(AIN_GEN1,		D, 7, PIN_ANALOG,	8MA, 0, 0) \
+	\
+	X(AIN_GEN5,		E, 0, PIN_ANALOG,	8MA, 0, 0) \
+	X(AIN_GEN4,		E, 1, PIN_ANALOG,	8MA, 0, 0) \
+	X(AIN_GEN3,		E, 2, PIN_ANALOG,	8MA, 0, 0) \
+	X(AIN_GEN2,		E, 3, PIN_ANALOG,	8MA, 0, 0) \
+	X(SD_MOSI,		E, 4, PIN_SSI,		8MA, 0, GPIO_PE4_SSI1XDAT0) \
+	X(SD_MISO,		E, 5, PIN_SSI,		8MA, 0, GPIO_PE5_SSI1XDAT1) \
+	\
+	X(AXB_MOT,		F, 1, PIN_PWM,		8MA, 0, GPIO_PF1_M0PWM1) \
+	X(AXA_MOT,		F, 2, PIN_PWM,		8MA, 0, GPIO_PF2_M0PWM2) \
+	X(AXC_MOT,		F, 3, PIN_PWM,		8MA, 0, GPIO_PF3_M0PWM3) \
+	\
+	X(HOTEND1,		G, 1, PIN_OUT,		8MA, 0, 0) \
+	\
+	X(STEP2_MS3,	H, 0, PIN_OUT,		8MA, 0, 0) \
+	X(STEP2_MS2,	H, 1, PIN_OUT,		8MA, 0, 0) \
+	X(AXA_EB,		H, 2, PIN_IN,		4MA, 1, 0) \
+	X(AXA_ENCA,		H, 3, PIN_IN,		4MA, 1, 0) \
+	\
+	X(THERMIST1,	K, 0, PIN_ANALOG,	8MA, 0, 0) \
+	X(THERMIST2,	K, 1, PIN_ANALOG,	8MA, 0, 0) \
+	X(LED3,			K, 2, PIN_OUT,		8MA, 0, 0) \
+	X(LED2,			K, 3, PIN_OUT,		8MA, 0, 0) \
+	X(HOTEND2,		K, 4, PIN_OUT,		8MA, 0, 0) \
+	X(BED,			K, 5, PIN_OUT,		8MA, 0, 0) \
+	X(STEP2_MS1,	K, 6, PIN_OUT,		8MA, 0, 0) \
+	X(STEP2_EN,		K, 7, PIN_OUT,		8MA, 0, 0) \
+	\
+	X(AXC_ENCA,		L, 0, PIN_IN,		8MA, 1, 0) \
+	X(AXC_ENCB,		L, 1, PIN_IN,		8MA, 1, 0) \
+	X(AXC_EB,		L, 2, PIN_IN,		8MA, 1, 0) \
+	X(AXC_ET,		L, 3, PIN_IN,		8MA, 1, 0) \
+	X(PROX,			L, 4, PIN_IN,		8MA, 1, 0) \
+	\
+	X(STEP2_DIR,	M, 1, PIN_OUT,		8MA, 0, 0) \
+	X(STEP2_STEP,	M, 2, PIN_TIMER,	8MA, 0, GPIO_PM2_T3CCP0) \
+	X(AXA_ET,		M, 3, PIN_IN,		8MA, 1, 0) \
+	X(GEN4,			M, 4, PIN_IN,		8MA, 1, 0) \
+	X(GEN3,			M, 5, PIN_IN,		8MA, 1, 0) \
+	\
+	X(AXB_EB,		N, 2, PIN_IN,		8MA, 1, 0) \
+	X(AXB_ENCA,		N, 3, PIN_IN,		8MA, 1, 0) \
+	X(STEP1_MS1,	N, 4, PIN_OUT,		8MA, 0, 0) \
+	X(STEP1_MS2,	N, 5, PIN_OUT,		8MA, 0, 0) \
+	\
+	X(AXB_ENCB,		P, 2, PIN_IN,		8MA, 1, 0) \
+	X(THERMO1_SEL,	P, 3, PIN_OUT,		8MA, 0, 0) \
+	X(STEP1_MS3,	P, 4, PIN_OUT,		8MA, 0, 0) \
+	\
+	X(THERMO_CLK,	Q, 0, PIN_SSI,		8MA, 0, GPIO_PQ0_SSI3CLK) \
+	X(THERMO2_SEL,	Q, 1, PIN_OUT,		8MA, 0, 0) \
+	X(THERMO_DAT,	Q, 3, PIN_SSI,		8MA, 0, GPIO_PQ3_SSI3XDAT1)
+
+
+typedef struct PinDesc
+{
+	uint32_t base;		// port base address
+	uint8_t pin;		// GPIO_PIN_x
+	uint8_t mode;
+	uint8_t irq;
+	uint32_t drive;		// GPIO_STRENGTH_x
+	uint32_t af;
+} PinDesc;
+
+
+// PIN_ADDR_<name> is the pin's data register alias, PIN_MASK_<name> its bit
+#define PIN_ENUM(name, port, pin, mode, drive, irq, af) \
+	PIN_ADDR_##name = GPIO_PORT##port##_BASE + (GPIO_PIN_##pin << 2), \
+	PIN_MASK_##name = GPIO_PIN_##pin,
+
+enum { PINS_TABLE(PIN_ENUM) };
+
+
+#define PIN_READ(name)			(HWREG(PIN_ADDR_##name) != 0)
+#define PIN_WRITE(name, val)	(HWREG(PIN_ADDR_##name) = (val) ? 0xff : 0)
+
+
+/**
+ * Same as PIN_READ() and PIN_WRITE(), for pins that are only known at
+ * runtime. Costs an add and a shift over the fixed ones
+ */
+static inline bool pin_read(uint32_t base, uint8_t pin)
+{
+	return HWREG(base + ((uint32_t)pin << 2)) != 0;
+}
+
+static inline void pin_write(uint32_t base, uint8_t pin, bool val)
+{
+	HWREG(base + ((uint32_t)pin << 2)) = val ? 0xff : 0;
+}
+
+
+void pins_initPort(uint32_t base); // sets up every pin in the table on one port
+
+
+#endif /* CODE_PINS_H_ */
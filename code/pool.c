@@ -0,0 +1,142 @@
+/*
+ * pool.c
+ */
+
+#include "code/pool.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef HOST_SIM
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/hal/Hwi.h>
+#define POOL_LOCK()		UInt key = Hwi_disable()
+#define POOL_UNLOCK()	Hwi_restore(key)
+#else
+#include <stdio.h>
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#define System_printf printf
+#define System_flush()
+#endif
+
+
+POOL_DEFINE(poolFile, PoolFileBuf, POOL_FILE_BLKS);
+POOL_DEFINE(poolWp, WpqBatch, POOL_WP_BLKS);
+
+static Pool *poolList[POOL_MAX_POOLS];
+static uint8_t poolCount;
+
+
+
+
+/**
+ * Threads every block onto the free list, in address order. Not safe to run
+ * on a pool that is in use
+ */
+void pool_init(Pool *p)
+{
+	uint32_t i;
+	uint8_t j;
+
+	p->free = NULL;
+	for(i = p->numBlks; i > 0; i--)
+	{
+		void **blk = (void **)(p->mem + (i - 1) * p->blkSize);
+		*blk = p->free;
+		p->free = blk;
+	}
+
+	p->used = 0;
+	p->peak = 0;
+	p->fails = 0;
+
+	for(j = 0; j < poolCount; j++)
+	{
+		if(poolList[j] == p) { return; }
+	}
+
+	if(poolCount < POOL_MAX_POOLS) { poolList[poolCount++] = p; }
+}
+
+
+
+
+void pool_initAll()
+{
+	pool_init(&poolFile);
+	pool_init(&poolWp);
+}
+
+
+
+
+void *pool_alloc(Pool *p)
+{
+	POOL_LOCK();
+
+	void **blk = p->free;
+	if(blk)
+	{
+		p->free = *blk;
+		if(++p->used > p->peak) { p->peak = p->used; }
+	}
+	else
+		p->fails++;
+
+	POOL_UNLOCK();
+	return blk;
+}
+
+
+
+
+/**
+ * @param blk block from pool_alloc() on the same pool. NULL is ignored
+ */
+void pool_free(Pool *p, void *blk)
+{
+	if(!blk) { return; }
+
+	POOL_LOCK();
+
+	*(void **)blk = p->free;
+	p->free = blk;
+	p->used--;
+
+	POOL_UNLOCK();
+}
+
+
+
+
+Pool *pool_find(const char *name)
+{
+	uint8_t i;
+
+	for(i = 0; i < poolCount; i++)
+	{
+		if(!strcmp(name, poolList[i]->name)) { return poolList[i]; }
+	}
+
+	return NULL;
+}
+
+
+
+
+void pool_report()
+{
+	uint8_t i;
+
+	for(i = 0; i < poolCount; i++)
+	{
+		Pool *p = poolList[i];
+		System_printf("pool: %s %d/%d used (peak %d), %d bytes each, %d failed\n", p->name,
+				(int)p->used, (int)p->numBlks, (int)p->peak, (int)p->blkSize, (int)p->fails);
+	}
+
+	System_flush();
+}
@@ -0,0 +1,73 @@
+/*
+ * pool.h
+ *
+ * Fixed block memory pools, for objects that come and go at runtime. Each
+ * object class gets its own pool, with its storage and block count set at
+ * build time, so nothing fragments and an allocation is a couple of pointer
+ * moves with interrupts briefly off, from any context. An empty pool fails
+ * the allocation (and counts it) rather than falling back to the BIOS heap.
+ *
+ * The BIOS heap is only used by BIOS and the NDK. Nothing on the control path
+ * (the Hwis, the rate groups, or anything they call) allocates at all, it
+ * only ever uses static storage. noalloc.h holds it to that at link time
+ */
+
+#ifndef CODE_POOL_H_
+#define CODE_POOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "code/wpq.h"
+
+#define POOL_MAX_POOLS		8
+
+// build time sizes of the application pools
+#define POOL_FILE_SIZE		4096	// file read-ahead chunks, 8 SD sectors
+#define POOL_FILE_BLKS		4		// see below
+#define POOL_WP_BLKS		24		// waypoint batches, 1KB each
+
+// POOL_FILE_BLKS is the deepest job.h read-ahead. Its consumer, the waypoint
+// player, takes in 20 bytes per waypoint, and waypoints are about as dense as
+// the kin.h slices, so at a 1kHz slice rate that is 20KB/s. JOB_LEAD_MS
+// (250ms) of it is 5KB, which is 2 chunks, plus the 1 being copied out, plus
+// 1 to cover the rate estimate lagging a speed up
+
+
+typedef struct Pool
+{
+	const char *name;
+	uint8_t *mem;
+	uint32_t blkSize;		// bytes, rounded up to whole words
+	uint32_t numBlks;
+	void *free;				// free list, linked through the first word of each block
+	uint32_t used;			// blocks allocated right now
+	uint32_t peak;			// most blocks ever allocated at once
+	uint32_t fails;			// allocations refused because the pool was empty
+} Pool;
+
+
+/**
+ * Defines a pool of n blocks that each fit a type, along with its storage.
+ * It still needs a pool_init() before use
+ */
+#define POOL_DEFINE(pool, type, n) \
+	static uint32_t pool##_mem[((sizeof(type) + 3) / 4) * (n)]; \
+	Pool pool = { #pool, (uint8_t *)pool##_mem, ((sizeof(type) + 3) / 4) * 4, (n) }
+
+
+typedef struct PoolFileBuf { uint8_t b[POOL_FILE_SIZE]; } PoolFileBuf;
+
+extern Pool poolFile;	// PoolFileBuf
+extern Pool poolWp;		// WpqBatch
+
+
+void pool_init(Pool *p); // builds the free list, and adds the pool to the list pool_report() goes through
+void pool_initAll(); // sets up the application pools
+void *pool_alloc(Pool *p); // NULL if the pool is empty
+void pool_free(Pool *p, void *blk);
+
+Pool *pool_find(const char *name); // NULL if there isn't a pool by that name
+void pool_report(); // prints the occupancy of every pool
+
+
+#endif /* CODE_POOL_H_ */
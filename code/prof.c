@@ -0,0 +1,158 @@
+/*
+ * prof.c
+ */
+
+#include "code/prof.h"
+#include "code/timebase.h"
+#include "code/util.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <driverlib/interrupt.h>
+#include "code/noalloc.h"
+
+ProfStat profStats[PROF_NUM];
+
+static const char * const profNames[PROF_NUM] =
+{
+	"servo",
+	"port",
+	"enc",
+	"step"
+};
+
+
+
+
+RAMFUNC void prof_add(uint8_t id, uint32_t cycles)
+{
+	ProfStat *s = &profStats[id];
+
+	if(!s->n || cycles < s->min) { s->min = cycles; }
+	if(cycles > s->max) { s->max = cycles; }
+
+	s->n++;
+	s->sum += cycles;
+	s->sumSq += (uint64_t)cycles * cycles;
+}
+
+
+
+
+/**
+ * The port and encoder probes are written from zero latency interrupts, which
+ * Hwi_disable() doesn't hold off, so every interrupt is masked for the copy
+ * instead. It's a few dozen bytes, so that is about as long as enc_latch()
+ * ever masks for
+ */
+void prof_reset()
+{
+	bool wasMasked = IntMasterDisable();
+	memset(profStats, 0, sizeof(profStats));
+	if(!wasMasked) { IntMasterEnable(); }
+}
+
+
+
+
+/**
+ * Masks every interrupt for the copy, as prof_reset() does, so the 64 bit
+ * sums can't tear
+ */
+bool prof_get(uint8_t id, ProfStat *out)
+{
+	if(id >= PROF_NUM) { return false; }
+
+	bool wasMasked = IntMasterDisable();
+	*out = profStats[id];
+	if(!wasMasked) { IntMasterEnable(); }
+
+	return out->n != 0;
+}
+
+
+
+int8_t prof_find(const char *name)
+{
+	uint8_t i;
+
+	for(i = 0; i < PROF_NUM; i++)
+	{
+		if(!strcmp(name, profNames[i])) { return i; }
+	}
+
+	return -1;
+}
+
+
+
+
+uint32_t prof_meanNs(const ProfStat *s)
+{
+	return s->n ? timebase_cyclesToNs((uint32_t)(s->sum / s->n)) : 0;
+}
+
+
+
+
+/**
+ * Variance from the sums, E[x^2] - E[x]^2, then an integer square root
+ */
+uint32_t prof_stdDevNs(const ProfStat *s)
+{
+	if(s->n < 2) { return 0; }
+
+	uint64_t mean = s->sum / s->n;
+	uint64_t meanSq = s->sumSq / s->n;
+	uint64_t var = meanSq > mean * mean ? meanSq - mean * mean : 0;
+
+	// bit by bit square root
+	uint64_t root = 0, bit = (uint64_t)1 << 62;
+	while(bit > var) { bit >>= 2; }
+
+	while(bit)
+	{
+		if(var >= root + bit)
+		{
+			var -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+
+		bit >>= 2;
+	}
+
+	return timebase_cyclesToNs((uint32_t)root);
+}
+
+
+
+
+void prof_report()
+{
+	ProfStat s;
+	uint8_t i;
+
+#ifdef SERVO_IN_FLASH
+	System_printf("prof: servo code in flash\n");
+#else
+	System_printf("prof: servo code in SRAM\n");
+#endif
+
+	for(i = 0; i < PROF_NUM; i++)
+	{
+		if(!prof_get(i, &s))
+		{
+			System_printf("prof: %s no samples\n", profNames[i]);
+			continue;
+		}
+
+		System_printf("prof: %s n %d, min %d ns, max %d ns, mean %d ns, sd %d ns\n", profNames[i], s.n,
+				timebase_cyclesToNs(s.min), timebase_cyclesToNs(s.max), prof_meanNs(&s), prof_stdDevNs(&s));
+	}
+
+	System_flush();
+}
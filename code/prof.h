@@ -0,0 +1,53 @@
+/*
+ * prof.h
+ *
+ * Execution time profile of the servo path. Each probe keeps the count, min,
+ * max, mean and variance of the cycles its section took, so the jitter can
+ * be compared between builds (eg. with and without SERVO_IN_FLASH). Times
+ * include anything that preempted the section, and a probe must only be
+ * used at one interrupt priority, so its updates can't nest
+ */
+
+#ifndef CODE_PROF_H_
+#define CODE_PROF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "code/util.h"
+
+#define PROF_SERVO		0	// servo group run
+#define PROF_PORT		1	// encoder and endstop port ISRs, all of them together
+#define PROF_ENC		2	// encoder decode
+#define PROF_STEP		3	// step timer ISRs
+#define PROF_NUM		4
+
+
+typedef struct ProfStat
+{
+	uint32_t n;
+	uint32_t min;		// cycles
+	uint32_t max;
+	uint64_t sum;
+	uint64_t sumSq;		// for the variance. Good for about 10^7 samples of 1000 cycles
+} ProfStat;
+
+
+extern ProfStat profStats[PROF_NUM];
+
+
+/**
+ * Times a section: t = PROF_BEGIN(); ... PROF_END(PROF_XXX, t);
+ */
+#define PROF_BEGIN()		cycleCount()
+#define PROF_END(id, t)		prof_add(id, cycleCount() - (t))
+
+void prof_add(uint8_t id, uint32_t cycles);
+void prof_reset();
+bool prof_get(uint8_t id, ProfStat *out); // copies a probe's stats out. false if it has no samples
+int8_t prof_find(const char *name); // -1 if there's no probe by that name
+uint32_t prof_meanNs(const ProfStat *s);
+uint32_t prof_stdDevNs(const ProfStat *s); // square root of the variance
+void prof_report(); // prints every probe, and where the servo code is running from
+
+
+#endif /* CODE_PROF_H_ */
@@ -0,0 +1,235 @@
+/*
+ * sched.c
+ */
+
+#include "code/sched.h"
+#include "code/boot.h"
+#include "code/timebase.h"
+#include "code/util.h"
+#include "code/prof.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/knl/Swi.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <inc/hw_memmap.h>
+#include <driverlib/sysctl.h>
+#include <driverlib/timer.h>
+#include "code/noalloc.h"
+
+#define SCHED_WINDOW	SCHED_TICK_HZ	// ticks in a load window
+
+
+typedef struct SchedGroup
+{
+	const char *name;
+	uint32_t div;			// ticks between runs
+	uint32_t phase;			// tick in each period the group runs on, so groups don't all pile onto one tick
+	uint8_t swiPri;
+	SchedJob jobs[SCHED_MAX_JOBS];
+	uint8_t numJobs;
+	volatile bool busy;		// posted, and not finished yet
+	uint32_t total;			// cycles used since sched_start(). Only written by the group itself
+	uint32_t windowStart;	// total at the start of the load window
+	SchedStats stats;
+	Swi_Struct swi;
+} SchedGroup;
+
+
+static SchedGroup schedGroups[SCHED_NUM_GROUPS] =
+{
+	{ "servo",		SCHED_TICK_HZ / 10000,	0,	0 },
+	{ "planner",	SCHED_TICK_HZ / 1000,	1,	3 },
+	{ "thermal",	SCHED_TICK_HZ / 100,	2,	2 },
+	{ "house",		SCHED_TICK_HZ / 10,		3,	1 }
+};
+
+static uint32_t schedTicks;
+static uint32_t schedPeriod;				// cycles per tick
+static volatile uint32_t schedNested;		// cycles used by all groups, for taking preemption out of slower ones
+
+
+
+
+static void sched_swi(UArg arg0, UArg arg1);
+
+void sched_init()
+{
+	Swi_Params params;
+	uint8_t i;
+
+	for(i = 1; i < SCHED_NUM_GROUPS; i++)
+	{
+		Swi_Params_init(&params);
+		params.arg0 = i;
+		params.priority = schedGroups[i].swiPri;
+		params.instance->name = schedGroups[i].name;
+		Swi_construct(&schedGroups[i].swi, (Swi_FuncPtr)sched_swi, &params, NULL);
+	}
+}
+
+
+
+
+bool sched_add(uint8_t group, SchedJob job)
+{
+	if(group >= SCHED_NUM_GROUPS) { return false; }
+
+	SchedGroup *g = &schedGroups[group];
+	if(g->numJobs >= SCHED_MAX_JOBS) { return false; }
+
+	g->jobs[g->numJobs++] = job;
+	return true;
+}
+
+
+
+
+/**
+ * Sets Timer2A up as a periodic timer at the servo rate. The first tick
+ * fires once BIOS enables interrupts
+ */
+void sched_start()
+{
+	schedPeriod = timebase_getClk() / SCHED_TICK_HZ;
+	schedTicks = 0;
+
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER2);
+	while(!SysCtlPeripheralReady(SYSCTL_PERIPH_TIMER2));
+
+	TimerConfigure(TIMER2_BASE, TIMER_CFG_PERIODIC);
+	TimerLoadSet(TIMER2_BASE, TIMER_A, schedPeriod - 1);
+	TimerIntEnable(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+	TimerEnable(TIMER2_BASE, TIMER_A);
+}
+
+
+
+
+const SchedStats *sched_getStats(uint8_t group)
+{
+	return &schedGroups[group].stats;
+}
+
+
+
+const char *sched_getName(uint8_t group)
+{
+	return schedGroups[group].name;
+}
+
+
+
+
+void sched_report()
+{
+	uint8_t i;
+
+	for(i = 0; i < SCHED_NUM_GROUPS; i++)
+	{
+		const SchedStats *s = &schedGroups[i].stats;
+		System_printf("sched: %s %d runs, %d misses, max %d us, load %d.%d%%\n", schedGroups[i].name, s->runs,
+				s->misses, timebase_cyclesToUs(s->maxCycles), s->load / 10, s->load % 10);
+	}
+
+	System_flush();
+}
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Running groups ///////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Runs every job in a group, and accounts for the time. Whatever faster
+ * groups ran in the meantime have already added themselves to schedNested,
+ * so the difference over this run is taken back out
+ */
+RAMFUNC static void sched_run(SchedGroup *g)
+{
+	uint32_t start = cycleCount(), nested = schedNested;
+	uint8_t i;
+
+	for(i = 0; i < g->numJobs; i++) { g->jobs[i](); }
+
+	// the tick can land between the read and write of schedNested, so it is
+	// updated with interrupts off
+	UInt key = Hwi_disable();
+	uint32_t used = (cycleCount() - start) - (schedNested - nested);
+	schedNested += used;
+	Hwi_restore(key);
+
+	g->total += used;
+	g->stats.lastCycles = used;
+	if(used > g->stats.maxCycles) { g->stats.maxCycles = used; }
+	g->stats.runs++;
+}
+
+
+
+
+static void sched_swi(UArg arg0, UArg arg1)
+{
+	SchedGroup *g = &schedGroups[arg0];
+
+	sched_run(g);
+	g->busy = false;
+}
+
+
+
+
+/**
+ * Timer2A, at the servo rate. Runs the servo group, then posts whichever of
+ * the slower groups are due
+ */
+RAMFUNC void sched_tick_ISR()
+{
+	SchedGroup *g;
+	uint8_t i;
+
+	TimerIntClear(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+
+	// a servo run longer than the tick means the next one is late
+	uint32_t t = PROF_BEGIN();
+	sched_run(&schedGroups[SCHED_SERVO]);
+	PROF_END(PROF_SERVO, t);
+	if(schedGroups[SCHED_SERVO].stats.lastCycles > schedPeriod) { schedGroups[SCHED_SERVO].stats.misses++; }
+
+	if(!schedTicks) { boot_mark(BOOT_MARK_SERVO); }
+
+	for(i = 1; i < SCHED_NUM_GROUPS; i++)
+	{
+		g = &schedGroups[i];
+		if(schedTicks % g->div != g->phase) { continue; }
+
+		if(g->busy)
+		{
+			g->stats.misses++;
+			continue;
+		}
+
+		g->busy = true;
+		Swi_post(Swi_handle(&g->swi));
+	}
+
+	// roll the load window. Each group's total only moves forward, so it
+	// doesn't matter if one is partway through a run
+	if(++schedTicks % SCHED_WINDOW == 0)
+	{
+		for(i = 0; i < SCHED_NUM_GROUPS; i++)
+		{
+			g = &schedGroups[i];
+			uint32_t total = g->total;
+
+			g->stats.load = (uint32_t)(((uint64_t)(total - g->windowStart) * 1000) / ((uint64_t)schedPeriod * SCHED_WINDOW));
+			g->windowStart = total;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+/*
+ * sched.h
+ *
+ * Fixed rate groups for the periodic work, all driven off of one timer tick
+ * (Timer2A). The servo group runs right in the tick Hwi. The slower groups
+ * each get a Swi, which the tick posts when the group is due, so a faster
+ * group always preempts a slower one. Jobs in a group run in the order they
+ * were added, and must not block.
+ *
+ *   group			rate	runs in
+ *   servo			10kHz	tick Hwi (priority 0x20)
+ *   planner		1kHz	Swi, priority 3
+ *   thermal		100Hz	Swi, priority 2
+ *   housekeeping	10Hz	Swi, priority 1
+ *
+ * A group that is still running when it comes due again counts a deadline
+ * miss, and skips that run. Each run is timed with the cycle counter, less
+ * any time spent in faster groups that preempted it, so the CPU time of each
+ * group is its own (other Hwis are still counted against whatever they
+ * interrupted). Loads are over the last whole second
+ */
+
+#ifndef CODE_SCHED_H_
+#define CODE_SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHED_SERVO			0
+#define SCHED_PLANNER		1
+#define SCHED_THERMAL		2
+#define SCHED_HOUSE			3
+#define SCHED_NUM_GROUPS	4
+
+#define SCHED_TICK_HZ		10000	// servo rate. The other group rates have to divide it
+#define SCHED_MAX_JOBS		8		// jobs per group
+
+typedef void (*SchedJob)();
+
+
+typedef struct SchedStats
+{
+	uint32_t runs;
+	uint32_t misses;		// times the group was due while it was still running
+	uint32_t maxCycles;		// longest single run
+	uint32_t lastCycles;	// most recent run
+	uint32_t load;			// fraction of the CPU over the last second, in 1/10ths of a percent
+} SchedStats;
+
+
+void sched_init(); // sets up the group Swis. Run before adding any jobs
+bool sched_add(uint8_t group, SchedJob job); // adds a job to the end of a group. false if the group is full
+void sched_start(); // starts the tick. BIOS doesn't need to be running yet
+
+const SchedStats *sched_getStats(uint8_t group);
+const char *sched_getName(uint8_t group);
+void sched_report(); // prints the stats for every group
+
+void sched_tick_ISR();
+
+
+#endif /* CODE_SCHED_H_ */
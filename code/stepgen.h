@@ -0,0 +1,147 @@
+/*
+ * stepgen.h
+ *
+ * Step interval generator for one constant acceleration StepSeg. Intervals
+ * follow the recurrence p' = p(1 + q + q^2), q = -a*p^2 / f^2, which needs no
+ * division or square root. That is a series in q, so it only holds while q is
+ * small. Where it isn't (the first few steps from rest, or the last few into
+ * a stop) the step time is solved for exactly instead, and the recurrence
+ * picks up from there. The last interval takes up whatever time is left, so
+ * the segment always ends exactly on time.
+ *
+ * There is no hardware in here, so the host simulation runs the very same
+ * intervals the stepper puts on the pins
+ */
+
+#ifndef CODE_STEPGEN_H_
+#define CODE_STEPGEN_H_
+
+#include <stdint.h>
+#include <math.h>
+#include "code/stepper.h"
+
+#define STEPGEN_Q_MAX	0.01f	// largest |q| the recurrence is trusted with
+
+
+typedef struct StepGen
+{
+	uint32_t left;	// intervals left to generate
+	uint32_t dur;	// length of the segment (clock cycles)
+	uint32_t used;	// clock cycles already handed out
+	float p;		// next interval (clock cycles)
+	float m;		// interval recurrence multiplier
+	uint32_t n;		// steps in the segment
+	float v0;		// step rate at the start (steps / sec)
+	float a;		// steps / sec^2
+	float f;		// clock cycles per sec
+} StepGen;
+
+
+/**
+ * Starts generating a segment. A dwell is split into even chunks of at most
+ * maxIvl
+ *
+ * @param f clock cycles per sec
+ */
+static inline void stepgen_load(StepGen *g, const StepSeg *s, float f, uint32_t maxIvl)
+{
+	float t = s->dur / f;
+
+	g->dur = s->dur;
+	g->used = 0;
+	g->f = f;
+
+	if(s->steps == 0)
+	{
+		g->left = (s->dur + maxIvl - 1) / maxIvl;
+		g->p = (float)s->dur / g->left;
+		g->m = 0;
+		g->n = 0;
+		return;
+	}
+
+	uint32_t n = s->steps < 0 ? -s->steps : s->steps;
+	float a = (s->v1 - s->v0) / t;
+	float t1;
+
+	if(fabsf(a) < 1e-3f) // constant velocity
+	{
+		t1 = s->v0 > 0 ? 1 / s->v0 : t / n;
+	} else
+	{
+		float disc = s->v0 * s->v0 + 2 * a;
+		t1 = disc > 0 ? (sqrtf(disc) - s->v0) / a : t / n;
+	}
+
+	g->left = n;
+	g->n = n;
+	g->v0 = s->v0;
+	g->a = a;
+	g->p = t1 * f;
+	g->m = -a / (f * f);
+}
+
+
+
+
+/**
+ * Exact interval to step k of the segment (1 based), from the time already
+ * handed out. If the profile never gets that far (rounding), what is left is
+ * split evenly
+ */
+static inline float stepgen_exact(const StepGen *g, uint32_t k)
+{
+	float t, disc;
+
+	if(fabsf(g->a) < 1e-3f)
+		t = g->v0 > 0 ? k / g->v0 : 0;
+	else
+	{
+		disc = g->v0 * g->v0 + 2 * g->a * k;
+		t = disc >= 0 ? (sqrtf(disc) - g->v0) / g->a : 0;
+	}
+
+	if(t * g->f <= g->used) { return (float)(g->dur - g->used) / g->left; }
+	return t * g->f - g->used;
+}
+
+
+
+
+/**
+ * @return the next interval (clock cycles), kept on [minIvl, maxIvl]. Only
+ * call while left is nonzero
+ */
+static inline uint32_t stepgen_next(StepGen *g, uint32_t minIvl, uint32_t maxIvl)
+{
+	float ivl;
+
+	if(g->left == 1)
+	{
+		ivl = g->used < g->dur ? (float)(g->dur - g->used) : 0;
+	} else
+	{
+		float q = g->m * g->p * g->p;
+
+		if(g->n && fabsf(q) > STEPGEN_Q_MAX)
+		{
+			ivl = stepgen_exact(g, g->n - g->left + 1);
+			g->p = ivl;
+			q = g->m * g->p * g->p;
+		} else
+			ivl = g->p;
+
+		g->p = ivl * (1 + q + q * q);
+	}
+
+	if(ivl < minIvl) { ivl = minIvl; }
+	if(ivl > maxIvl) { ivl = maxIvl; }
+
+	g->used += (uint32_t)ivl;
+	g->left--;
+
+	return (uint32_t)ivl;
+}
+
+
+#endif /* CODE_STEPGEN_H_ */
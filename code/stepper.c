@@ -0,0 +1,652 @@
+/*
+ * stepper.c
+ *
+ * Both extruder step outputs run off of Timer3 in split PWM mode, with the
+ * output inverted and the match value set to the pulse width. That way every
+ * timer period ends in exactly one step pulse, and the load value is the
+ * interval to the next step.
+ *
+ * Intervals are fed one period ahead of the pin, since the load register is
+ * only latched on timeout. Blocks of short intervals are fed by the uDMA off of
+ * the timer event, and only need the ISR at the start and end of the block.
+ * Blocks with intervals too long for the 16 bit load register (slow moves and
+ * dwells) are fed by the ISR, which is cheap at those rates
+ */
+
+#include "code/stepper.h"
+#include "code/dat.h"
+#include "code/util.h"
+#include "code/advance.h"
+#include "code/stepgen.h"
+#include "code/prof.h"
+#include "code/pins.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_types.h>
+#include <inc/hw_gpio.h>
+#include <inc/hw_timer.h>
+#include <driverlib/gpio.h>
+#include <driverlib/timer.h>
+#include <driverlib/udma.h>
+#include "board.h"
+#include "code/noalloc.h"
+
+
+/**
+ * Hardware resources used by a step channel
+ */
+typedef struct StepHw
+{
+	uint32_t timer;		// TIMER_A or TIMER_B of Timer3
+	uint32_t capEvt;	// capture (PWM) event interrupt
+	uint32_t dmaInt;	// uDMA done interrupt
+	uint32_t dmaCh;		// uDMA channel triggered by the timer
+	uint32_t ilrOff;	// offset of the load register
+	uint32_t mrOff;		// offset of the mode register
+	uint32_t pwmIE;		// PWM interrupt enable bit in the mode register
+
+	uint32_t stepPort;
+	uint8_t stepPin;
+	uint32_t dirPort;
+	uint8_t dirPin;
+	uint32_t enPort;
+	uint8_t enPin;
+	uint32_t msPort[3];	// MS1, MS2, MS3
+	uint8_t msPin[3];
+} StepHw;
+
+
+
+/**
+ * State of a step channel. Segments are produced by the planner and consumed by
+ * stepper_fill(), blocks are produced by stepper_fill() and consumed by the ISR.
+ * All indices are free running, and wrapped when used
+ */
+typedef struct StepCh
+{
+	StepSeg segs[STEPPER_SEG_QLEN];
+	volatile uint32_t segHead;
+	volatile uint32_t segTail;
+
+	StepBlock blks[STEPPER_NUM_BLOCKS];
+	volatile uint32_t blkHead;	// next block to be filled
+	volatile uint32_t blkTail;	// oldest block still on the pin
+
+	// segment currently being converted to intervals
+	bool segActive;
+	uint8_t segFlags;
+	StepGen gen;
+	uint32_t pend;		// interval generated but not placed in a block yet. 0 if none
+
+	// output state, owned by the ISR
+	uint32_t feedBlk;	// block the next load value comes from
+	uint16_t feedIdx;
+	bool dmaFeed;		// uDMA is currently feeding feedBlk
+	bool starved;		// ran out of blocks to feed
+	uint32_t pinBlk;	// block currently being output on the pin
+	uint16_t pinLeft;	// periods of pinBlk still to go on the pin
+	volatile bool running;
+
+	float advCarry;		// fractional step left over from pressure advance rounding
+
+	volatile uint32_t segsDone;
+	volatile int32_t pos;
+	volatile uint32_t underruns;
+} StepCh;
+
+
+
+
+RAMDATA static const StepHw stepHw[STEPPER_NUM_CH] =
+{
+	{ // Step1
+		.timer = TIMER_B, .capEvt = TIMER_CAPB_EVENT, .dmaInt = TIMER_TIMB_DMA,
+		.dmaCh = UDMA_CH3_TIMER3B, .ilrOff = TIMER_O_TBILR, .mrOff = TIMER_O_TBMR, .pwmIE = TIMER_TBMR_TBPWMIE,
+		.stepPort = GPIO_PORTD_BASE, .stepPin = GPIO_PIN_5,
+		.dirPort = GPIO_PORTD_BASE, .dirPin = GPIO_PIN_4,
+		.enPort = GPIO_PORTA_BASE, .enPin = GPIO_PIN_5,
+		.msPort = { GPIO_PORTN_BASE, GPIO_PORTN_BASE, GPIO_PORTP_BASE },
+		.msPin = { GPIO_PIN_4, GPIO_PIN_5, GPIO_PIN_4 }
+	},
+	{ // Step2
+		.timer = TIMER_A, .capEvt = TIMER_CAPA_EVENT, .dmaInt = TIMER_TIMA_DMA,
+		.dmaCh = UDMA_CH2_TIMER3A, .ilrOff = TIMER_O_TAILR, .mrOff = TIMER_O_TAMR, .pwmIE = TIMER_TAMR_TAPWMIE,
+		.stepPort = GPIO_PORTM_BASE, .stepPin = GPIO_PIN_2,
+		.dirPort = GPIO_PORTM_BASE, .dirPin = GPIO_PIN_1,
+		.enPort = GPIO_PORTK_BASE, .enPin = GPIO_PIN_7,
+		.msPort = { GPIO_PORTK_BASE, GPIO_PORTH_BASE, GPIO_PORTH_BASE },
+		.msPin = { GPIO_PIN_6, GPIO_PIN_1, GPIO_PIN_0 }
+	}
+};
+
+static StepCh stepCh[STEPPER_NUM_CH];
+static uint32_t stepClk; // timer clock frequency
+
+
+extern void EK_TM4C1294XL_initDMA(void);
+
+
+
+
+static ExtDat *stepper_getDat(uint8_t ch)
+{
+	return ch == STEPPER_CH1 ? &ext1Dat : &ext2Dat;
+}
+
+
+
+/**
+ * Shortest interval allowed on a channel. The step pulse needs at least as
+ * much low time as it has high time
+ */
+static uint32_t stepper_minIvl(uint8_t ch)
+{
+	uint32_t pwTicks = (uint32_t)(((uint64_t)stepper_getDat(ch)->pulseWidth * stepClk) / 1000000);
+	return 2 * pwTicks;
+}
+
+
+
+
+/**
+ * Initializes the step channels. Everything is left stopped and disabled
+ *
+ * @param clkFreq frequency of the system clock, which Timer3 runs off of
+ */
+void stepper_init(uint32_t clkFreq)
+{
+	uint8_t ch, i;
+	stepClk = clkFreq;
+
+	TimerConfigure(TIMER3_BASE, TIMER_CFG_SPLIT_PAIR | TIMER_CFG_A_PWM | TIMER_CFG_B_PWM);
+	TimerControlLevel(TIMER3_BASE, TIMER_BOTH, true); // pulse is at the end of the period
+	TimerUpdateMode(TIMER3_BASE, TIMER_BOTH, TIMER_UP_LOAD_TIMEOUT); // latch new intervals on timeout
+	TimerControlEvent(TIMER3_BASE, TIMER_BOTH, TIMER_EVENT_NEG_EDGE); // event at the end of each pulse
+	TimerDMAEventSet(TIMER3_BASE, TIMER_DMA_CAPEVENT_A | TIMER_DMA_CAPEVENT_B);
+
+	EK_TM4C1294XL_initDMA();
+
+	for(ch = 0; ch < STEPPER_NUM_CH; ch++)
+	{
+		const StepHw *hw = &stepHw[ch];
+		ExtDat *dat = stepper_getDat(ch);
+
+		TimerMatchSet(TIMER3_BASE, hw->timer, stepper_minIvl(ch) / 2);
+		TimerPrescaleMatchSet(TIMER3_BASE, hw->timer, 0);
+		HWREG(TIMER3_BASE + hw->mrOff) |= hw->pwmIE;
+
+		uDMAChannelAssign(hw->dmaCh);
+		uDMAChannelAttributeDisable(hw->dmaCh, UDMA_ATTR_ALL);
+		uDMAChannelControlSet(hw->dmaCh | UDMA_PRI_SELECT,
+				UDMA_SIZE_32 | UDMA_SRC_INC_32 | UDMA_DST_INC_NONE | UDMA_ARB_1);
+
+		// the step pin idles low as a GPIO until a non-idle block is output
+		pin_write(hw->stepPort, hw->stepPin, false);
+		HWREG(hw->stepPort + GPIO_O_AFSEL) &= ~hw->stepPin;
+
+		for(i = 0; i < 3; i++)
+		{
+			GPIODirModeSet(hw->msPort[i], hw->msPin[i], GPIO_DIR_MODE_OUT);
+		}
+
+		stepper_setEnabled(ch, false);
+		stepper_setMicrostep(ch, dat->microsteps);
+	}
+
+	TimerIntEnable(TIMER3_BASE, TIMER_TIMA_DMA | TIMER_TIMB_DMA);
+}
+
+
+
+
+/**
+ * Applies the step pulse width and microstepping from the config variables
+ * again, after they have been reloaded. Only call it while the channels are
+ * stopped
+ */
+void stepper_loadConfig()
+{
+	uint8_t ch;
+
+	for(ch = 0; ch < STEPPER_NUM_CH; ch++)
+	{
+		TimerMatchSet(TIMER3_BASE, stepHw[ch].timer, stepper_minIvl(ch) / 2);
+		stepper_setMicrostep(ch, stepper_getDat(ch)->microsteps);
+	}
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////// Segment queue ///////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Queues up a constant acceleration move for a channel
+ *
+ * @param ch STEPPER_CH1 or STEPPER_CH2
+ * @param steps signed number of microsteps to take. 0 dwells
+ * @param v0 step rate at the start of the segment (steps / sec)
+ * @param v1 step rate at the end of the segment (steps / sec)
+ * @param dur length of the segment, in clock cycles. Should match the carriage segment
+ *
+ * @return true if queued, false if the queue is full
+ */
+bool stepper_queueSeg(uint8_t ch, int32_t steps, float v0, float v1, uint32_t dur)
+{
+	StepCh *c = &stepCh[ch];
+
+	if(c->segHead - c->segTail >= STEPPER_SEG_QLEN || dur == 0) { return false; }
+
+	StepSeg *s = &c->segs[c->segHead & (STEPPER_SEG_QLEN - 1)];
+	s->steps = steps;
+	s->v0 = fabsf(v0);
+	s->v1 = fabsf(v1);
+	s->dur = dur;
+
+	c->segHead++;
+	return true;
+}
+
+
+
+
+
+/**
+ * Queues up a planned extrusion for a channel, with the channel's pressure
+ * advance applied. Rates are signed, and in microsteps
+ *
+ * @param ch STEPPER_CH1 or STEPPER_CH2
+ * @param de planned extrusion over the segment (steps)
+ * @param v0 planned extrusion velocity at the start of the segment (steps / sec)
+ * @param v1 planned extrusion velocity at the end of the segment (steps / sec)
+ * @param dur length of the segment, in clock cycles. Should match the carriage segment
+ *
+ * @return true if queued, false if there wasn't room for it
+ */
+bool stepper_queueExtrude(uint8_t ch, float de, float v0, float v1, uint32_t dur)
+{
+	StepCh *c = &stepCh[ch];
+	StepSeg segs[ADVANCE_MAX_SEGS];
+	uint8_t i, n;
+
+	if(STEPPER_SEG_QLEN - (c->segHead - c->segTail) < ADVANCE_MAX_SEGS || dur == 0) { return false; }
+
+	n = advance_apply(stepper_getDat(ch)->advK, &c->advCarry, de, v0, v1, dur, stepClk, segs);
+
+	for(i = 0; i < n; i++)
+	{
+		stepper_queueSeg(ch, segs[i].steps, segs[i].v0, segs[i].v1, segs[i].dur);
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Loads the oldest queued segment into the interval generator (see stepgen.h)
+ */
+static void stepper_loadSeg(StepCh *c)
+{
+	StepSeg *s = &c->segs[c->segTail & (STEPPER_SEG_QLEN - 1)];
+
+	stepgen_load(&c->gen, s, (float)stepClk, STEPPER_MAX_IVL);
+	c->segActive = true;
+
+	if(s->steps == 0) { c->segFlags = STEPPER_BLK_IDLE; } // dwell
+	else { c->segFlags = s->steps > 0 ? STEPPER_BLK_DIR : 0; }
+}
+
+
+
+
+/**
+ * Converts queued segments into interval blocks until the block ring is full or
+ * the segment queue is empty. A block never spans two segments, and never mixes
+ * intervals the uDMA can feed with ones it can't
+ *
+ * @param ch STEPPER_CH1 or STEPPER_CH2
+ */
+void stepper_fill(uint8_t ch)
+{
+	StepCh *c = &stepCh[ch];
+	uint32_t minIvl = stepper_minIvl(ch);
+
+	while(c->blkHead - c->blkTail < STEPPER_NUM_BLOCKS)
+	{
+		if(!c->segActive)
+		{
+			if(c->segHead == c->segTail) { return; } // nothing left to do
+			stepper_loadSeg(c);
+		}
+
+		StepBlock *b = &c->blks[c->blkHead & (STEPPER_NUM_BLOCKS - 1)];
+		b->n = 0;
+		b->flags = c->segFlags;
+
+		while(b->n < STEPPER_BLOCK_LEN && (c->pend || c->gen.left))
+		{
+			if(!c->pend) { c->pend = stepgen_next(&c->gen, minIvl, STEPPER_MAX_IVL); }
+
+			bool slow = c->pend > STEPPER_DMA_IVL;
+			if(b->n == 0 && slow) { b->flags |= STEPPER_BLK_SLOW; }
+			else if(slow != ((b->flags & STEPPER_BLK_SLOW) != 0)) { break; } // goes in the next block
+
+			b->ivl[b->n++] = c->pend;
+			c->pend = 0;
+		}
+
+		if(!c->pend && !c->gen.left) // segment is finished
+		{
+			b->flags |= STEPPER_BLK_SEGEND;
+			c->segActive = false;
+			c->segTail++;
+		}
+
+		c->blkHead++; // publish to the ISR
+	}
+}
+
+
+
+
+/**
+ * Tops up both channels. This is the planner rate group job
+ */
+void stepper_refill()
+{
+	stepper_fill(STEPPER_CH1);
+	stepper_fill(STEPPER_CH2);
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Output ////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Writes an interval to a channel's load registers. It takes effect at the next timeout
+ */
+static inline void stepper_writeIvl(const StepHw *hw, uint32_t ivl)
+{
+	TimerPrescaleSet(TIMER3_BASE, hw->timer, ivl >> 16);
+	TimerLoadSet(TIMER3_BASE, hw->timer, ivl & 0xffff);
+}
+
+
+
+
+/**
+ * Puts the state of a block on the pins. Run on the timeout that starts the block
+ */
+RAMFUNC static void stepper_applyBlk(const StepHw *hw, const StepBlock *b, bool inv)
+{
+	bool dir = ((b->flags & STEPPER_BLK_DIR) != 0) ^ inv;
+	pin_write(hw->dirPort, hw->dirPin, dir);
+
+	// idle blocks hand the step pin back to the (low) GPIO so no pulses go out
+	if(b->flags & STEPPER_BLK_IDLE) { HWREG(hw->stepPort + GPIO_O_AFSEL) &= ~hw->stepPin; }
+	else { HWREG(hw->stepPort + GPIO_O_AFSEL) |= hw->stepPin; }
+}
+
+
+
+
+/**
+ * Feeds the next load value to the timer. If it is the first interval of a
+ * block the uDMA can handle, the rest of that block is handed off to the uDMA
+ */
+RAMFUNC static void stepper_feed(uint8_t ch)
+{
+	StepCh *c = &stepCh[ch];
+	const StepHw *hw = &stepHw[ch];
+
+	if(c->feedBlk == c->blkHead) // planner hasn't kept up
+	{
+		c->starved = true;
+		return;
+	}
+
+	StepBlock *b = &c->blks[c->feedBlk & (STEPPER_NUM_BLOCKS - 1)];
+	stepper_writeIvl(hw, b->ivl[c->feedIdx++]);
+
+	if(c->feedIdx < b->n && !(b->flags & STEPPER_BLK_SLOW))
+	{
+		uDMAChannelTransferSet(hw->dmaCh | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+				&b->ivl[c->feedIdx], (void *)(TIMER3_BASE + hw->ilrOff), b->n - c->feedIdx);
+		uDMAChannelEnable(hw->dmaCh);
+		c->dmaFeed = true;
+	} else if(c->feedIdx >= b->n)
+	{
+		c->feedBlk++;
+		c->feedIdx = 0;
+	}
+}
+
+
+
+
+/**
+ * Stops a channel and parks the step pin low
+ */
+RAMFUNC static void stepper_halt(uint8_t ch)
+{
+	StepCh *c = &stepCh[ch];
+	const StepHw *hw = &stepHw[ch];
+
+	TimerDisable(TIMER3_BASE, hw->timer);
+	TimerIntDisable(TIMER3_BASE, hw->capEvt);
+	uDMAChannelDisable(hw->dmaCh);
+	HWREG(hw->stepPort + GPIO_O_AFSEL) &= ~hw->stepPin;
+
+	c->running = false;
+	c->dmaFeed = false;
+}
+
+
+
+
+/**
+ * Handles a timer event (a timeout, right after a step pulse). Tracks which block
+ * is on the pin, and feeds the timer if the uDMA isn't
+ */
+RAMFUNC static void stepper_event(uint8_t ch)
+{
+	StepCh *c = &stepCh[ch];
+	const StepHw *hw = &stepHw[ch];
+
+	if(--c->pinLeft == 0) // block just finished on the pin
+	{
+		StepBlock *b = &c->blks[c->pinBlk & (STEPPER_NUM_BLOCKS - 1)];
+		if(!(b->flags & STEPPER_BLK_IDLE)) { c->pos += (b->flags & STEPPER_BLK_DIR) ? b->n : -b->n; }
+		if(b->flags & STEPPER_BLK_SEGEND) { c->segsDone++; }
+
+		c->pinBlk++;
+		c->blkTail = c->pinBlk; // done with it, planner can reuse it
+
+		if(c->starved && c->pinBlk == c->feedBlk) // the timer is repeating the last interval. stop before it pulses
+		{
+			c->underruns++;
+			stepper_halt(ch);
+			return;
+		}
+
+		b = &c->blks[c->pinBlk & (STEPPER_NUM_BLOCKS - 1)];
+		stepper_applyBlk(hw, b, stepper_getDat(ch)->inv);
+		c->pinLeft = b->n;
+	}
+
+	if(!c->dmaFeed && !c->starved) { stepper_feed(ch); }
+
+	// once the uDMA is feeding the block on the pin, there is nothing to do until it finishes
+	if(c->dmaFeed && c->pinBlk == c->feedBlk) { TimerIntDisable(TIMER3_BASE, hw->capEvt); }
+}
+
+
+
+
+/**
+ * Handles a uDMA done. The last transfer was made on this timeout, so the block
+ * has two periods left on the pin; the ISR picks it back up from here
+ */
+RAMFUNC static void stepper_dmaDone(uint8_t ch)
+{
+	StepCh *c = &stepCh[ch];
+	const StepHw *hw = &stepHw[ch];
+
+	c->dmaFeed = false;
+	c->feedBlk++;
+	c->feedIdx = 0;
+	c->pinLeft = 2;
+
+	TimerIntClear(TIMER3_BASE, hw->capEvt); // this timeout was already accounted for
+	TimerIntEnable(TIMER3_BASE, hw->capEvt);
+}
+
+
+
+
+RAMFUNC static void stepper_ISR(uint8_t ch)
+{
+	const StepHw *hw = &stepHw[ch];
+	uint32_t t = PROF_BEGIN();
+
+	uint32_t intStat = TimerIntStatus(TIMER3_BASE, true) & (hw->capEvt | hw->dmaInt);
+	TimerIntClear(TIMER3_BASE, intStat);
+
+	if(stepCh[ch].running)
+	{
+		// a short block can finish on the uDMA on the same timeout it starts on the pin
+		if(intStat & hw->capEvt) { stepper_event(ch); }
+		if((intStat & hw->dmaInt) && stepCh[ch].running) { stepper_dmaDone(ch); }
+	}
+
+	PROF_END(PROF_STEP, t);
+}
+
+
+RAMFUNC void stepper_ch1_ISR() { stepper_ISR(STEPPER_CH1); }
+RAMFUNC void stepper_ch2_ISR() { stepper_ISR(STEPPER_CH2); }
+
+
+
+
+/**
+ * Starts the output of all channels that have blocks ready. Both halves of the
+ * timer are enabled with a single write, so the channels start on the same clock
+ * edge. Call this on the tick the matching carriage segments start on
+ */
+void stepper_start()
+{
+	uint32_t enMask = 0;
+	uint8_t ch;
+
+	for(ch = 0; ch < STEPPER_NUM_CH; ch++)
+	{
+		StepCh *c = &stepCh[ch];
+		const StepHw *hw = &stepHw[ch];
+
+		if(c->running || c->blkHead == c->blkTail) { continue; }
+
+		StepBlock *b = &c->blks[c->blkTail & (STEPPER_NUM_BLOCKS - 1)];
+		c->pinBlk = c->feedBlk = c->blkTail;
+		c->pinLeft = b->n;
+		c->dmaFeed = false;
+		c->starved = false;
+		c->segsDone = 0;
+
+		// the first interval is loaded straight into the counter on enable
+		stepper_applyBlk(hw, b, stepper_getDat(ch)->inv);
+		stepper_writeIvl(hw, b->ivl[0]);
+		c->feedIdx = 1;
+		if(b->n == 1) { c->feedBlk++; c->feedIdx = 0; }
+
+		TimerIntClear(TIMER3_BASE, hw->capEvt | hw->dmaInt);
+		TimerIntEnable(TIMER3_BASE, hw->capEvt);
+
+		c->running = true;
+		enMask |= hw->timer;
+	}
+
+	if(!enMask) { return; }
+
+	TimerEnable(TIMER3_BASE, enMask);
+
+	// queue up the second period, latched on the first timeout
+	for(ch = 0; ch < STEPPER_NUM_CH; ch++)
+	{
+		if(enMask & stepHw[ch].timer) { stepper_feed(ch); }
+	}
+}
+
+
+
+
+void stepper_stop()
+{
+	stepper_halt(STEPPER_CH1);
+	stepper_halt(STEPPER_CH2);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////// Driver pin control /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Sets the microstepping mode of a channel's driver
+ *
+ * @param microsteps 1, 2, 4, 8 or 16. Anything else is treated as full steps
+ */
+void stepper_setMicrostep(uint8_t ch, uint8_t microsteps)
+{
+	const StepHw *hw = &stepHw[ch];
+	uint8_t ms; // MS3:MS2:MS1
+	uint8_t i;
+
+	switch(microsteps)
+	{
+		case 2:  ms = 0x1; break;
+		case 4:  ms = 0x2; break;
+		case 8:  ms = 0x3; break;
+		case 16: ms = 0x7; break;
+		default: ms = 0x0; break;
+	}
+
+	for(i = 0; i < 3; i++)
+	{
+		pin_write(hw->msPort[i], hw->msPin[i], ms & (1 << i));
+	}
+}
+
+
+
+
+void stepper_setEnabled(uint8_t ch, bool enable)
+{
+	const StepHw *hw = &stepHw[ch];
+	pin_write(hw->enPort, hw->enPin, !enable); // enable is active low
+}
+
+
+
+
+uint32_t stepper_getSegsDone(uint8_t ch) { return stepCh[ch].segsDone; }
+int32_t stepper_getPos(uint8_t ch) { return stepCh[ch].pos; }
+uint32_t stepper_getUnderruns(uint8_t ch) { return stepCh[ch].underruns; }
@@ -0,0 +1,88 @@
+/*
+ * stepper.h
+ *
+ * Hardware timed step generation for the extruder stepper drivers. The step
+ * pins are the Timer3 CCP outputs, so each step pulse is produced by the timer
+ * itself. Step intervals are precomputed into blocks from a queue of motion
+ * segments, and fed to the timer by the uDMA, so there is no CPU work per step
+ * at high step rates.
+ *
+ * Each queued segment spans exactly the same time as the carriage segment it
+ * was planned with, so the extruders stay locked to the carriage motion
+ */
+
+#ifndef CODE_STEPPER_H_
+#define CODE_STEPPER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STEPPER_NUM_CH		2	// number of step channels
+#define STEPPER_CH1			0	// Step1 outputs - PD5 / T3CCP1
+#define STEPPER_CH2			1	// Step2 outputs - PM2 / T3CCP0
+
+#define STEPPER_SEG_QLEN	16	// segments that can be queued per channel. Must be a power of 2
+#define STEPPER_NUM_BLOCKS	4	// interval blocks per channel. Must be a power of 2
+#define STEPPER_BLOCK_LEN	64	// max number of intervals in a block
+
+#define STEPPER_MAX_IVL		0xffffff	// longest interval the timer can count (24 bits)
+#define STEPPER_DMA_IVL		0xffff		// longest interval that can be fed by the uDMA (16 bits)
+
+// block flags
+#define STEPPER_BLK_DIR		0x01	// direction pin is set for this block
+#define STEPPER_BLK_IDLE	0x02	// no step pulses are output for this block
+#define STEPPER_BLK_SLOW	0x04	// intervals are too long for the uDMA, and are fed by the ISR
+#define STEPPER_BLK_SEGEND	0x08	// last block of a segment
+
+
+/**
+ * A block of step intervals, all belonging to the same segment and sharing the
+ * same direction. These are what actually get handed to the hardware
+ */
+typedef struct StepBlock
+{
+	uint32_t ivl[STEPPER_BLOCK_LEN]; // intervals (in clock cycles) ending in a step pulse
+	uint16_t n;		// number of valid intervals
+	uint8_t flags;	// STEPPER_BLK_xxx
+} StepBlock;
+
+
+
+/**
+ * A constant acceleration extruder move, lasting exactly as long as the carriage
+ * segment it is synchronized with
+ */
+typedef struct StepSeg
+{
+	int32_t steps;	// signed number of (micro)steps to take. 0 dwells for the duration
+	float v0;		// step rate at segment start (steps / sec)
+	float v1;		// step rate at segment end (steps / sec)
+	uint32_t dur;	// duration of the segment (in clock cycles)
+} StepSeg;
+
+
+
+void stepper_init(uint32_t clkFreq); // sets up Timer3, the uDMA and the driver pins
+void stepper_loadConfig(); // reapplies the pulse width and microstepping after a config load. Channels must be stopped
+
+bool stepper_queueSeg(uint8_t ch, int32_t steps, float v0, float v1, uint32_t dur); // adds a segment. false if the queue is full
+bool stepper_queueExtrude(uint8_t ch, float de, float v0, float v1, uint32_t dur); // adds a planned extrusion, with pressure advance applied
+void stepper_fill(uint8_t ch); // precomputes queued segments into interval blocks. Run from the planner context, not an ISR
+void stepper_refill(); // stepper_fill() on both channels
+
+void stepper_start(); // starts both channels on the same clock edge
+void stepper_stop(); // halts both channels immediately
+
+void stepper_setMicrostep(uint8_t ch, uint8_t microsteps); // sets the MS pins. 1, 2, 4, 8 or 16
+void stepper_setEnabled(uint8_t ch, bool enable); // turns the driver outputs on and off
+
+uint32_t stepper_getSegsDone(uint8_t ch); // number of segments fully output since stepper_start()
+int32_t stepper_getPos(uint8_t ch); // net steps output at the end of the last completed block
+uint32_t stepper_getUnderruns(uint8_t ch); // times the channel ran out of blocks while running
+
+// timer ISRs
+void stepper_ch1_ISR(); // Timer3B
+void stepper_ch2_ISR(); // Timer3A
+
+
+#endif /* CODE_STEPPER_H_ */
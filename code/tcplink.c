@@ -0,0 +1,166 @@
+/*
+ * tcplink.c
+ */
+
+#include "code/tcplink.h"
+#include "code/link.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/ndk/inc/netmain.h>
+
+static uint32_t tcplink_read(void *buf, uint32_t len, uint32_t timeoutMs);
+static bool tcplink_write(const void *buf, uint32_t len);
+
+LinkPort tcpLink = { "tcp", tcplink_read, tcplink_write, NULL, TCPLINK_RX_BUF, false };
+
+static SOCKET tcpListen = INVALID_SOCKET;
+static SOCKET tcpConn = INVALID_SOCKET;
+static uint32_t tcpTimeoutMs;	// receive timeout the connection has set
+
+
+
+
+/**
+ * Keeps trying until the stack is up and the port is bound
+ */
+static void tcplink_listen()
+{
+	struct sockaddr_in addr;
+
+	while(1)
+	{
+		tcpListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if(tcpListen != INVALID_SOCKET)
+		{
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_ANY);
+			addr.sin_port = htons(TCPLINK_PORT);
+
+			if(!bind(tcpListen, (PSA)&addr, sizeof(addr)) && !listen(tcpListen, 1)) { return; }
+
+			fdClose(tcpListen);
+			tcpListen = INVALID_SOCKET;
+		}
+
+		Task_sleep(TCPLINK_RETRY_MS);
+	}
+}
+
+
+
+
+static void tcplink_drop()
+{
+	fdClose(tcpConn);
+	tcpConn = INVALID_SOCKET;
+}
+
+
+
+
+/**
+ * Blocks until a host connects. The receive buffer has to be sized before
+ * the window is first advertised, so it is set on the listening socket and
+ * inherited
+ */
+static void tcplink_accept()
+{
+	struct timeval tv = { 0, LINK_POLL_MS * 1000 };
+	int one = 1;
+
+	tcpConn = accept(tcpListen, NULL, NULL);
+	if(tcpConn == INVALID_SOCKET) { return; }
+
+	setsockopt(tcpConn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	setsockopt(tcpConn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	tcpTimeoutMs = LINK_POLL_MS;
+}
+
+
+
+
+bool tcplink_connected()
+{
+	return tcpConn != INVALID_SOCKET;
+}
+
+
+
+
+/**
+ * A timeout of 0 is a non blocking read. Anything else is set as the socket's
+ * receive timeout, only when it changes. A closed connection is dropped, and
+ * the next read waits for another
+ */
+static uint32_t tcplink_read(void *buf, uint32_t len, uint32_t timeoutMs)
+{
+	struct timeval tv;
+	int n;
+
+	if(tcpConn == INVALID_SOCKET)
+	{
+		tcplink_accept();
+		return 0;
+	}
+
+	if(timeoutMs && timeoutMs != tcpTimeoutMs)
+	{
+		tv.tv_sec = timeoutMs / 1000;
+		tv.tv_usec = (timeoutMs % 1000) * 1000;
+		setsockopt(tcpConn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		tcpTimeoutMs = timeoutMs;
+	}
+
+	n = recv(tcpConn, buf, len, timeoutMs ? 0 : MSG_DONTWAIT);
+	if(n > 0) { return (uint32_t)n; }
+
+	if(!n || fdError() != EWOULDBLOCK) { tcplink_drop(); }
+	return 0;
+}
+
+
+
+
+static bool tcplink_write(const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+	int n;
+
+	while(len)
+	{
+		if(tcpConn == INVALID_SOCKET) { return false; }
+
+		n = send(tcpConn, (void *)p, len, 0);
+		if(n <= 0)
+		{
+			tcplink_drop();
+			return false;
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+
+
+
+void tcplink_task(UArg arg0, UArg arg1)
+{
+	int rxBuf = TCPLINK_RX_BUF;
+
+	fdOpenSession(TaskSelf());
+
+	tcplink_listen();
+	setsockopt(tcpListen, SOL_SOCKET, SO_RCVBUF, &rxBuf, sizeof(rxBuf));
+
+	link_serve(&tcpLink);
+}
@@ -0,0 +1,31 @@
+/*
+ * tcplink.h
+ *
+ * Ethernet host link. link.h's packets over one TCP connection at a time, on
+ * TCPLINK_PORT, through the NDK's native socket calls. The receive buffer is
+ * set to TCPLINK_RX_BUF, and that is the byte window given out in credits,
+ * so TCP's own window never has to close on a sender that follows them.
+ * The port number is the same as the HOST_SIM stand-in in usblink.h, so the
+ * host tools reach the board and the simulation the same way
+ */
+
+#ifndef CODE_TCPLINK_H_
+#define CODE_TCPLINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include "code/link.h"
+
+#define TCPLINK_PORT		5170
+#define TCPLINK_RX_BUF		4096	// socket receive buffer, and the byte credit window
+#define TCPLINK_RETRY_MS	1000	// wait before trying the listening socket again
+
+extern LinkPort tcpLink;
+
+
+bool tcplink_connected(); // a host is connected
+void tcplink_task(UArg arg0, UArg arg1); // listens, then serves tcpLink forever
+
+
+#endif /* CODE_TCPLINK_H_ */
@@ -0,0 +1,160 @@
+/*
+ * timebase.c
+ */
+
+#include "code/timebase.h"
+#include <stdint.h>
+
+#ifndef HOST_SIM
+#include <stdbool.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_types.h>
+#include <inc/hw_timer.h>
+#include <driverlib/timer.h>
+#endif
+
+Timebase timebase;
+
+#ifdef HOST_SIM
+static uint64_t tbSimCycles;
+#else
+static volatile uint32_t tbEpoch; // wraps seen in the top 31 bits, top bit of the counter at the last read in bit 0
+#endif
+
+
+
+
+/**
+ * Computes num / den as a fixed point rate. The fraction is rounded up, so
+ * exact multiples (eg. 120 cycles -> 1us) don't truncate down by one. The 64
+ * bit divisions here are why this is only done when the clock changes
+ */
+static TbRate timebase_rate(uint64_t num, uint64_t den)
+{
+	TbRate r;
+
+	r.whole = (uint32_t)(num / den);
+	r.frac = (uint32_t)((((num % den) << 32) + den - 1) / den);
+
+	r.wrapWhole = (num << 32) / den;
+	r.wrapFrac = (uint32_t)(((((num << 32) % den) << 32) + den - 1) / den);
+
+	return r;
+}
+
+
+
+
+/**
+ * @param clkFreq system clock frequency, as returned by SysCtlClockFreqSet()
+ */
+void timebase_init(uint32_t clkFreq)
+{
+	timebase.clk = clkFreq;
+	timebase.usToCyc = timebase_rate(clkFreq, 1000000);
+	timebase.nsToCyc = timebase_rate(clkFreq, 1000000000);
+	timebase.cycToUs = timebase_rate(1000000, clkFreq);
+	timebase.cycToNs = timebase_rate(1000000000, clkFreq);
+
+	timebase_setPwmDiv(1);
+}
+
+
+
+
+/**
+ * @param div divider between the system clock and the PWM clock. 1 to TIMEBASE_PWM_MAX_DIV
+ */
+void timebase_setPwmDiv(uint32_t div)
+{
+	timebase.pwmDiv = div;
+	timebase.usToPwm = timebase_rate(timebase.clk, (uint64_t)div * 1000000);
+}
+
+
+
+
+uint32_t timebase_getClk()
+{
+	return timebase.clk;
+}
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// System time //////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+uint64_t currTime()
+{
+	return timebase_scale64(currTimeCycles(), &timebase.cycToUs);
+}
+
+
+
+
+#ifdef HOST_SIM
+
+uint64_t currTimeCycles()
+{
+	return tbSimCycles;
+}
+
+
+
+void timebase_simAdvance(uint64_t cycles)
+{
+	tbSimCycles += cycles;
+}
+
+#else
+
+/**
+ * Sets TIMER5 up as a 32 bit up counter, wrapping every 2^32 clock cycles
+ */
+void timebase_startTimer()
+{
+	TimerConfigure(TIMER5_BASE, TIMER_CFG_PERIODIC_UP);
+	TimerLoadSet(TIMER5_BASE, TIMER_A, 0xffffffff);
+	tbEpoch = 0;
+	TimerEnable(TIMER5_BASE, TIMER_A);
+}
+
+
+
+
+/**
+ * Reads the counter, and extends it with the wrap count. If the counter's
+ * top bit was set at the last read and isn't now, it has wrapped since.
+ *
+ * The epoch is written with a plain store. A reader preempted between its
+ * load and store can put back an older epoch, but that one is still less
+ * than half a wrap old, so the next read still works out the right count
+ */
+uint64_t currTimeCycles()
+{
+	uint32_t epoch = tbEpoch;
+	uint32_t lo = HWREG(TIMER5_BASE + TIMER_O_TAV);
+	uint32_t hi = epoch >> 1;
+
+	if((epoch & 1) && !(lo >> 31)) { hi++; }
+
+	uint32_t newEpoch = (hi << 1) | (lo >> 31);
+	if(newEpoch != epoch) { tbEpoch = newEpoch; }
+
+	return ((uint64_t)hi << 32) | lo;
+}
+
+
+
+
+void timebase_poll(UArg arg0)
+{
+	currTimeCycles();
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * timebase.h
+ *
+ * Caches the system clock frequency set by SysCtlClockFreqSet(), and converts
+ * between time units and clock cycles. SysCtlClockGet() doesn't work on the
+ * TM4C129x parts, so nothing should call it.
+ *
+ * Each conversion rate is precomputed as a 32.32 fixed point multiplier when
+ * the clock is set, so a conversion is one 32 bit multiply plus one 32x32->64
+ * multiply, with no division. Results are truncated to within one count of
+ * exact, and have to fit in 32 bits (about 35s of cycles at 120MHz)
+ *
+ * currTime() is the system clock for timestamps. It extends TIMER5, free
+ * running at the system clock, out to 64 bits. The extension keeps the number
+ * of wraps and the top bit of the counter as of the last read in one word, so
+ * it is safe from any context without masking interrupts, as long as it is
+ * read at least once per half wrap (about 17s). timebase_poll() makes sure of
+ * that. Under HOST_SIM there is no timer, and the clock only moves when the
+ * simulation advances it
+ */
+
+#ifndef CODE_TIMEBASE_H_
+#define CODE_TIMEBASE_H_
+
+#include <stdint.h>
+
+#ifndef HOST_SIM
+#include <xdc/std.h>
+#endif
+
+#define TIMEBASE_PWM_MAX_DIV	64	// largest PWM clock divider
+
+
+/**
+ * A conversion rate, as a 32.32 fixed point number
+ */
+typedef struct TbRate
+{
+	uint32_t whole;
+	uint32_t frac;		// fractional part, in units of 2^-32
+	uint64_t wrapWhole;	// the rate times 2^32, for the top word of 64 bit values
+	uint32_t wrapFrac;
+} TbRate;
+
+
+typedef struct Timebase
+{
+	uint32_t clk;		// system clock (Hz)
+	uint32_t pwmDiv;	// PWM clock divider
+	TbRate usToCyc;
+	TbRate nsToCyc;
+	TbRate cycToUs;
+	TbRate cycToNs;
+	TbRate usToPwm;		// usecs to PWM generator counts
+} Timebase;
+
+extern Timebase timebase; // only written by timebase_init() and timebase_setPwmDiv()
+
+
+void timebase_init(uint32_t clkFreq); // caches the clock and computes the rates. Run right after SysCtlClockFreqSet()
+void timebase_setPwmDiv(uint32_t div); // sets the PWM clock divider the PWM rate is computed with
+uint32_t timebase_getClk(); // system clock frequency (Hz)
+
+uint64_t currTime();		// returns the current system time in usecs
+uint64_t currTimeCycles();	// returns the current system time in clock cycles
+
+#ifdef HOST_SIM
+void timebase_simAdvance(uint64_t cycles); // moves the simulated clock forward
+#else
+void timebase_startTimer(); // starts TIMER5 free running. SYSCTL_PERIPH_TIMER5 must be enabled
+void timebase_poll(UArg arg0); // keeps the 64 bit extension current. Run from a Clock at least every few secs
+#endif
+
+
+
+static inline uint32_t timebase_scale(uint32_t x, const TbRate *r)
+{
+	return x * r->whole + (uint32_t)(((uint64_t)x * r->frac) >> 32);
+}
+
+
+/**
+ * Same as timebase_scale(), for 64 bit values. The top word is scaled by its
+ * own rate, so the rounding error doesn't grow with the value
+ */
+static inline uint64_t timebase_scale64(uint64_t x, const TbRate *r)
+{
+	uint32_t hi = (uint32_t)(x >> 32), lo = (uint32_t)x;
+
+	return hi * r->wrapWhole + (((uint64_t)hi * r->wrapFrac) >> 32) +
+			(uint64_t)lo * r->whole + (((uint64_t)lo * r->frac) >> 32);
+}
+
+
+static inline uint32_t timebase_usToCycles(uint32_t us) { return timebase_scale(us, &timebase.usToCyc); }
+static inline uint32_t timebase_nsToCycles(uint32_t ns) { return timebase_scale(ns, &timebase.nsToCyc); }
+static inline uint32_t timebase_cyclesToUs(uint32_t cyc) { return timebase_scale(cyc, &timebase.cycToUs); }
+static inline uint32_t timebase_cyclesToNs(uint32_t cyc) { return timebase_scale(cyc, &timebase.cycToNs); }
+static inline uint32_t timebase_usToPwm(uint32_t us) { return timebase_scale(us, &timebase.usToPwm); }
+
+
+#endif /* CODE_TIMEBASE_H_ */
@@ -0,0 +1,737 @@
+/*
+ * tune.c
+ */
+
+#include "code/tune.h"
+#include "code/config.h"
+#include "code/dat.h"
+#include "code/isrlat.h"
+#include "code/enc.h"
+#include "code/mon.h"
+#include "code/pool.h"
+#include "code/prof.h"
+#include "code/wpq.h"
+#include "code/link.h"
+#include "code/job.h"
+#include "code/kin.h"
+#include "code/hwIO.h"
+#include "code/timebase.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/gates/GateMutex.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include "code/noalloc.h"
+
+// value types in the parameter table
+#define TUNE_F32	0
+#define TUNE_U32	1
+
+
+typedef struct TuneParam
+{
+	const char *name;	// key, after the "axisX." prefix
+	uint8_t type;
+	uint32_t off;		// offset in AxisDat
+	float min;			// allowed range
+	float max;
+} TuneParam;
+
+
+/**
+ * Everything that can be changed live. Ranges match the config table
+ */
+static const TuneParam tuneTbl[] =
+{
+	{ "pid.kp",			TUNE_F32,	offsetof(AxisDat, pid.kp),			-1e6,	1e6 },
+	{ "pid.ki",			TUNE_F32,	offsetof(AxisDat, pid.ki),			-1e6,	1e6 },
+	{ "pid.kd",			TUNE_F32,	offsetof(AxisDat, pid.kd),			-1e6,	1e6 },
+	{ "mot.low",		TUNE_U32,	offsetof(AxisDat, mot.low),			0,		100000 },
+	{ "mot.high",		TUNE_U32,	offsetof(AxisDat, mot.high),		0,		100000 },
+	{ "mot.deadband",	TUNE_U32,	offsetof(AxisDat, mot.deadband),	0,		100000 }
+};
+
+#define TUNE_NUM_PARAMS (sizeof(tuneTbl) / sizeof(tuneTbl[0]))
+
+
+static AxisDat * const tuneCfg[TUNE_NUM_AXES] = { &axisADat, &axisBDat, &axisCDat };
+
+static AxisDat tuneBuf[TUNE_NUM_AXES][2];					// live and spare copy of each axis
+static const AxisDat * volatile tuneLive[TUNE_NUM_AXES];	// copy the servo tick is using
+static AxisDat tuneShadow[TUNE_NUM_AXES];					// where commands stage changes
+static uint8_t tuneDirty;				// axes with staged changes
+static volatile uint8_t tunePending;	// axes with a validated copy waiting in the spare buffer
+static volatile uint32_t tuneSwaps;
+static GateMutex_Struct tuneGate;		// one command at a time, across every transport
+
+static bool tune_runLine(char *line, char *resp, uint32_t respLen);
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Buffers //////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Loads both the live buffers and the shadow copies from the config variables
+ */
+void tune_init()
+{
+	uint8_t i;
+	for(i = 0; i < TUNE_NUM_AXES; i++)
+	{
+		tuneBuf[i][0] = *tuneCfg[i];
+		tuneShadow[i] = *tuneCfg[i];
+		tuneLive[i] = &tuneBuf[i][0];
+	}
+
+	tuneDirty = 0;
+	tunePending = 0;
+
+	GateMutex_construct(&tuneGate, NULL);
+}
+
+
+
+RAMFUNC static AxisDat *tune_spare(uint8_t axis)
+{
+	return tuneLive[axis] == &tuneBuf[axis][0] ? &tuneBuf[axis][1] : &tuneBuf[axis][0];
+}
+
+
+
+
+/**
+ * Swaps the live pointers over to any committed copies. The spare buffers
+ * are never written while an update is pending, so this is the only
+ * synchronization needed
+ */
+RAMFUNC void tune_tick()
+{
+	uint8_t pend = tunePending, i;
+	if(!pend) { return; }
+
+	for(i = 0; i < TUNE_NUM_AXES; i++)
+	{
+		if(pend & (1 << i)) { tuneLive[i] = tune_spare(i); }
+	}
+
+	tunePending = 0;
+	tuneSwaps++;
+}
+
+
+
+
+/**
+ * Copies the dirty shadow axes into the spare buffers and marks them pending.
+ * An update the tick hasn't taken yet (the servo tick isn't running, or hasn't
+ * come around) is taken back first and merged in, so this never has to wait
+ * on the tick. Call with tuneGate held
+ */
+static void tune_publish()
+{
+	uint8_t pend, i;
+
+	// once the tick can't see it, the spare buffer is ours again
+	UInt key = Hwi_disable();
+	pend = tunePending;
+	tunePending = 0;
+	Hwi_restore(key);
+
+	for(i = 0; i < TUNE_NUM_AXES; i++)
+	{
+		if(tuneDirty & (1 << i)) { *tune_spare(i) = tuneShadow[i]; }
+	}
+
+	tunePending = pend | tuneDirty;
+	tuneDirty = 0;
+}
+
+
+
+
+/**
+ * Reloads every axis from the config variables, eg. once the real config has
+ * been loaded over the compiled in defaults. Anything staged is thrown away.
+ * The servo tick picks the new values up at its next tick
+ */
+void tune_reload()
+{
+	uint8_t i;
+	IArg key = GateMutex_enter(GateMutex_handle(&tuneGate));
+
+	for(i = 0; i < TUNE_NUM_AXES; i++)
+	{
+		tuneShadow[i] = *tuneCfg[i];
+	}
+
+	tuneDirty = (1 << TUNE_NUM_AXES) - 1;
+	tune_publish();
+
+	GateMutex_leave(GateMutex_handle(&tuneGate), key);
+}
+
+
+
+
+RAMFUNC const AxisDat *tune_getAxis(uint8_t axis)
+{
+	return tuneLive[axis];
+}
+
+
+
+uint32_t tune_getSwaps()
+{
+	return tuneSwaps;
+}
+
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Commands /////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Splits the next whitespace separated word off of a string
+ *
+ * @return the word, or NULL if there are none left
+ */
+static char *tune_nextWord(char **s)
+{
+	char *p = *s, *word;
+
+	while(*p == ' ' || *p == '\t') { p++; }
+	if(!*p) { return NULL; }
+
+	word = p;
+	while(*p && *p != ' ' && *p != '\t') { p++; }
+	if(*p) { *p++ = 0; }
+
+	*s = p;
+	return word;
+}
+
+
+
+
+/**
+ * Looks up an "axisX.xxx" key
+ *
+ * @return the parameter, or NULL if the key isn't tunable
+ */
+static const TuneParam *tune_findKey(const char *key, uint8_t *axis)
+{
+	uint32_t i;
+
+	if(strncmp(key, "axis", 4) || key[4] < 'A' || key[4] >= 'A' + TUNE_NUM_AXES || key[5] != '.') { return NULL; }
+	*axis = key[4] - 'A';
+
+	for(i = 0; i < TUNE_NUM_PARAMS; i++)
+	{
+		if(!strcmp(key + 6, tuneTbl[i].name)) { return &tuneTbl[i]; }
+	}
+
+	return NULL;
+}
+
+
+
+
+/**
+ * Formats a float, since System_snprintf() doesn't do %f
+ */
+static void tune_fmtFloat(char *buf, uint32_t len, float f)
+{
+	const char *sign = f < 0 ? "-" : "";
+	if(f < 0) { f = -f; }
+
+	uint32_t whole = (uint32_t)f;
+	uint32_t frac = (uint32_t)((f - whole) * 1e6f + 0.5f);
+	if(frac >= 1000000) { whole++; frac -= 1000000; }
+
+	System_snprintf(buf, len, "%s%u.%06u", sign, whole, frac);
+}
+
+
+
+
+static bool tune_get(char *args, char *resp, uint32_t respLen)
+{
+	char *key = tune_nextWord(&args), val[24];
+	const TuneParam *p;
+	uint8_t axis;
+
+	if(!key || !(p = tune_findKey(key, &axis)))
+	{
+		System_snprintf(resp, respLen, "err unknown key");
+		return false;
+	}
+
+	const uint8_t *src = (const uint8_t *)tuneLive[axis] + p->off;
+
+	if(p->type == TUNE_F32)
+		tune_fmtFloat(val, sizeof(val), *(const float *)src);
+	else
+		System_snprintf(val, sizeof(val), "%u", *(const uint32_t *)src);
+
+	System_snprintf(resp, respLen, "ok %s", val);
+	return true;
+}
+
+
+
+
+static bool tune_set(char *args, char *resp, uint32_t respLen)
+{
+	char *key = tune_nextWord(&args);
+	char *str = tune_nextWord(&args);
+	const TuneParam *p;
+	uint8_t axis;
+	char *end;
+
+	if(!key || !(p = tune_findKey(key, &axis)))
+	{
+		System_snprintf(resp, respLen, "err unknown key");
+		return false;
+	}
+
+	float f = str ? strtof(str, &end) : 0;
+	if(!str || end == str || *end || f != f || f < p->min || f > p->max || (p->type == TUNE_U32 && f != (uint32_t)f))
+	{
+		System_snprintf(resp, respLen, "err bad value");
+		return false;
+	}
+
+	uint8_t *dst = (uint8_t *)&tuneShadow[axis] + p->off;
+
+	if(p->type == TUNE_F32)
+		*(float *)dst = f;
+	else
+		*(uint32_t *)dst = (uint32_t)f;
+
+	tuneDirty |= 1 << axis;
+	System_snprintf(resp, respLen, "ok");
+	return true;
+}
+
+
+
+
+/**
+ * Validates the staged axes, and hands them to the servo tick. Nothing is
+ * published unless every staged axis is good
+ */
+static bool tune_commit(char *resp, uint32_t respLen)
+{
+	uint8_t i;
+
+	for(i = 0; i < TUNE_NUM_AXES; i++)
+	{
+		if((tuneDirty & (1 << i)) && !config_checkMot(&tuneShadow[i].mot))
+		{
+			System_snprintf(resp, respLen, "err axis%c.mot settings are inconsistent", 'A' + i);
+			return false;
+		}
+	}
+
+	// keep the config variables in step, so a save stores what is running
+	for(i = 0; i < TUNE_NUM_AXES; i++)
+	{
+		if(!(tuneDirty & (1 << i))) { continue; }
+
+		tuneCfg[i]->pid = tuneShadow[i].pid;
+		tuneCfg[i]->mot = tuneShadow[i].mot;
+	}
+
+	tune_publish();
+
+	System_snprintf(resp, respLen, "ok");
+	return true;
+}
+
+
+
+
+/**
+ * Latency measurement. "lat start", "lat stop", or "lat get <portX>", which
+ * answers with the worst latency in ns and the number of samples
+ */
+static bool tune_lat(char *args, char *resp, uint32_t respLen)
+{
+	char *sub = tune_nextWord(&args);
+	char *name = tune_nextWord(&args);
+	int8_t src;
+
+	if(sub && !strcmp(sub, "start")) { isrlat_start(); }
+	else if(sub && !strcmp(sub, "stop")) { isrlat_stop(); }
+	else if(sub && !strcmp(sub, "get"))
+	{
+		if(!name || (src = isrlat_findSrc(name)) < 0)
+		{
+			System_snprintf(resp, respLen, "err unknown source");
+			return false;
+		}
+
+		System_snprintf(resp, respLen, "ok %u %u", isrlat_getMaxNs(src), isrlat_getSamples(src));
+		return true;
+	}
+	else
+	{
+		System_snprintf(resp, respLen, "err unknown command");
+		return false;
+	}
+
+	System_snprintf(resp, respLen, "ok");
+	return true;
+}
+
+
+
+
+/**
+ * Encoder health. "enc axisX" answers with the good edges, illegal
+ * transitions, overruns, max edge rate, and 1 if the axis needs homing.
+ * "enc homed axisX" clears a lost axis once it has been homed by hand, and
+ * turns the motors back on when no axis is still lost
+ */
+static bool tune_enc(char *args, char *resp, uint32_t respLen)
+{
+	char *name = tune_nextWord(&args);
+	bool homed = name && !strcmp(name, "homed");
+	uint8_t axis, i;
+
+	if(homed) { name = tune_nextWord(&args); }
+
+	if(!name || strncmp(name, "axis", 4) || name[4] < 'A' || name[4] >= 'A' + ENC_NUM_AXES || name[5])
+	{
+		System_snprintf(resp, respLen, "err unknown axis");
+		return false;
+	}
+
+	axis = name[4] - 'A';
+
+	if(homed)
+	{
+		bool wasLost = enc_isLost(axis), anyLost = false;
+
+		enc_homed(axis);
+		for(i = 0; i < ENC_NUM_AXES; i++) { anyLost |= enc_isLost(i); }
+
+		// only undo the stop enc_service() made, never turn on motors that were off anyway
+		if(wasLost && !anyLost) { setMotorsEnabled(true); }
+
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	System_snprintf(resp, respLen, "ok %u %u %u %u %u", encHealth[axis].edges, encHealth[axis].illegal,
+			encHealth[axis].overruns, enc_getMaxRate(axis), enc_isLost(axis));
+	return true;
+}
+
+
+
+
+/**
+ * Monitor. "mon" answers with the CPU load (1/10 %), system stack peak and
+ * size, and heap use, peak and size. "mon <thread>" answers with the
+ * thread's load, max load, and for tasks the stack peak and size
+ */
+static bool tune_mon(char *args, char *resp, uint32_t respLen)
+{
+	char *name = tune_nextWord(&args);
+	const MonSample *smp = mon_getLatest();
+	int8_t slot;
+
+	if(!smp)
+	{
+		System_snprintf(resp, respLen, "err no samples yet");
+		return false;
+	}
+
+	if(!name)
+	{
+		System_snprintf(resp, respLen, "ok %u %u %u %u %u %u", smp->cpuLoad, smp->hwiStackPeak, smp->hwiStackSize,
+				smp->heapUsed, smp->heapPeak, smp->heapSize);
+		return true;
+	}
+
+	if((slot = mon_findSlot(name)) < 0)
+	{
+		System_snprintf(resp, respLen, "err unknown thread");
+		return false;
+	}
+
+	const MonSlot *s = mon_getSlot(slot);
+	System_snprintf(resp, respLen, "ok %u %u %u %u", s->load, s->maxLoad, s->stackPeak, s->stackSize);
+	return true;
+}
+
+
+
+
+/**
+ * Memory pools. "pool <name>" answers with the blocks in use, the peak, the
+ * total, and the failed allocations
+ */
+static bool tune_pool(char *args, char *resp, uint32_t respLen)
+{
+	char *name = tune_nextWord(&args);
+	Pool *p;
+
+	if(!name || !(p = pool_find(name)))
+	{
+		System_snprintf(resp, respLen, "err unknown pool");
+		return false;
+	}
+
+	System_snprintf(resp, respLen, "ok %u %u %u %u", p->used, p->peak, p->numBlks, p->fails);
+	return true;
+}
+
+
+
+
+/**
+ * Servo path profile. "prof <probe>" answers with the samples, then the min,
+ * max, mean and standard deviation in ns. "prof reset" clears every probe
+ */
+static bool tune_prof(char *args, char *resp, uint32_t respLen)
+{
+	char *name = tune_nextWord(&args);
+	ProfStat s;
+	int8_t id;
+
+	if(name && !strcmp(name, "reset"))
+	{
+		prof_reset();
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	if(!name || (id = prof_find(name)) < 0)
+	{
+		System_snprintf(resp, respLen, "err unknown probe");
+		return false;
+	}
+
+	prof_get(id, &s);
+	System_snprintf(resp, respLen, "ok %u %u %u %u %u", s.n, timebase_cyclesToNs(s.min), timebase_cyclesToNs(s.max),
+			prof_meanNs(&s), prof_stdDevNs(&s));
+	return true;
+}
+
+
+
+
+/**
+ * Job files. "job" answers with whether a job is open and whether it is
+ * playing, then the chunk size, read-ahead depth, consumption rate (B/s),
+ * chunks read, longest read (us), parser waits, read errors, batches played
+ * and bad batches. "job run <path>" plays a waypoint job, "job stop" ends it
+ */
+static bool tune_job(char *args, char *resp, uint32_t respLen)
+{
+	const JobStats *s = job_getStats();
+	char *sub = tune_nextWord(&args);
+
+	if(sub && !strcmp(sub, "run"))
+	{
+		char *path = tune_nextWord(&args);
+		bool ok = path && job_run(path);
+
+		System_snprintf(resp, respLen, ok ? "ok" : (path ? "err couldn't start" : "err no path"));
+		return ok;
+	}
+
+	if(sub && !strcmp(sub, "stop"))
+	{
+		job_stop();
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	if(sub)
+	{
+		System_snprintf(resp, respLen, "err unknown option");
+		return false;
+	}
+
+	System_snprintf(resp, respLen, "ok %d %d %u %u %u %u %u %u %u %u %u", job_isOpen(), job_isPlaying(),
+			s->chunkSize, s->depth, s->rate, s->chunks, s->readUs, s->waits, s->errors, s->batches, s->bad);
+	return true;
+}
+
+
+
+
+/**
+ * Waypoint queue. "wpq" answers with the batches queued now, then the batch,
+ * waypoint, copy, reject, full and underrun counts. "wpq flush" drops
+ * everything queued
+ */
+static bool tune_wpq(char *args, char *resp, uint32_t respLen)
+{
+	char *word = tune_nextWord(&args);
+	const WpqStats *s = wpq_getStats();
+
+	if(word && !strcmp(word, "flush"))
+	{
+		wpq_flush();
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	if(word)
+	{
+		System_snprintf(resp, respLen, "err unknown option");
+		return false;
+	}
+
+	System_snprintf(resp, respLen, "ok %u %u %u %u %u %u %u", wpq_getQueued(), s->batches, s->points,
+			s->copies, s->rejects, s->full, s->underruns);
+	return true;
+}
+
+
+
+
+/**
+ * Move slicing load. "kin [budget]" answers with the CPU load (1/10 %) of
+ * slicing at kin.segRate, the worst cycles taken by a slice, and the densest
+ * slice rate (slices/s) that fits in budget % of the CPU, 100 if left out.
+ * "kin reset" clears the counts
+ */
+static bool tune_kin(char *args, char *resp, uint32_t respLen)
+{
+	char *word = tune_nextWord(&args), *end;
+	float budget = 100;
+
+	if(word && !strcmp(word, "reset"))
+	{
+		kin_resetStats();
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	if(word)
+	{
+		budget = strtof(word, &end);
+		if(end == word || *end || !(budget > 0 && budget <= 100))
+		{
+			System_snprintf(resp, respLen, "err bad budget");
+			return false;
+		}
+	}
+
+	System_snprintf(resp, respLen, "ok %u %u %u", (uint32_t)(kin_getLoad() * 1000), kin_getMaxCycles(),
+			(uint32_t)kin_getMaxSegRate(budget / 100));
+	return true;
+}
+
+
+
+
+/**
+ * Host link throughput. "link <port>" answers with the inbound and outbound
+ * rates (bytes/s) over the last second, then the peaks, then the packets each
+ * way and the bad ones
+ */
+static bool tune_link(char *args, char *resp, uint32_t respLen)
+{
+	char *name = tune_nextWord(&args);
+	LinkPort *port;
+
+	if(!name || !(port = link_find(name)))
+	{
+		System_snprintf(resp, respLen, "err unknown link");
+		return false;
+	}
+
+	const LinkStats *s = &port->stats;
+	System_snprintf(resp, respLen, "ok %u %u %u %u %u %u %u", s->rxRate, s->txRate, s->rxPeak, s->txPeak,
+			s->rxPkts, s->txPkts, s->bad);
+	return true;
+}
+
+
+
+
+/**
+ * Runs one command line. Transports each call this from their own task, and
+ * take turns through the gate
+ *
+ * @param line null terminated command, without the line ending. Modified in place
+ * @param resp where to put the response line
+ * @param respLen size of resp
+ *
+ * @return true if the command succeeded
+ */
+bool tune_handleLine(char *line, char *resp, uint32_t respLen)
+{
+	IArg key = GateMutex_enter(GateMutex_handle(&tuneGate));
+	bool ok = tune_runLine(line, resp, respLen);
+	GateMutex_leave(GateMutex_handle(&tuneGate), key);
+
+	return ok;
+}
+
+
+
+
+static bool tune_runLine(char *line, char *resp, uint32_t respLen)
+{
+	char *cmd = tune_nextWord(&line);
+	uint8_t i;
+
+	if(!cmd)
+	{
+		System_snprintf(resp, respLen, "err empty");
+		return false;
+	}
+
+	if(!strcmp(cmd, "get")) { return tune_get(line, resp, respLen); }
+	if(!strcmp(cmd, "set")) { return tune_set(line, resp, respLen); }
+	if(!strcmp(cmd, "commit")) { return tune_commit(resp, respLen); }
+	if(!strcmp(cmd, "lat")) { return tune_lat(line, resp, respLen); }
+	if(!strcmp(cmd, "enc")) { return tune_enc(line, resp, respLen); }
+	if(!strcmp(cmd, "mon")) { return tune_mon(line, resp, respLen); }
+	if(!strcmp(cmd, "pool")) { return tune_pool(line, resp, respLen); }
+	if(!strcmp(cmd, "prof")) { return tune_prof(line, resp, respLen); }
+	if(!strcmp(cmd, "wpq")) { return tune_wpq(line, resp, respLen); }
+	if(!strcmp(cmd, "job")) { return tune_job(line, resp, respLen); }
+	if(!strcmp(cmd, "link")) { return tune_link(line, resp, respLen); }
+	if(!strcmp(cmd, "kin")) { return tune_kin(line, resp, respLen); }
+
+	if(!strcmp(cmd, "abort"))
+	{
+		for(i = 0; i < TUNE_NUM_AXES; i++) { tuneShadow[i] = *tuneCfg[i]; }
+		tuneDirty = 0;
+
+		System_snprintf(resp, respLen, "ok");
+		return true;
+	}
+
+	if(!strcmp(cmd, "save"))
+	{
+		bool ok = config_saveNV();
+		System_snprintf(resp, respLen, ok ? "ok" : "err write failed");
+		return ok;
+	}
+
+	System_snprintf(resp, respLen, "err unknown command");
+	return false;
+}
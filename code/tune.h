@@ -0,0 +1,61 @@
+/*
+ * tune.h
+ *
+ * Live tuning of the axis PID gains and motor pulse limits, without a rebuild.
+ * Commands edit a shadow copy of each axis' config. On commit the shadow is
+ * validated and copied into a spare buffer, and the servo tick swaps its
+ * pointer over to it at the start of the next tick, so the servo code never
+ * waits on a lock or sees a half written struct.
+ *
+ * Commands are single lines of text, using the same keys as the config file.
+ * They come in over any of the host links in link.h, and the UART one also
+ * takes them straight from a terminal:
+ *
+ *   get axisA.pid.kp
+ *   set axisA.pid.kp 0.8     # staged in the shadow copy
+ *   commit                   # validates, and publishes at the next tick
+ *   abort                    # throws away anything staged
+ *   save                     # writes the live values to the on chip store
+ *   lat start|stop           # ISR latency measurement, see isrlat.h
+ *   lat get portL            # worst latency (ns) and sample count for a port
+ *   enc axisA                # encoder health counters, see enc.h
+ *   enc homed axisA          # clears a lost axis after homing it by hand, motors back on once none are lost
+ *   mon [thread]             # CPU load, stack and heap use, see mon.h
+ *   pool poolWp              # memory pool occupancy, see pool.h
+ *   prof servo|reset         # servo path execution time and jitter, see prof.h
+ *   wpq [flush]              # waypoint queue counters, or drop the queue, see wpq.h
+ *   job [run <path>|stop]    # job file counters, or play a waypoint job, see job.h
+ *   link usb|tcp|uart        # host link throughput, see link.h
+ *   kin [budget|reset]       # move slicing load, and the slice rate a CPU budget (%) allows, see kin.h
+ *
+ * Every command gets back a line starting with "ok" or "err". The PWM period
+ * and the motor output mode are fixed when the generators are set up, so only
+ * the PID gains and the low, high and deadband pulse settings can be changed
+ */
+
+#ifndef CODE_TUNE_H_
+#define CODE_TUNE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include "code/dat.h"
+
+#define TUNE_NUM_AXES	3
+#define TUNE_AXIS_A		0
+#define TUNE_AXIS_B		1
+#define TUNE_AXIS_C		2
+
+
+void tune_init(); // loads the live buffers from the config variables. Run before anything drives the motors
+void tune_reload(); // republishes every axis from the config variables, eg. after initConfig()
+void tune_tick(); // publishes committed changes. Run first thing in the servo tick, and nowhere else
+
+const AxisDat *tune_getAxis(uint8_t axis); // live config of an axis. Only stable for the rest of the current tick
+
+bool tune_handleLine(char *line, char *resp, uint32_t respLen); // runs one command, from any transport. false if it failed
+
+uint32_t tune_getSwaps(); // number of updates published
+
+
+#endif /* CODE_TUNE_H_ */
@@ -0,0 +1,65 @@
+/*
+ * uartlink.c
+ */
+
+#include "code/uartlink.h"
+#include "code/link.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/drivers/UART.h>
+#include "Board.h"
+
+static uint32_t uartlink_read(void *buf, uint32_t len, uint32_t timeoutMs);
+static bool uartlink_write(const void *buf, uint32_t len);
+
+LinkPort uartLink = { "uart", uartlink_read, uartlink_write, NULL, UARTLINK_RX_BUF, true };
+
+static UART_Handle uart;
+
+
+
+
+/**
+ * The driver returns what it has once its read timeout runs out, whatever
+ * timeoutMs asks for
+ */
+static uint32_t uartlink_read(void *buf, uint32_t len, uint32_t timeoutMs)
+{
+	int n = UART_read(uart, buf, len);
+	return n > 0 ? (uint32_t)n : 0;
+}
+
+
+
+
+static bool uartlink_write(const void *buf, uint32_t len)
+{
+	return UART_write(uart, buf, len) == (int)len;
+}
+
+
+
+
+void uartlink_task(UArg arg0, UArg arg1)
+{
+	UART_Params params;
+	UART_Params_init(&params);
+	params.baudRate = UARTLINK_BAUD;
+	params.readDataMode = UART_DATA_BINARY;
+	params.writeDataMode = UART_DATA_BINARY;
+	params.readReturnMode = UART_RETURN_FULL;
+	params.readEcho = UART_ECHO_OFF;
+	params.readTimeout = LINK_POLL_MS;
+
+	uart = UART_open(Board_UART0, &params);
+	if(!uart)
+	{
+		System_printf("uartlink: couldn't open UART0\n");
+		return;
+	}
+
+	link_serve(&uartLink);
+}
@@ -0,0 +1,29 @@
+/*
+ * uartlink.h
+ *
+ * UART0 host link (the debug USB port on the launchpad). It is a text port,
+ * so plain tune command lines still work from a terminal, and link.h's
+ * packets run over it as well, credits included. The driver's receive ring
+ * in EK_TM4C1294XL.c is UARTLINK_RX_BUF long, so it holds a whole packet, and
+ * that is the byte window given out in credits. The driver's read timeout is
+ * fixed when the port is opened, so every read waits up to LINK_POLL_MS
+ */
+
+#ifndef CODE_UARTLINK_H_
+#define CODE_UARTLINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xdc/std.h>
+#include "code/link.h"
+
+#define UARTLINK_BAUD		115200
+#define UARTLINK_RX_BUF		1024	// has to match uartTivaRingBuffer
+
+extern LinkPort uartLink;
+
+
+void uartlink_task(UArg arg0, UArg arg1); // opens UART0, then serves uartLink forever
+
+
+#endif /* CODE_UARTLINK_H_ */
@@ -0,0 +1,351 @@
+/*
+ * usblink.c
+ */
+
+#include "code/usblink.h"
+#include "code/link.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+static uint32_t usblink_read(void *buf, uint32_t len, uint32_t timeoutMs);
+static bool usblink_write(const void *buf, uint32_t len);
+
+LinkPort usbLink = { "usb", usblink_read, usblink_write, NULL, USBLINK_BUF_SIZE, false };
+
+
+#ifndef HOST_SIM
+
+#include "code/timebase.h"
+#include "Board.h"
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <inc/hw_memmap.h>
+#include <driverlib/sysctl.h>
+#include <usblib/usblib.h>
+#include <usblib/usb-ids.h>
+#include <usblib/device/usbdevice.h>
+#include <usblib/device/usbdbulk.h>
+
+static uint32_t usblink_rxEvent(void *cbData, uint32_t event, uint32_t msgValue, void *msgData);
+static uint32_t usblink_txEvent(void *cbData, uint32_t event, uint32_t msgValue, void *msgData);
+
+static Semaphore_Struct usbRxSem;	// posted when a packet lands in the rx ring
+static Semaphore_Struct usbTxSem;	// posted when a packet leaves the tx ring
+static volatile bool usbConnected;
+
+static uint8_t usbRxMem[USBLINK_BUF_SIZE];
+static uint8_t usbTxMem[USBLINK_BUF_SIZE];
+
+
+// string descriptors: language, manufacturer, product, serial, interface, configuration
+static const uint8_t usbLangDesc[] = { 4, USB_DTYPE_STRING, USBShort(USB_LANG_EN_US) };
+static const uint8_t usbMfrDesc[] = { 2 + 7 * 2, USB_DTYPE_STRING, 'D', 0, 'u', 0, 'e', 0, 'm', 0, 'm', 0, 'e', 0, 'r', 0 };
+static const uint8_t usbProductDesc[] = { 2 + 8 * 2, USB_DTYPE_STRING, 'l', 0, 'i', 0, 'n', 0, 'D', 0, 'e', 0, 'l', 0, 't', 0, 'a', 0 };
+static const uint8_t usbSerialDesc[] = { 2 + 2 * 2, USB_DTYPE_STRING, 'v', 0, '3', 0 };
+static const uint8_t usbIfaceDesc[] = { 2 + 4 * 2, USB_DTYPE_STRING, 'l', 0, 'i', 0, 'n', 0, 'k', 0 };
+static const uint8_t usbConfigDesc[] = { 2 + 4 * 2, USB_DTYPE_STRING, 'b', 0, 'u', 0, 'l', 0, 'k', 0 };
+
+static const uint8_t * const usbStrings[] =
+{
+	usbLangDesc,
+	usbMfrDesc,
+	usbProductDesc,
+	usbSerialDesc,
+	usbIfaceDesc,
+	usbConfigDesc
+};
+
+
+static tUSBBuffer usbRxBuf;
+static tUSBBuffer usbTxBuf;
+
+static tUSBDBulkDevice usbBulkDev =
+{
+	USB_VID_TI_1CBE,
+	USB_PID_BULK,
+	0,						// self powered
+	USB_CONF_ATTR_SELF_PWR,
+	USBBufferEventCallback,
+	(void *)&usbRxBuf,
+	USBBufferEventCallback,
+	(void *)&usbTxBuf,
+	usbStrings,
+	sizeof(usbStrings) / sizeof(usbStrings[0])
+};
+
+static tUSBBuffer usbRxBuf =
+{
+	false,					// receive
+	usblink_rxEvent,
+	(void *)&usbBulkDev,
+	USBDBulkPacketRead,
+	USBDBulkRxPacketAvailable,
+	(void *)&usbBulkDev,
+	usbRxMem,
+	USBLINK_BUF_SIZE
+};
+
+static tUSBBuffer usbTxBuf =
+{
+	true,					// transmit
+	usblink_txEvent,
+	(void *)&usbBulkDev,
+	USBDBulkPacketWrite,
+	USBDBulkTxPacketAvailable,
+	(void *)&usbBulkDev,
+	usbTxMem,
+	USBLINK_BUF_SIZE
+};
+
+
+
+
+/**
+ * Called by the rx ring from the USB interrupt. The data is already in the
+ * ring by the time this sees it
+ */
+static uint32_t usblink_rxEvent(void *cbData, uint32_t event, uint32_t msgValue, void *msgData)
+{
+	switch(event)
+	{
+	case USB_EVENT_CONNECTED:
+		USBBufferFlush(&usbRxBuf);
+		USBBufferFlush(&usbTxBuf);
+		usbConnected = true;
+		break;
+
+	case USB_EVENT_DISCONNECTED:
+		usbConnected = false;
+		Semaphore_post(Semaphore_handle(&usbTxSem)); // so a blocked writer sees it
+		break;
+
+	case USB_EVENT_RX_AVAILABLE:
+		Semaphore_post(Semaphore_handle(&usbRxSem));
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+
+
+
+static uint32_t usblink_txEvent(void *cbData, uint32_t event, uint32_t msgValue, void *msgData)
+{
+	if(event == USB_EVENT_TX_COMPLETE) { Semaphore_post(Semaphore_handle(&usbTxSem)); }
+	return 0;
+}
+
+
+
+
+/**
+ * Run from a task, once BIOS is up. The USB interrupt is the usb0_hwi_hdl Hwi
+ * in empty.cfg
+ */
+bool usblink_init()
+{
+	Semaphore_Params semParams;
+	uint32_t clk = timebase_getClk(), pll;
+
+	Semaphore_Params_init(&semParams);
+	semParams.mode = Semaphore_Mode_BINARY;
+	Semaphore_construct(&usbRxSem, 0, &semParams);
+	Semaphore_construct(&usbTxSem, 0, &semParams);
+
+	Board_initUSB(Board_USBDEVICE);
+
+	// usblib needs the CPU and USB PLL clocks on the TM4C129 parts
+	SysCtlVCOGet(SYSCTL_XTAL_25MHZ, &pll);
+	USBDCDFeatureSet(0, USBLIB_FEATURE_CPUCLK, &clk);
+	USBDCDFeatureSet(0, USBLIB_FEATURE_USBPLL, &pll);
+
+	USBBufferInit(&usbRxBuf);
+	USBBufferInit(&usbTxBuf);
+	USBStackModeSet(0, eUSBModeForceDevice, 0);
+
+	if(!USBDBulkInit(0, &usbBulkDev))
+	{
+		System_printf("usblink: couldn't start the bulk device\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+
+bool usblink_connected()
+{
+	return usbConnected;
+}
+
+
+
+
+/**
+ * The semaphore is binary, so a post that lands between the ring read and
+ * the pend still wakes the pend, and nothing is missed
+ */
+static uint32_t usblink_read(void *buf, uint32_t len, uint32_t timeoutMs)
+{
+	uint8_t *p = buf;
+	uint32_t got = 0;
+
+	while(1)
+	{
+		got += USBBufferRead(&usbRxBuf, p + got, len - got);
+		if(got == len || !Semaphore_pend(Semaphore_handle(&usbRxSem), timeoutMs)) { break; }
+	}
+
+	return got;
+}
+
+
+
+
+static bool usblink_write(const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+	uint32_t n;
+
+	while(len)
+	{
+		if(!usbConnected) { return false; }
+
+		n = USBBufferWrite(&usbTxBuf, p, len);
+		p += n;
+		len -= n;
+
+		if(len) { Semaphore_pend(Semaphore_handle(&usbTxSem), USBLINK_TX_WAIT_MS); }
+	}
+
+	return true;
+}
+
+
+
+
+void usblink_task(UArg arg0, UArg arg1)
+{
+	if(!usblink_init()) { return; }
+	link_serve(&usbLink);
+}
+
+
+#else
+
+
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <stdio.h>
+
+static int simListen = -1;
+static int simConn = -1;
+
+
+
+
+bool usblink_init()
+{
+	struct sockaddr_in addr;
+	int one = 1;
+
+	simListen = socket(AF_INET, SOCK_STREAM, 0);
+	if(simListen < 0) { return false; }
+
+	setsockopt(simListen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(USBLINK_SIM_PORT);
+
+	if(bind(simListen, (struct sockaddr *)&addr, sizeof(addr)) || listen(simListen, 1))
+	{
+		printf("usblink: couldn't listen on port %d\n", USBLINK_SIM_PORT);
+		close(simListen);
+		simListen = -1;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+bool usblink_connected()
+{
+	return simConn >= 0;
+}
+
+
+
+
+/**
+ * Waits up to timeoutMs for the socket to be readable, taking a new
+ * connection if there isn't one. A closed connection is dropped, the same
+ * as a USB disconnect
+ */
+static uint32_t usblink_read(void *buf, uint32_t len, uint32_t timeoutMs)
+{
+	struct pollfd pfd;
+	ssize_t n;
+
+	pfd.fd = simConn >= 0 ? simConn : simListen;
+	pfd.events = POLLIN;
+	if(poll(&pfd, 1, timeoutMs) <= 0) { return 0; }
+
+	if(simConn < 0)
+	{
+		simConn = accept(simListen, NULL, NULL);
+		return 0;
+	}
+
+	n = recv(simConn, buf, len, 0);
+	if(n <= 0)
+	{
+		close(simConn);
+		simConn = -1;
+		return 0;
+	}
+
+	return (uint32_t)n;
+}
+
+
+
+
+static bool usblink_write(const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while(len)
+	{
+		if(simConn < 0) { return false; }
+
+		n = send(simConn, p, len, MSG_NOSIGNAL);
+		if(n <= 0)
+		{
+			close(simConn);
+			simConn = -1;
+			return false;
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * usblink.h
+ *
+ * USB device host link. The board shows up as a vendor specific bulk device
+ * (the TivaWare bulk class), with one bulk endpoint each way, and link.h's
+ * packets run over it. Each direction goes through a USBLINK_BUF_SIZE ring,
+ * filled and drained a whole 64 byte packet at a time by usblib in the USB
+ * interrupt, so the link task only ever touches the rings. The rings hold
+ * several waypoint batches, so the host can keep writing while the link
+ * task is busy with one.
+ *
+ * Under HOST_SIM there is no USB. The same port is stood in for by a TCP
+ * socket on localhost (USBLINK_SIM_PORT), so the host tools can be pointed
+ * at a simulation exactly as they would at the board
+ */
+
+#ifndef CODE_USBLINK_H_
+#define CODE_USBLINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "code/link.h"
+
+#ifndef HOST_SIM
+#include <xdc/std.h>
+#endif
+
+#define USBLINK_BUF_SIZE	4096	// bytes in each ring
+#define USBLINK_TX_WAIT_MS	100		// longest wait for ring space before checking the connection again
+#define USBLINK_SIM_PORT	5170	// TCP port the HOST_SIM stand-in listens on
+
+extern LinkPort usbLink;
+
+
+bool usblink_init(); // brings up the USB device (or the stand-in socket). false if it couldn't
+bool usblink_connected(); // a host has the device configured
+
+#ifndef HOST_SIM
+void usblink_task(UArg arg0, UArg arg1); // initializes, then serves usbLink forever
+#endif
+
+
+#endif /* CODE_USBLINK_H_ */
@@ -8,11 +8,54 @@
 #include "code/util.h"
 #include <stdint.h>
 #include <stdbool.h>
-#include <driverlib/sysctl.h>
 
-uint64_t usecsToClockCycles(uint64_t usecs)
+// Cortex-M4 debug and trace registers, for the cycle counter
+#define DEMCR			(*((volatile uint32_t *)0xE000EDFC))
+#define DEMCR_TRCENA	0x01000000
+#define DWT_CTRL		(*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNTENA	0x00000001
+
+
+/**
+ * Starts the DWT cycle counter, which is used for profiling
+ */
+void cycleCountInit()
+{
+	DEMCR |= DEMCR_TRCENA;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CYCCNTENA;
+}
+
+
+
+/**
+ * CRC-32 (IEEE 802.3 polynomial), a nibble at a time off of a 16 entry table
+ *
+ * @param crc CRC of everything before buf, or 0 to start a new one
+ * @param buf data to add to the CRC
+ * @param len length of buf, in bytes
+ */
+uint32_t crc32(uint32_t crc, const void *buf, uint32_t len)
 {
-	return (usecs * (uint64_t)SysCtlClockGet()) / 1000000000;
+	static const uint32_t tbl[16] =
+	{
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+		0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+		0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+
+	const uint8_t *p = (const uint8_t *)buf;
+	crc = ~crc;
+
+	while(len--)
+	{
+		crc ^= *p++;
+		crc = (crc >> 4) ^ tbl[crc & 0xf];
+		crc = (crc >> 4) ^ tbl[crc & 0xf];
+	}
+
+	return ~crc;
 }
 
 
@@ -12,8 +12,39 @@
 
 #include <stdint.h>
 
-uint64_t currTime();		// returns the current system time in usecs
-uint64_t usecsToClockCycles(uint64_t usecs); // converts usecs into number of clock cycles
+
+/**
+ * Servo path placement. RAMFUNC functions and RAMDATA tables are loaded in
+ * flash and copied to SRAM at boot (the BINIT table in EK_TM4C1294XL.cmd), so
+ * they run with no flash wait states or prefetch misses. Build with
+ * SERVO_IN_FLASH to leave them in flash, for comparing against
+ */
+#if defined(HOST_SIM) || defined(SERVO_IN_FLASH)
+#define RAMFUNC
+#define RAMDATA
+#else
+#define RAMFUNC __attribute__((ramfunc))
+#define RAMDATA __attribute__((section(".ramdata")))
+#endif
+
+
+#ifndef HOST_SIM
+
+// Cortex-M4 DWT cycle counter
+#define DWT_CYCCNT		(*((volatile uint32_t *)0xE0001004))
+
+void cycleCountInit(); // starts the free running CPU cycle counter
+static inline uint32_t cycleCount() { return DWT_CYCCNT; } // reads the CPU cycle counter. Wraps every 2^32 cycles
+
+#else
+
+// there is no DWT on the host, so profiling reads the simulated clock instead
+#include "code/timebase.h"
+static inline uint32_t cycleCount() { return (uint32_t)currTimeCycles(); }
+
+#endif
+
+uint32_t crc32(uint32_t crc, const void *buf, uint32_t len); // continues a CRC-32 over buf. Start with crc = 0
 
 float mapf(float in, float inMin, float inMax, float outMin, float outMax);
 int32_t mapi(int32_t in, int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax);
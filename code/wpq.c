@@ -0,0 +1,337 @@
+/*
+ * wpq.c
+ */
+
+#include "code/wpq.h"
+#include "code/kin.h"
+#include "code/pool.h"
+#include "code/sched.h"
+#include "code/timebase.h"
+#include "code/util.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifndef HOST_SIM
+#include <xdc/std.h>
+#include <ti/sysbios/gates/GateMutex.h>
+static GateMutex_Struct wpqGate;	// submitters, one at a time. Every host link task submits
+#define WPQ_LOCK()		IArg key = GateMutex_enter(GateMutex_handle(&wpqGate))
+#define WPQ_UNLOCK()	GateMutex_leave(GateMutex_handle(&wpqGate), key)
+#else
+#define WPQ_LOCK()
+#define WPQ_UNLOCK()
+#endif
+
+#include "code/noalloc.h"
+
+static WpqBatch *wpqRing[WPQ_DEPTH];
+static volatile uint32_t wpqHead;	// next slot to submit to. Only written by the submitter
+static volatile uint32_t wpqTail;	// batch being moved through. Only written by wpq_tick()
+static uint32_t wpqDone;			// next batch to free. Only written by wpq_service()
+static volatile bool wpqFlushReq;
+
+static uint32_t wpqTickCyc;			// cycles per servo tick
+static uint16_t wpqIdx;				// waypoint being moved to, in the tail batch
+static uint32_t wpqEl;				// cycles since the last waypoint
+static float wpqFrom[4];			// last waypoint reached
+static bool wpqMore;				// the last finished batch had more to follow
+
+static WpqTarget wpqTarget;
+static WpqStats wpqStats;
+
+
+
+
+void wpq_init()
+{
+	wpqTickCyc = timebase_getClk() / SCHED_TICK_HZ;
+
+	wpqHead = 0;
+	wpqTail = 0;
+	wpqDone = 0;
+	wpqFlushReq = false;
+
+	wpqIdx = 0;
+	wpqEl = 0;
+	wpqMore = false;
+
+	memset(&wpqTarget, 0, sizeof(wpqTarget));
+	memset(&wpqStats, 0, sizeof(wpqStats));
+
+#ifndef HOST_SIM
+	GateMutex_construct(&wpqGate, NULL);
+#endif
+}
+
+
+
+
+WpqBatch *wpq_alloc()
+{
+	return pool_alloc(&poolWp);
+}
+
+
+
+void wpq_release(WpqBatch *b)
+{
+	pool_free(&poolWp, b);
+}
+
+
+
+
+/**
+ * Checks a batch over, and rewrites it in place to what the servo uses. Any
+ * waypoint that is too short or out of reach throws out the whole batch,
+ * so a batch is either queued whole or not at all
+ *
+ * @param len bytes of the batch actually received
+ */
+static bool wpq_convert(WpqBatch *b, uint32_t len)
+{
+	uint16_t i;
+
+	if(len < WPQ_HDR_SIZE || b->magic != WPQ_MAGIC) { return false; }
+	if(!b->n || b->n > WPQ_BATCH_PTS) { return false; }
+	if(len < WPQ_HDR_SIZE + b->n * sizeof(WpqPoint)) { return false; }
+
+	for(i = 0; i < b->n; i++)
+	{
+		WpqPoint *pt = &b->pt[i];
+		ToolPos tp = { pt->p[0], pt->p[1], pt->p[2], pt->p[3] };
+
+		// the very first waypoint is just the starting point, so it has no length
+		pt->dur = timebase_usToCycles(pt->dur);
+		if(pt->dur < wpqTickCyc && (i || wpqStats.batches)) { return false; }
+
+		if(!kin_inverse(&tp, pt->p)) { return false; } // leaves e where it is
+	}
+
+	return true;
+}
+
+
+
+
+/**
+ * Queues a batch. The caller holds wpqGate
+ */
+static bool wpq_submitLocked(WpqBatch *b, uint32_t len)
+{
+	uint32_t head = wpqHead;
+
+	if(head - wpqDone >= WPQ_DEPTH)
+	{
+		wpqStats.full++;
+		wpq_release(b);
+		return false;
+	}
+
+	if(!wpq_convert(b, len))
+	{
+		wpqStats.rejects++;
+		wpq_release(b);
+		return false;
+	}
+
+	wpqRing[head & (WPQ_DEPTH - 1)] = b;
+	wpqStats.batches++;
+	wpqStats.points += b->n;
+
+	wpqHead = head + 1; // publishes it to the servo
+	return true;
+}
+
+
+
+
+/**
+ * @param b block from wpq_alloc(), holding the batch as received. It belongs
+ * to the queue after this, and is freed once it has been moved through (or
+ * right away if it is refused)
+ *
+ * @return false if the batch was malformed, out of reach, or the queue is full
+ */
+bool wpq_submit(WpqBatch *b, uint32_t len)
+{
+	WPQ_LOCK();
+	bool ok = wpq_submitLocked(b, len);
+	WPQ_UNLOCK();
+
+	return ok;
+}
+
+
+
+
+/**
+ * Copies a batch into a queue block first, for links that can't receive
+ * straight into one. The caller keeps its buffer
+ */
+bool wpq_submitCopy(const void *data, uint32_t len)
+{
+	bool ok = false;
+	WPQ_LOCK();
+
+	WpqBatch *b = wpq_alloc();
+	if(!b)
+	{
+		wpqStats.full++;
+	} else
+	{
+		if(len > sizeof(WpqBatch)) { len = sizeof(WpqBatch); }
+		memcpy(b, data, len);
+		wpqStats.copies++;
+
+		ok = wpq_submitLocked(b, len);
+	}
+
+	WPQ_UNLOCK();
+	return ok;
+}
+
+
+
+
+void wpq_flush()
+{
+	wpqFlushReq = true;
+}
+
+
+
+
+/**
+ * Moves to the next waypoint, and on to the next batch at the end of one
+ */
+RAMFUNC static void wpq_nextPoint(const WpqBatch *b)
+{
+	if(++wpqIdx < b->n) { return; }
+
+	wpqMore = b->flags & WPQ_FLAG_MORE;
+	wpqIdx = 0;
+	wpqTail++;
+}
+
+
+
+
+/**
+ * Every waypoint is at least a tick long, so this passes at most one and a
+ * bit per tick, and the time spent doesn't depend on the queue depth
+ */
+RAMFUNC void wpq_tick()
+{
+	const WpqBatch *b;
+	const WpqPoint *pt;
+	float frac;
+	uint8_t i;
+
+	if(wpqFlushReq)
+	{
+		// stop where the target is now, not back at the last waypoint reached
+		for(i = 0; i < 3; i++) { wpqFrom[i] = wpqTarget.c[i]; }
+		wpqFrom[3] = wpqTarget.e;
+
+		wpqTail = wpqHead;
+		wpqIdx = 0;
+		wpqMore = false;
+		wpqTarget.active = false;
+		wpqFlushReq = false;
+		return;
+	}
+
+	wpqEl = wpqTarget.active ? wpqEl + wpqTickCyc : 0;
+
+	for(;;)
+	{
+		if(wpqTail == wpqHead)
+		{
+			if(wpqTarget.active && wpqMore) { wpqStats.underruns++; }
+
+			for(i = 0; i < 3; i++) { wpqTarget.c[i] = wpqFrom[i]; }
+			wpqTarget.e = wpqFrom[3];
+			wpqTarget.active = false;
+			return;
+		}
+
+		b = wpqRing[wpqTail & (WPQ_DEPTH - 1)];
+		pt = &b->pt[wpqIdx];
+
+		if(!wpqTarget.valid)
+		{
+			memcpy(wpqFrom, pt->p, sizeof(wpqFrom));
+			wpqTarget.valid = true;
+			wpq_nextPoint(b);
+			continue;
+		}
+
+		wpqTarget.active = true;
+		if(wpqEl < pt->dur) { break; }
+
+		wpqEl -= pt->dur;
+		memcpy(wpqFrom, pt->p, sizeof(wpqFrom));
+		wpq_nextPoint(b);
+	}
+
+	frac = (float)wpqEl / pt->dur;
+
+	for(i = 0; i < 3; i++) { wpqTarget.c[i] = wpqFrom[i] + (pt->p[i] - wpqFrom[i]) * frac; }
+	wpqTarget.e = wpqFrom[3] + (pt->p[3] - wpqFrom[3]) * frac;
+}
+
+
+
+
+/**
+ * Hands the blocks of batches the servo has finished with back to the pool.
+ * Kept out of wpq_tick() so the servo never touches the pool lock
+ */
+void wpq_service()
+{
+	uint32_t tail = wpqTail;
+
+	while(wpqDone != tail)
+	{
+		pool_free(&poolWp, wpqRing[wpqDone & (WPQ_DEPTH - 1)]);
+		wpqDone++;
+	}
+}
+
+
+
+
+RAMFUNC const WpqTarget *wpq_getTarget()
+{
+	return &wpqTarget;
+}
+
+
+
+uint32_t wpq_getQueued()
+{
+	return wpqHead - wpqTail;
+}
+
+
+
+uint32_t wpq_getFree()
+{
+	return poolWp.numBlks - poolWp.used;
+}
+
+
+
+uint32_t wpq_getTaken()
+{
+	return wpqStats.batches + wpqStats.rejects + wpqStats.full;
+}
+
+
+
+const WpqStats *wpq_getStats()
+{
+	return &wpqStats;
+}
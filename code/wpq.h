@@ -0,0 +1,110 @@
+/*
+ * wpq.h
+ *
+ * Waypoint queue, for trajectories planned off the board (eg. by a CAM
+ * process) that are already time parameterized. They skip the G-code planner
+ * and the slicing in kin.h, and the servo interpolates straight between the
+ * waypoints.
+ *
+ * Waypoints come in batches, in the same binary layout on the wire as in the
+ * queue. A link that receives straight into a block from wpq_alloc() hands
+ * the block itself to wpq_submit(), and nothing is copied. Anything else
+ * (an unaligned or borrowed buffer) goes through wpq_submitCopy(). Either way
+ * the batch is checked and converted in place when it is submitted, from the
+ * tool position to carriage heights and from usecs to clock cycles, so the
+ * servo only ever does a linear interpolation. Like the kin.h slices, the
+ * carriages move linearly between waypoints, so the waypoints have to be
+ * about as dense as the slices would have been.
+ *
+ * Each waypoint is reached dur usecs after the one before it, which has to be
+ * at least one servo tick. The very first waypoint after wpq_init() is taken
+ * as where the machine already is, and its dur is ignored. After that, the
+ * first one after the queue has run dry is moved to from wherever the target
+ * was left sitting. Running dry with a batch that asked for more to follow
+ * counts an underrun.
+ *
+ * Batches can be submitted from any task. Submitters take turns on a
+ * GateMutex, but the servo only moves its own read index, and finished blocks
+ * are freed later by the planner group, so the servo never waits on a
+ * submitter or the other way around
+ */
+
+#ifndef CODE_WPQ_H_
+#define CODE_WPQ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WPQ_MAGIC		0x31515057	// "WPQ1", little endian
+#define WPQ_BATCH_PTS	50			// most waypoints in one batch. Keeps a batch in 1KB
+#define WPQ_DEPTH		32			// batches that can be queued. Must be a power of 2
+
+// batch flags
+#define WPQ_FLAG_MORE	0x0001		// more batches follow, so running dry after this one is an underrun
+
+
+/**
+ * A waypoint. On the wire dur is in usecs and p is the tool position
+ * (x, y, z, e). wpq_submit() rewrites it to clock cycles and carriage heights
+ * (A, B, C, e)
+ */
+typedef struct WpqPoint
+{
+	uint32_t dur;	// time since the last waypoint
+	float p[4];
+} WpqPoint;
+
+
+typedef struct WpqBatch
+{
+	uint32_t magic;		// WPQ_MAGIC
+	uint16_t n;			// number of waypoints
+	uint16_t flags;		// WPQ_FLAG_xxx
+	WpqPoint pt[WPQ_BATCH_PTS];
+} WpqBatch;
+
+#define WPQ_HDR_SIZE	8	// bytes before the first waypoint
+
+
+/**
+ * Where the servo should be right now
+ */
+typedef struct WpqTarget
+{
+	float c[3];		// carriage A, B and C heights
+	float e;		// extruder position
+	bool valid;		// there has been a first waypoint
+	bool active;	// a waypoint is being moved to. Holding still otherwise
+} WpqTarget;
+
+
+typedef struct WpqStats
+{
+	uint32_t batches;	// batches queued
+	uint32_t points;	// waypoints queued
+	uint32_t copies;	// batches that went through wpq_submitCopy()
+	uint32_t rejects;	// batches refused as malformed or out of reach
+	uint32_t full;		// batches refused because the queue was full
+	uint32_t underruns;	// times the queue ran dry with more expected
+} WpqStats;
+
+
+void wpq_init(); // empties the queue. Run once the clock is set, before the servo starts
+WpqBatch *wpq_alloc(); // block to receive a batch into. NULL if there are none free
+void wpq_release(WpqBatch *b); // hands back a block that won't be submitted
+
+bool wpq_submit(WpqBatch *b, uint32_t len); // checks, converts and queues a batch, without copying. Takes the block either way
+bool wpq_submitCopy(const void *data, uint32_t len); // same, for a batch in any other buffer
+void wpq_flush(); // drops everything queued at the next tick, and holds the target where it is
+
+void wpq_tick(); // moves the target along. Run in the servo group, after enc_latch()
+void wpq_service(); // frees finished batches. Run from the planner group
+const WpqTarget *wpq_getTarget(); // target as of this tick. Only consistent from the servo group
+
+uint32_t wpq_getQueued(); // batches waiting or in progress
+uint32_t wpq_getFree(); // blocks free for more batches
+uint32_t wpq_getTaken(); // batches handed to wpq_submit() or wpq_submitCopy(), whether or not they were queued
+const WpqStats *wpq_getStats();
+
+
+#endif /* CODE_WPQ_H_ */
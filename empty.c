@@ -61,13 +61,49 @@
 /* Board Header file */
 #include "Board.h"
 #include "code/hwIO.h"
+#include "code/tune.h"
+#include "code/boot.h"
+#include "code/enc.h"
+#include "code/sched.h"
+#include "code/mon.h"
+#include "code/stepper.h"
+#include "code/wpq.h"
+#include "code/usblink.h"
+#include "code/tcplink.h"
+#include "code/uartlink.h"
+#include "code/job.h"
 #include "driverlib/sysctl.h"
 
 #define TASKSTACKSIZE   2048
 
+#define UARTSTACKSIZE   1536
+#define BOOTSTACKSIZE   2048
+#define USBSTACKSIZE    1536
+#define TCPSTACKSIZE    1536
+#define JOBSTACKSIZE    1536
+#define PLAYSTACKSIZE   1024
+
 Task_Struct task0Struct;
 Char task0Stack[TASKSTACKSIZE];
 
+Task_Struct uartTaskStruct;
+Char uartTaskStack[UARTSTACKSIZE];
+
+Task_Struct bootTaskStruct;
+Char bootTaskStack[BOOTSTACKSIZE];
+
+Task_Struct usbTaskStruct;
+Char usbTaskStack[USBSTACKSIZE];
+
+Task_Struct tcpTaskStruct;
+Char tcpTaskStack[TCPSTACKSIZE];
+
+Task_Struct jobTaskStruct;
+Char jobTaskStack[JOBSTACKSIZE];
+
+Task_Struct playTaskStruct;
+Char playTaskStack[PLAYSTACKSIZE];
+
 /*
  *  ======== heartBeatFxn ========
  *  Toggle the Board_LED0. The Task_sleep is determined by arg0 which
@@ -89,8 +125,10 @@ Void heartBeatFxn(UArg arg0, UArg arg1)
 //        System_printf("thermo: %d \n", (int)getThermoTemp(true));
 //        System_flush();
 
-    	getThermoTemp(true);
-
+    	// periodic work goes in the rate groups, see main(). The heap has a
+    	// GateMutex, so it gets read here rather than in housekeeping
+    	mon_pollHeap();
+    	Task_sleep((UInt)arg0);
     }
 }
 
@@ -105,13 +143,81 @@ int main(void)
 
 	setMotorsEnabled(true);
 
+	wpq_init();
+	job_init();
+
+	/* Periodic work. Each job is one line here, in the group for its rate */
+	sched_init();
+	sched_add(SCHED_SERVO, enc_latch);		// has to be first, so the rest of the tick sees one state
+	sched_add(SCHED_SERVO, tune_tick);
+	sched_add(SCHED_SERVO, wpq_tick);
+	sched_add(SCHED_PLANNER, stepper_refill);
+	sched_add(SCHED_PLANNER, wpq_service);
+	sched_add(SCHED_THERMAL, hwIO_pollThermo);
+	sched_add(SCHED_HOUSE, enc_service);
+	sched_add(SCHED_HOUSE, mon_service);
+	sched_start();
+
     /* Construct heartBeat Task  thread */
     Task_Params_init(&taskParams);
     taskParams.arg0 = 1000;
     taskParams.stackSize = TASKSTACKSIZE;
     taskParams.stack = &task0Stack;
+    taskParams.instance->name = "heartbeat";
     Task_construct(&task0Struct, (Task_FuncPtr)heartBeatFxn, &taskParams, NULL);
 
+    /* Construct the UART host link Task, which also takes tuning commands
+     * from a terminal. Above the heartBeat, which never blocks */
+    Task_Params_init(&taskParams);
+    taskParams.stackSize = UARTSTACKSIZE;
+    taskParams.stack = &uartTaskStack;
+    taskParams.instance->name = "uartlink";
+    taskParams.priority = 2;
+    Task_construct(&uartTaskStruct, (Task_FuncPtr)uartlink_task, &taskParams, NULL);
+
+    /* Construct the USB host link Task. Same level as the UART one */
+    Task_Params_init(&taskParams);
+    taskParams.stackSize = USBSTACKSIZE;
+    taskParams.stack = &usbTaskStack;
+    taskParams.instance->name = "usblink";
+    taskParams.priority = 2;
+    Task_construct(&usbTaskStruct, (Task_FuncPtr)usblink_task, &taskParams, NULL);
+
+    /* Construct the TCP host link Task. It waits for the NDK by itself */
+    Task_Params_init(&taskParams);
+    taskParams.stackSize = TCPSTACKSIZE;
+    taskParams.stack = &tcpTaskStack;
+    taskParams.instance->name = "tcplink";
+    taskParams.priority = 2;
+    Task_construct(&tcpTaskStruct, (Task_FuncPtr)tcplink_task, &taskParams, NULL);
+
+    /* Construct the job file read-ahead Task. The SD driver polls the SPI
+     * port, so it goes below the links, level with the heartBeat */
+    Task_Params_init(&taskParams);
+    taskParams.stackSize = JOBSTACKSIZE;
+    taskParams.stack = &jobTaskStack;
+    taskParams.instance->name = "job";
+    taskParams.priority = 1;
+    Task_construct(&jobTaskStruct, (Task_FuncPtr)job_task, &taskParams, NULL);
+
+    /* Construct the waypoint job player Task. It feeds the queue the same way
+     * the links do, so it goes at their level, above the reader */
+    Task_Params_init(&taskParams);
+    taskParams.stackSize = PLAYSTACKSIZE;
+    taskParams.stack = &playTaskStack;
+    taskParams.instance->name = "jobplay";
+    taskParams.priority = 2;
+    Task_construct(&playTaskStruct, (Task_FuncPtr)job_playTask, &taskParams, NULL);
+
+    /* Construct the background init Task. Above the NDK stack thread (5), so
+     * the ethernet driver is up before it runs */
+    Task_Params_init(&taskParams);
+    taskParams.stackSize = BOOTSTACKSIZE;
+    taskParams.stack = &bootTaskStack;
+    taskParams.instance->name = "boot";
+    taskParams.priority = 6;
+    Task_construct(&bootTaskStruct, (Task_FuncPtr)boot_lateTask, &taskParams, NULL);
+
      /* Turn on some status LEDs */
     setStatusLEDs(false, false, false);
     setStatusLEDs(false, false, true);
@@ -0,0 +1,181 @@
+/*
+ * bench_arc.c
+ *
+ * Host benchmark for the arc and spline segmentation in code/arc.c. Reports
+ * how many segments per millisecond each generator puts out, and the worst
+ * chord error seen, over a range of tolerances. Exits nonzero if an arc or
+ * spline strays further than its tolerance
+ */
+
+#include "code/arc.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#define BENCH_REPS 2000
+#define SPLINE_SAMPLES 16	// points checked along each spline segment
+
+
+static double nowMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+
+/**
+ * Worst distance from a chord midpoint to the circle. Done in double so the
+ * measurement doesn't add float rounding of its own to what's being measured
+ */
+static double arcErr(const ArcGen *g, const ToolPos *a, const ToolPos *b)
+{
+	double mx = ((double)a->x + b->x) / 2 - g->cx;
+	double my = ((double)a->y + b->y) / 2 - g->cy;
+	return fabs(g->r - sqrt(mx*mx + my*my));
+}
+
+
+
+static bool benchArc(float tol)
+{
+	ToolPos start = { .x = 2, .y = 0, .z = 0, .e = 0 };
+	ToolPos end = start; // full circle, r = 2in
+	end.z = 0.5f;
+	end.e = 10;
+
+	ArcGen g;
+	ToolPos prev, p;
+	uint64_t segs = 0;
+	double maxErr = 0;
+	volatile float sink = 0;
+	int r;
+
+	// error check pass
+	arc_init(&g, &start, &end, -2, 0, false, tol);
+	prev = start;
+	while(arc_next(&g, &p))
+	{
+		double err = arcErr(&g, &prev, &p);
+		if(err > maxErr) { maxErr = err; }
+		prev = p;
+	}
+
+	// timed pass
+	double t0 = nowMs();
+	for(r = 0; r < BENCH_REPS; r++)
+	{
+		arc_init(&g, &start, &end, -2, 0, r & 1, tol);
+		while(arc_next(&g, &p)) { sink += p.x; segs++; }
+	}
+	double dt = nowMs() - t0;
+
+	printf("arc     tol %.5f  %6u segs/arc  %10.0f segs/ms  max err %.6f%s\n",
+			tol, g.n, segs / dt, maxErr, maxErr > tol ? "  OVER TOL" : "");
+	return maxErr <= tol;
+}
+
+
+
+/**
+ * Distance from a point to the chord between a and b, in double for the same
+ * reason as arcErr()
+ */
+static double chordDist(double x, double y, const ToolPos *a, const ToolPos *b)
+{
+	double dx = (double)b->x - a->x, dy = (double)b->y - a->y;
+	double len2 = dx*dx + dy*dy;
+	double u = len2 > 0 ? ((x - a->x)*dx + (y - a->y)*dy) / len2 : 0;
+
+	if(u < 0) { u = 0; }
+	if(u > 1) { u = 1; }
+
+	double ex = a->x + u*dx - x, ey = a->y + u*dy - y;
+	return sqrt(ex*ex + ey*ey);
+}
+
+
+
+/**
+ * Worst distance from the exact bezier to the chord of segment k of n. The
+ * curve is evaluated directly, so drift in the forward differencing shows up
+ * as error too
+ */
+static double splineErr(const double *cx, const double *cy, uint32_t k, uint32_t n, const ToolPos *a, const ToolPos *b)
+{
+	double maxErr = 0;
+	int s;
+
+	for(s = 0; s <= SPLINE_SAMPLES; s++)
+	{
+		double t = (k + (double)s / SPLINE_SAMPLES) / n, u = 1 - t;
+		double w0 = u*u*u, w1 = 3*u*u*t, w2 = 3*u*t*t, w3 = t*t*t;
+		double x = w0*cx[0] + w1*cx[1] + w2*cx[2] + w3*cx[3];
+		double y = w0*cy[0] + w1*cy[1] + w2*cy[2] + w3*cy[3];
+		double err = chordDist(x, y, a, b);
+		if(err > maxErr) { maxErr = err; }
+	}
+
+	return maxErr;
+}
+
+
+
+static bool benchSpline(float tol)
+{
+	ToolPos start = { .x = 0, .y = 0, .z = 0, .e = 0 };
+	ToolPos end = { .x = 4, .y = 0, .z = 0.1f, .e = 5 };
+	float i = 1, j = 3, p = -1, q = -3;
+
+	// control points, as spline_init() takes them
+	double cx[4] = { start.x, start.x + i, end.x + p, end.x };
+	double cy[4] = { start.y, start.y + j, end.y + q, end.y };
+
+	SplineGen g;
+	ToolPos prev, pt;
+	uint64_t segs = 0;
+	uint32_t k = 0;
+	double maxErr = 0;
+	volatile float sink = 0;
+	int r;
+
+	// error check pass
+	spline_init(&g, &start, &end, i, j, p, q, tol);
+	prev = start;
+	while(spline_next(&g, &pt))
+	{
+		double err = splineErr(cx, cy, k++, g.n, &prev, &pt);
+		if(err > maxErr) { maxErr = err; }
+		prev = pt;
+	}
+
+	// timed pass
+	double t0 = nowMs();
+	for(r = 0; r < BENCH_REPS; r++)
+	{
+		spline_init(&g, &start, &end, i, j, p, q, tol);
+		while(spline_next(&g, &pt)) { sink += pt.x; segs++; }
+	}
+	double dt = nowMs() - t0;
+
+	printf("spline  tol %.5f  %6u segs/crv  %10.0f segs/ms  max err %.6f%s\n",
+			tol, g.n, segs / dt, maxErr, maxErr > tol ? "  OVER TOL" : "");
+	return maxErr <= tol;
+}
+
+
+
+int main()
+{
+	float tols[] = { 0.001f, 0.0002f, 0.00004f };
+	bool ok = true;
+	int i;
+
+	for(i = 0; i < 3; i++) { ok &= benchArc(tols[i]); }
+	for(i = 0; i < 3; i++) { ok &= benchSpline(tols[i]); }
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+/*
+ * bench_kin.c
+ *
+ * Host benchmark for the move slicing in code/kin.c. A set of representative
+ * moves is sliced through kin_initMove() / kin_next(), and the time per slice
+ * is turned into the densest slice rate that fits a CPU budget. Each move is
+ * also checked: the slice lengths have to add up to the move exactly, and the
+ * last slice has to land on the carriage heights of the end point. Exits
+ * nonzero if one doesn't.
+ *
+ * Cycles are host cycles (the x86 time stamp counter), so they only give the
+ * scale of the work. Read the target's own numbers with the kin command
+ * (tune.h)
+ */
+
+#include "code/kin.h"
+#include "code/dat.h"
+#include "code/timebase.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BENCH_CLK		120000000	// target clock, for the move durations
+#define BENCH_REPS		200
+#define BENCH_BUDGET	0.25f	// fraction of the CPU slicing may use
+#define BENCH_RADIUS	6		// tower distance from the center (in)
+#define BENCH_ROD		9		// rod length (in)
+#define BENCH_END_TOL	1e-4f	// carriage height error allowed on the last slice (in)
+
+
+typedef struct BenchMove
+{
+	const char *name;
+	ToolPos start;
+	ToolPos end;
+	float feed;		// in / sec
+} BenchMove;
+
+
+static const BenchMove benchMoves[] =
+{
+	{ "short xy",	{ 0, 0, 2, 0 },		{ 0.2f, 0.1f, 2, 0.01f },	2 },
+	{ "long diag",	{ -2, -2, 1, 0 },	{ 2, 2, 3, 1 },				4 },
+	{ "edge arc",	{ 3, 0, 1, 0 },		{ -1.5f, 2.5f, 1, 0.5f },	3 },
+	{ "z only",		{ 0, 0, 0.5f, 0 },	{ 0, 0, 5, 0 },				1 },
+	{ "extrude",	{ 1, 1, 2, 0 },		{ 1, 1, 2, 0.2f },			0.5f }
+};
+
+#define BENCH_NUM_MOVES (sizeof(benchMoves) / sizeof(benchMoves[0]))
+
+
+static double nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+
+/**
+ * Host cycle count, or 0 where there is no counter to read
+ */
+static uint64_t nowCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+
+
+/**
+ * Puts the towers 120 degrees apart, since the defaults in dat.c aren't a
+ * real machine
+ */
+static void benchGeometry()
+{
+	AxisDat *ax[3] = { &axisADat, &axisBDat, &axisCDat };
+	int i;
+
+	for(i = 0; i < 3; i++)
+	{
+		float a = (float)M_PI / 2 + i * 2 * (float)M_PI / 3;
+		ax[i]->axisX = BENCH_RADIUS * cosf(a);
+		ax[i]->axisY = BENCH_RADIUS * sinf(a);
+		ax[i]->rodLen = BENCH_ROD;
+	}
+}
+
+
+
+/**
+ * Slices a move once and checks it
+ */
+static bool benchCheck(const BenchMove *m)
+{
+	KinGen g;
+	CarrSeg s;
+	float endCarr[3];
+	uint64_t sum = 0;
+	uint32_t n = 0;
+	int i;
+
+	kin_initMove(&g, &m->start, &m->end, m->feed);
+	while(kin_next(&g, &s)) { sum += s.dur; n++; }
+
+	if(g.err || n != g.n || sum != g.totDur || !kin_inverse(&m->end, endCarr)) { return false; }
+	for(i = 0; i < 3; i++) { if(fabsf(s.c[i] - endCarr[i]) > BENCH_END_TOL) { return false; } }
+
+	return true;
+}
+
+
+
+/**
+ * @param worstCyc raised to the worst host cycles per slice over the moves
+ *
+ * @return worst ns per slice over the moves, or 0 if a move failed its check
+ */
+static double benchRate(float rate, double *worstCyc)
+{
+	double worst = 0;
+	bool ok = true;
+	uint32_t m;
+	int r;
+
+	kin_segRate = rate;
+	printf("kin.segRate %5.0f\n", rate);
+
+	for(m = 0; m < BENCH_NUM_MOVES; m++)
+	{
+		const BenchMove *mv = &benchMoves[m];
+		volatile float sink = 0;
+		uint64_t slices = 0;
+		KinGen g;
+		CarrSeg s;
+
+		bool good = benchCheck(mv);
+		ok &= good;
+
+		uint64_t c0 = nowCycles();
+		double t0 = nowNs();
+		for(r = 0; r < BENCH_REPS; r++)
+		{
+			kin_initMove(&g, &mv->start, &mv->end, mv->feed);
+			while(kin_next(&g, &s)) { sink += s.c[0]; slices++; }
+		}
+		double ns = (nowNs() - t0) / slices;
+		double cyc = (double)(nowCycles() - c0) / slices;
+		if(ns > worst) { worst = ns; }
+		if(cyc > *worstCyc) { *worstCyc = cyc; }
+
+		printf("  %-10s %6u slices  %7.1f ns/slice  %6.0f cyc/slice%s\n", mv->name, g.n, ns, cyc,
+				good ? "" : "  BAD SLICES");
+	}
+
+	return ok ? worst : 0;
+}
+
+
+
+int main()
+{
+	float rates[] = { 200, 1000, 5000 };
+	double worst = 0, worstCyc = 0, ns;
+	bool ok = true;
+	int i;
+
+	timebase_init(BENCH_CLK);
+	benchGeometry();
+
+	for(i = 0; i < 3; i++)
+	{
+		ns = benchRate(rates[i], &worstCyc);
+		ok &= ns > 0;
+		if(ns > worst) { worst = ns; }
+	}
+
+	printf("worst %.1f ns/slice (%.0f cyc), sustainable %.0f slices/s at %.0f%% of the host CPU\n", worst,
+			worstCyc, BENCH_BUDGET * 1e9 / worst, BENCH_BUDGET * 100);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,563 @@
+/*
+ * linkclient.cpp
+ */
+
+#include "linkclient.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/usbdevice_fs.h>
+
+#define USB_EP_OUT		0x01	// usblib bulk class endpoints
+#define USB_EP_IN		0x81
+#define USB_PKT_MAX		64
+#define USB_IFACE		0
+
+#define CREDIT_WAIT_MS	1000	// longest wait for a credit, before the link is taken as dead
+
+
+static double nowSecs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Transports ///////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+TcpTransport::TcpTransport() : fd(-1) {}
+
+TcpTransport::~TcpTransport()
+{
+	if(fd >= 0) { close(fd); }
+}
+
+
+
+bool TcpTransport::open(const std::string &host, uint16_t port)
+{
+	struct addrinfo hints, *res, *ai;
+	char portStr[8];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(portStr, sizeof(portStr), "%u", port);
+
+	if(getaddrinfo(host.c_str(), portStr, &hints, &res)) { return false; }
+
+	for(ai = res; ai; ai = ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if(fd < 0) { continue; }
+		if(!connect(fd, ai->ai_addr, ai->ai_addrlen)) { break; }
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+	if(fd < 0) { return false; }
+
+	// small command packets shouldn't sit waiting to be coalesced
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return true;
+}
+
+
+
+size_t TcpTransport::read(void *buf, size_t len, int timeoutMs)
+{
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	if(poll(&pfd, 1, timeoutMs) <= 0) { return 0; }
+
+	ssize_t n = recv(fd, buf, len, 0);
+	return n > 0 ? n : 0;
+}
+
+
+
+bool TcpTransport::write(const void *buf, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)buf;
+
+	while(len)
+	{
+		ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+		if(n <= 0) { return false; }
+
+		p += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+
+
+
+UsbTransport::UsbTransport() : fd(-1), rxPos(0) {}
+
+UsbTransport::~UsbTransport()
+{
+	if(fd < 0) { return; }
+
+	unsigned int iface = USB_IFACE;
+	ioctl(fd, USBDEVFS_RELEASEINTERFACE, &iface);
+	close(fd);
+}
+
+
+
+/**
+ * Reads a hex id out of a sysfs attribute file
+ */
+static unsigned readSysHex(const std::string &path)
+{
+	unsigned v = 0;
+	FILE *f = fopen(path.c_str(), "r");
+	if(!f) { return 0; }
+
+	if(fscanf(f, "%x", &v) != 1) { v = 0; }
+	fclose(f);
+	return v;
+}
+
+
+
+static unsigned readSysDec(const std::string &path)
+{
+	unsigned v = 0;
+	FILE *f = fopen(path.c_str(), "r");
+	if(!f) { return 0; }
+
+	if(fscanf(f, "%u", &v) != 1) { v = 0; }
+	fclose(f);
+	return v;
+}
+
+
+
+/**
+ * Finds the device in sysfs, then opens its usbfs node and claims the bulk
+ * interface away from any kernel driver
+ */
+bool UsbTransport::open(uint16_t vid, uint16_t pid)
+{
+	const std::string sys = "/sys/bus/usb/devices/";
+	DIR *d = opendir(sys.c_str());
+	struct dirent *e;
+	char node[64] = "";
+
+	if(!d) { return false; }
+
+	while((e = readdir(d)))
+	{
+		std::string dev = sys + e->d_name + "/";
+		if(readSysHex(dev + "idVendor") != vid || readSysHex(dev + "idProduct") != pid) { continue; }
+
+		snprintf(node, sizeof(node), "/dev/bus/usb/%03u/%03u", readSysDec(dev + "busnum"), readSysDec(dev + "devnum"));
+		break;
+	}
+
+	closedir(d);
+	if(!node[0]) { return false; }
+
+	fd = ::open(node, O_RDWR);
+	if(fd < 0) { return false; }
+
+	struct usbdevfs_ioctl disc = { USB_IFACE, USBDEVFS_DISCONNECT, NULL };
+	ioctl(fd, USBDEVFS_IOCTL, &disc); // fails harmlessly if no driver has it
+
+	unsigned int iface = USB_IFACE;
+	if(ioctl(fd, USBDEVFS_CLAIMINTERFACE, &iface) < 0)
+	{
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Bulk reads always ask for a whole packet, so none is ever split. What
+ * doesn't fit in buf is kept for the next read
+ */
+size_t UsbTransport::read(void *buf, size_t len, int timeoutMs)
+{
+	if(rxPos >= rxBuf.size())
+	{
+		uint8_t pkt[USB_PKT_MAX * 8];
+		struct usbdevfs_bulktransfer bt = { USB_EP_IN, sizeof(pkt), (unsigned)timeoutMs, pkt };
+
+		int n = ioctl(fd, USBDEVFS_BULK, &bt);
+		if(n <= 0) { return 0; }
+
+		rxBuf.assign(pkt, pkt + n);
+		rxPos = 0;
+	}
+
+	size_t n = rxBuf.size() - rxPos;
+	if(n > len) { n = len; }
+
+	memcpy(buf, &rxBuf[rxPos], n);
+	rxPos += n;
+	return n;
+}
+
+
+
+bool UsbTransport::write(const void *buf, size_t len)
+{
+	struct usbdevfs_bulktransfer bt = { USB_EP_OUT, (unsigned)len, 1000, (void *)buf };
+	return ioctl(fd, USBDEVFS_BULK, &bt) == (int)len;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Client ///////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+LinkClient::LinkClient(Transport &t) : t(t), telemSeen(false), synced(false), syncing(false),
+		bytesSent(0), segsSent(0), respSeen(false)
+{
+	memset(&telem, 0, sizeof(telem));
+	memset(&credit, 0, sizeof(credit));
+}
+
+
+
+bool LinkClient::send(uint8_t type, const void *payload, uint16_t len)
+{
+	uint8_t pkt[LINK_HDR_SIZE + LINK_MAX_PAYLOAD] = { LINK_SYNC, type, (uint8_t)(len & 0xff), (uint8_t)(len >> 8) };
+
+	// one write per packet, so a USB packet never holds two halves
+	memcpy(pkt + LINK_HDR_SIZE, payload, len);
+	bytesSent += LINK_HDR_SIZE + len;
+	if(type == LINK_PKT_WPQ) { segsSent++; }
+
+	return t.write(pkt, LINK_HDR_SIZE + len);
+}
+
+
+
+/**
+ * Pulls one whole packet out of the stream, if one has come in within the
+ * timeout. Anything before a sync byte is dropped
+ */
+bool LinkClient::readPkt(uint8_t &type, std::vector<uint8_t> &payload, int timeoutMs)
+{
+	uint8_t buf[4096];
+	double end = nowSecs() + timeoutMs / 1e3;
+
+	while(1)
+	{
+		while(!rx.empty() && rx[0] != LINK_SYNC) { rx.erase(rx.begin()); }
+
+		if(rx.size() >= LINK_HDR_SIZE)
+		{
+			size_t len = rx[2] | (rx[3] << 8);
+			if(rx.size() >= LINK_HDR_SIZE + len)
+			{
+				type = rx[1];
+				payload.assign(rx.begin() + LINK_HDR_SIZE, rx.begin() + LINK_HDR_SIZE + len);
+				rx.erase(rx.begin(), rx.begin() + LINK_HDR_SIZE + len);
+				return true;
+			}
+		}
+
+		int left = (int)((end - nowSecs()) * 1e3);
+		if(left < 0) { return false; }
+
+		size_t n = t.read(buf, sizeof(buf), left);
+		rx.insert(rx.end(), buf, buf + n);
+	}
+}
+
+
+
+void LinkClient::handle(uint8_t type, const std::vector<uint8_t> &payload)
+{
+	switch(type)
+	{
+	case LINK_PKT_RESP:
+		resp.assign(payload.begin(), payload.end());
+		respSeen = true;
+		break;
+
+	case LINK_PKT_TELEM:
+		if(payload.size() < sizeof(LinkTelem)) { break; }
+
+		memcpy(&telem, &payload[0], sizeof(telem));
+		telemSeen = true;
+		break;
+
+	case LINK_PKT_CREDIT:
+		if(payload.size() < sizeof(LinkCredit)) { break; }
+
+		memcpy(&credit, &payload[0], sizeof(credit));
+
+		// the first credit after the "link credit" resp has everything sent so far in it
+		if(syncing && respSeen)
+		{
+			bytesSent = credit.bytesTaken;
+			segsSent = credit.segsTaken;
+			syncing = false;
+			synced = true;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+
+void LinkClient::poll(int timeoutMs)
+{
+	uint8_t type;
+	std::vector<uint8_t> payload;
+
+	if(!readPkt(type, payload, timeoutMs)) { return; }
+	handle(type, payload);
+
+	// then whatever else is already waiting
+	while(readPkt(type, payload, 0)) { handle(type, payload); }
+}
+
+
+
+bool LinkClient::command(const std::string &line, std::string &out, int timeoutMs)
+{
+	double end = nowSecs() + timeoutMs / 1e3;
+
+	respSeen = false;
+	if(!send(LINK_PKT_CMD, line.data(), line.size())) { return false; }
+
+	while(!respSeen && nowSecs() < end) { poll(10); }
+
+	out = resp;
+	return respSeen;
+}
+
+
+
+bool LinkClient::syncCredits()
+{
+	std::string r;
+
+	if(synced) { return true; }
+
+	syncing = true;
+	if(!command("link credit", r) || r != "ok") { return false; }
+
+	double end = nowSecs() + CREDIT_WAIT_MS / 1e3;
+	while(syncing && nowSecs() < end) { poll(10); }
+	return synced;
+}
+
+
+
+/**
+ * Everything sent past what the board had taken in at the last credit is
+ * still on the way, and counts against the room it had
+ */
+bool LinkClient::hasRoom(uint32_t bytes, uint32_t segs) const
+{
+	return bytesSent + bytes - credit.bytesTaken <= credit.bytesFree &&
+			segsSent + segs - credit.segsTaken <= credit.segsFree;
+}
+
+
+
+bool LinkClient::waitRoom(uint32_t bytes, uint32_t segs, StreamStats &st)
+{
+	poll(0);
+	if(credit.segsFree < st.minFree) { st.minFree = credit.segsFree; }
+	if(hasRoom(bytes, segs)) { return true; }
+
+	st.creditWaits++;
+	double end = nowSecs() + CREDIT_WAIT_MS / 1e3;
+
+	while(nowSecs() < end)
+	{
+		poll(1);
+		if(credit.segsFree < st.minFree) { st.minFree = credit.segsFree; }
+		if(hasRoom(bytes, segs)) { return true; }
+	}
+
+	return false;
+}
+
+
+
+
+/**
+ * Packs the points into full batches, and sends each one as soon as there
+ * are credits for it
+ */
+bool LinkClient::streamWaypoints(const std::vector<WpqPoint> &pts, StreamStats &st)
+{
+	std::string r;
+	WpqBatch b;
+	size_t i = 0;
+
+	memset(&st, 0, sizeof(st));
+	if(!command("link telem 50", r) || r != "ok") { return false; }
+	if(!syncCredits()) { return false; }
+
+	double end = nowSecs() + CREDIT_WAIT_MS / 1e3;
+	while(!telemSeen && nowSecs() < end) { poll(10); }
+	if(!telemSeen) { return false; }
+
+	uint32_t underruns0 = telem.wpqUnderruns;
+	st.minFree = credit.segsFree;
+	double t0 = nowSecs();
+
+	while(i < pts.size())
+	{
+		size_t n = pts.size() - i;
+		if(n > WPQ_BATCH_PTS) { n = WPQ_BATCH_PTS; }
+
+		b.magic = WPQ_MAGIC;
+		b.n = n;
+		b.flags = i + n < pts.size() ? WPQ_FLAG_MORE : 0;
+		memcpy(b.pt, &pts[i], n * sizeof(WpqPoint));
+
+		uint16_t len = WPQ_HDR_SIZE + n * sizeof(WpqPoint);
+		if(!waitRoom(LINK_HDR_SIZE + len, 1, st)) { return false; }
+		if(!send(LINK_PKT_WPQ, &b, len)) { return false; }
+
+		st.batches++;
+		st.points += n;
+		st.pkts++;
+		st.bytes += LINK_HDR_SIZE + len;
+		i += n;
+	}
+
+	st.secs = nowSecs() - t0;
+
+	waitDrained(60000);
+	st.starvations = telem.wpqUnderruns - underruns0; // the last batch has no more flag, so the end doesn't count
+
+	command("link telem off", r);
+	return true;
+}
+
+
+
+bool LinkClient::streamSink(const std::vector<uint8_t> &data, StreamStats &st)
+{
+	size_t i = 0;
+
+	memset(&st, 0, sizeof(st));
+	if(!syncCredits()) { return false; }
+
+	st.minFree = credit.segsFree;
+	double t0 = nowSecs();
+
+	while(i < data.size())
+	{
+		size_t n = data.size() - i;
+		if(n > LINK_MAX_PAYLOAD) { n = LINK_MAX_PAYLOAD; }
+
+		if(!waitRoom(LINK_HDR_SIZE + n, 0, st)) { return false; }
+		if(!send(LINK_PKT_SINK, &data[i], n)) { return false; }
+
+		st.pkts++;
+		st.bytes += LINK_HDR_SIZE + n;
+		i += n;
+	}
+
+	st.secs = nowSecs() - t0;
+	return true;
+}
+
+
+
+bool LinkClient::waitDrained(int timeoutMs)
+{
+	double end = nowSecs() + timeoutMs / 1e3;
+
+	while(nowSecs() < end)
+	{
+		poll(10);
+		if(telemSeen && !telem.wpqQueued && telem.wpqTaken == segsSent) { return true; }
+	}
+
+	return false;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////// Trajectories /////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+
+
+bool loadWaypoints(const std::string &path, std::vector<WpqPoint> &pts)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	WpqPoint p;
+
+	if(!f) { return false; }
+
+	pts.clear();
+	while(fread(&p, sizeof(p), 1, f) == 1) { pts.push_back(p); }
+
+	fclose(f);
+	return true;
+}
+
+
+
+/**
+ * Loops of a circle in the z = 0 plane, one waypoint every stepUs, with the
+ * extruder running along with the path length. The first point is moved to
+ * from wherever the board is sitting
+ */
+void synthCircle(std::vector<WpqPoint> &pts, float cx, float cy, float r, float secs, uint32_t stepUs)
+{
+	uint32_t n = (uint32_t)(secs * 1e6f / stepUs), i;
+	float e = 0, step = 2 * (float)M_PI / 2000; // one loop every 2000 points
+
+	pts.clear();
+	for(i = 0; i <= n; i++)
+	{
+		WpqPoint p;
+		p.dur = stepUs;
+		p.p[0] = cx + r * cosf(i * step);
+		p.p[1] = cy + r * sinf(i * step);
+		p.p[2] = 0;
+		p.p[3] = e;
+
+		e += r * step * 0.05f;
+		pts.push_back(p);
+	}
+}
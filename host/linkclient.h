@@ -0,0 +1,138 @@
+/*
+ * linkclient.h
+ *
+ * Host end of the link.h packet protocol, for streaming jobs to the board
+ * (or to sim_link) from a PC. The packet layouts come straight from the
+ * firmware headers, so the two ends can't drift apart.
+ *
+ * Transports:
+ *   TcpTransport  a TCP socket. sim_link listens on localhost:5170
+ *   UsbTransport  the bulk device from usblink.h, through Linux usbfs, so no
+ *                 libusb is needed. The user needs rw access to the device node
+ *
+ * Streams are sent within the board's credits (see link.h), so the client
+ * keeps the pipe and the board's queue full without waiting on a reply per
+ * packet, and never overruns either. "link credit" lines the client's byte
+ * and batch counts up with the board's before a stream starts. Telemetry is
+ * turned on for waypoint streams, for the queue underrun count, which is how
+ * starvation shows up on this end
+ */
+
+#ifndef HOST_LINKCLIENT_H_
+#define HOST_LINKCLIENT_H_
+
+#include "code/link.h"
+#include "code/wpq.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+class Transport
+{
+public:
+	virtual ~Transport() {}
+	virtual size_t read(void *buf, size_t len, int timeoutMs) = 0; // bytes read, 0 on timeout
+	virtual bool write(const void *buf, size_t len) = 0; // false if the link dropped
+	virtual const char *name() const = 0;
+};
+
+
+
+class TcpTransport : public Transport
+{
+public:
+	TcpTransport();
+	~TcpTransport();
+	bool open(const std::string &host, uint16_t port);
+
+	size_t read(void *buf, size_t len, int timeoutMs);
+	bool write(const void *buf, size_t len);
+	const char *name() const { return "tcp"; }
+
+private:
+	int fd;
+};
+
+
+
+class UsbTransport : public Transport
+{
+public:
+	UsbTransport();
+	~UsbTransport();
+	bool open(uint16_t vid = 0x1cbe, uint16_t pid = 0x0003); // first matching device
+
+	size_t read(void *buf, size_t len, int timeoutMs);
+	bool write(const void *buf, size_t len);
+	const char *name() const { return "usb"; }
+
+private:
+	int fd;
+	std::vector<uint8_t> rxBuf;	// rest of the last bulk packet
+	size_t rxPos;
+};
+
+
+
+/**
+ * Counters for one streaming run
+ */
+struct StreamStats
+{
+	uint64_t bytes;			// payload bytes sent, headers included
+	uint32_t pkts;
+	uint32_t batches;		// waypoint batches
+	uint32_t points;
+	uint32_t creditWaits;	// times sending stopped for lack of room on the board
+	uint32_t starvations;	// board queue underruns during the run
+	uint32_t minFree;		// fewest free batch blocks the board reported
+	double secs;
+
+	double mbps() const { return secs > 0 ? bytes / secs / 1e6 : 0; }
+};
+
+
+
+class LinkClient
+{
+public:
+	explicit LinkClient(Transport &t);
+
+	bool send(uint8_t type, const void *payload, uint16_t len);
+	bool command(const std::string &line, std::string &resp, int timeoutMs = 1000); // runs a tune or link command
+	void poll(int timeoutMs); // reads and handles whatever packets have come in
+
+	bool streamWaypoints(const std::vector<WpqPoint> &pts, StreamStats &st); // batches and sends a trajectory, within the credits
+	bool streamSink(const std::vector<uint8_t> &data, StreamStats &st); // sends data as sink packets, as fast as the link takes it
+	bool waitDrained(int timeoutMs); // waits for the board's waypoint queue to empty
+
+	bool haveTelem() const { return telemSeen; }
+	const LinkTelem &lastTelem() const { return telem; }
+
+private:
+	bool readPkt(uint8_t &type, std::vector<uint8_t> &payload, int timeoutMs);
+	void handle(uint8_t type, const std::vector<uint8_t> &payload);
+	bool syncCredits(); // lines the sent counts up with the board's
+	bool hasRoom(uint32_t bytes, uint32_t segs) const; // within the last credit
+	bool waitRoom(uint32_t bytes, uint32_t segs, StreamStats &st); // polls until there is room. false on a timeout
+
+	Transport &t;
+	LinkTelem telem;
+	bool telemSeen;
+	LinkCredit credit;
+	bool synced;				// the sent counts below are in the board's terms
+	bool syncing;
+	uint32_t bytesSent;			// where the board's byte count will be once it has read everything sent
+	uint32_t segsSent;			// same, for batches
+	bool respSeen;
+	std::string resp;
+	std::vector<uint8_t> rx;	// partial packet
+};
+
+
+bool loadWaypoints(const std::string &path, std::vector<WpqPoint> &pts); // raw 20 byte (dur, x, y, z, e) records
+void synthCircle(std::vector<WpqPoint> &pts, float cx, float cy, float r, float secs, uint32_t stepUs);
+
+
+#endif /* HOST_LINKCLIENT_H_ */
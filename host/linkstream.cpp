@@ -0,0 +1,145 @@
+/*
+ * linkstream.cpp
+ *
+ * Bench tool for the job upload paths. Streams a job to the board (or to
+ * sim_link) over TCP or USB, and reports the throughput, how often the board
+ * ran out of room, and how often its waypoint queue was starved:
+ *
+ *   linkstream [--tcp host[:port] | --usb] --wpq file       # binary waypoints
+ *   linkstream [--tcp host[:port] | --usb] --circle secs us # synthetic waypoints, one every us
+ *   linkstream [--tcp host[:port] | --usb] --gcode file     # sent as sink packets
+ *   linkstream [--tcp host[:port] | --usb] --sink MB        # filler, for the raw link rate
+ *   linkstream [--tcp host[:port] | --usb] --cmd "line"     # runs one command
+ *
+ * With no transport given it connects to sim_link on localhost. There is no
+ * G-code interpreter on the board, so G-code only measures the link
+ */
+
+#include "linkclient.h"
+#include "code/usblink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+
+#define CIRCLE_X	10.0f	// centered on the default axis positions in dat.c
+#define CIRCLE_Y	12.0f
+#define CIRCLE_R	0.5f
+
+
+static void usage()
+{
+	fprintf(stderr, "usage: linkstream [--tcp host[:port] | --usb] (--wpq file | --circle secs us | --gcode file | --sink MB | --cmd line)\n");
+	exit(2);
+}
+
+
+
+static bool readFile(const char *path, std::vector<uint8_t> &data)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t buf[4096];
+	size_t n;
+
+	if(!f) { return false; }
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) { data.insert(data.end(), buf, buf + n); }
+
+	fclose(f);
+	return true;
+}
+
+
+
+static void report(const char *what, Transport &t, const StreamStats &st, bool motion)
+{
+	printf("%s over %s: %llu bytes in %.3f s, %.3f MB/s, %u pkts\n", what, t.name(),
+			(unsigned long long)st.bytes, st.secs, st.mbps(), st.pkts);
+
+	if(motion)
+	{
+		printf("  %u batches, %u points, %u credit waits, fewest free blocks %u, %u starvations\n",
+				st.batches, st.points, st.creditWaits, st.minFree, st.starvations);
+	}
+}
+
+
+
+int main(int argc, char **argv)
+{
+	std::unique_ptr<Transport> t;
+	std::string host = "localhost";
+	uint16_t port = USBLINK_SIM_PORT;
+	bool usb = false;
+	int i = 1;
+
+	if(i < argc && !strcmp(argv[i], "--tcp") && i + 1 < argc)
+	{
+		host = argv[i + 1];
+		size_t colon = host.rfind(':');
+		if(colon != std::string::npos)
+		{
+			port = atoi(host.c_str() + colon + 1);
+			host.resize(colon);
+		}
+		i += 2;
+	}
+	else if(i < argc && !strcmp(argv[i], "--usb"))
+	{
+		usb = true;
+		i++;
+	}
+
+	if(i >= argc) { usage(); }
+
+	if(usb)
+	{
+		UsbTransport *u = new UsbTransport();
+		t.reset(u);
+		if(!u->open()) { fprintf(stderr, "linkstream: no board on USB\n"); return 1; }
+	}
+	else
+	{
+		TcpTransport *c = new TcpTransport();
+		t.reset(c);
+		if(!c->open(host, port)) { fprintf(stderr, "linkstream: couldn't connect to %s:%u\n", host.c_str(), port); return 1; }
+	}
+
+	LinkClient client(*t);
+	StreamStats st;
+	std::string opt = argv[i];
+
+	if(opt == "--cmd" && i + 1 < argc)
+	{
+		std::string resp;
+		if(!client.command(argv[i + 1], resp)) { fprintf(stderr, "linkstream: no response\n"); return 1; }
+		printf("%s\n", resp.c_str());
+		return 0;
+	}
+
+	if((opt == "--wpq" && i + 1 < argc) || (opt == "--circle" && i + 2 < argc))
+	{
+		std::vector<WpqPoint> pts;
+
+		if(opt == "--wpq" && !loadWaypoints(argv[i + 1], pts)) { fprintf(stderr, "linkstream: can't read %s\n", argv[i + 1]); return 1; }
+		if(opt == "--circle") { synthCircle(pts, CIRCLE_X, CIRCLE_Y, CIRCLE_R, atof(argv[i + 1]), atoi(argv[i + 2])); }
+
+		if(!client.streamWaypoints(pts, st)) { fprintf(stderr, "linkstream: link dropped\n"); return 1; }
+		report("waypoints", *t, st, true);
+		return 0;
+	}
+
+	if((opt == "--gcode" || opt == "--sink") && i + 1 < argc)
+	{
+		std::vector<uint8_t> data;
+
+		if(opt == "--gcode" && !readFile(argv[i + 1], data)) { fprintf(stderr, "linkstream: can't read %s\n", argv[i + 1]); return 1; }
+		if(opt == "--sink") { data.assign((size_t)(atof(argv[i + 1]) * 1e6), 0); }
+
+		if(!client.streamSink(data, st)) { fprintf(stderr, "linkstream: link dropped\n"); return 1; }
+		report(opt == "--gcode" ? "gcode" : "sink", *t, st, false);
+		return 0;
+	}
+
+	usage();
+	return 2;
+}
@@ -0,0 +1,136 @@
+/*
+ * sim_advance.c
+ *
+ * Host simulation of pressure advance on an extruder channel. A planned
+ * extrusion profile (speed up, cruise, then a hard stop, which drives the
+ * advanced extruder backwards) goes through advance_apply(), and the step
+ * segments it makes are turned into step times by the same generator the
+ * stepper uses (stepgen.h). Every step is checked against the analytic
+ * advanced position and velocity from advance_refPos() and advance_refVel().
+ * Exits nonzero if any step is off by more than the tolerances
+ */
+
+#include "code/advance.h"
+#include "code/stepgen.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#define SIM_CLK			120000000
+#define SIM_SEG_US		5000		// planned segment length
+#define SIM_ADV_K		0.002f		// secs
+#define SIM_POS_TOL		1.5f		// steps. Rounding alone can be a whole step
+#define SIM_VEL_TOL		0.02f		// relative step rate error
+#define SIM_VEL_MIN		200			// steps/s. Below this an interval is too coarse to give a rate
+
+
+typedef struct SimPlan
+{
+	float v0;	// planned extrusion velocity at the start (steps/s)
+	float v1;	// and at the end
+} SimPlan;
+
+
+static const SimPlan simPlan[] =
+{
+	{ 0, 4000 }, { 4000, 8000 }, { 8000, 12000 }, { 12000, 16000 },
+	{ 16000, 16000 }, { 16000, 16000 }, { 16000, 16000 },
+	{ 16000, 8000 }, { 8000, 0 },		// hard stop, the advance term reverses the extruder
+	{ 0, 0 },
+	{ 0, 3000 }, { 3000, 3000 }, { 3000, 0 }
+};
+
+#define SIM_NUM_PLAN (sizeof(simPlan) / sizeof(simPlan[0]))
+
+
+static float maxPosErr, maxVelErr;
+static uint32_t stepsChecked, ratesChecked;
+
+
+
+
+/**
+ * Runs one step segment through the generator, checking each step against
+ * the planned segment it came from
+ *
+ * @param t0 time of the step segment start, from the planned segment start (secs)
+ * @param pos extruder position, relative to the planned segment start. Updated
+ */
+static void simSeg(const SimPlan *pl, float base, const StepSeg *s, float t0, float *pos)
+{
+	const float segTime = SIM_SEG_US / 1e6f;
+	StepGen g;
+	float t = t0;
+	int dir = s->steps < 0 ? -1 : 1;
+
+	stepgen_load(&g, s, SIM_CLK, STEPPER_MAX_IVL);
+
+	while(g.left)
+	{
+		bool last = g.left == 1;
+		uint32_t ivl = stepgen_next(&g, 1, STEPPER_MAX_IVL);
+		float dt = (float)ivl / SIM_CLK;
+
+		t += dt;
+		if(!s->steps) { continue; } // dwell
+
+		*pos += dir;
+		stepsChecked++;
+
+		float err = fabsf(base + *pos - (base + advance_refPos(SIM_ADV_K, pl->v0, pl->v1, segTime, t)));
+		if(err > maxPosErr) { maxPosErr = err; }
+
+		// the last interval soaks up the rounding, so it has no rate to speak of
+		float ref = fabsf(advance_refVel(SIM_ADV_K, pl->v0, pl->v1, segTime, t - dt / 2));
+		if(!last && ref > SIM_VEL_MIN)
+		{
+			float rel = fabsf(1 / dt - ref) / ref;
+			if(rel > maxVelErr) { maxVelErr = rel; }
+			ratesChecked++;
+		}
+	}
+}
+
+
+
+
+int main()
+{
+	const uint32_t dur = (uint64_t)SIM_SEG_US * SIM_CLK / 1000000;
+	const float segTime = SIM_SEG_US / 1e6f;
+	float carry = 0, base = 0;
+	uint32_t i, splits = 0;
+
+	for(i = 0; i < SIM_NUM_PLAN; i++)
+	{
+		const SimPlan *pl = &simPlan[i];
+		float de = (pl->v0 + pl->v1) / 2 * segTime;
+		StepSeg out[ADVANCE_MAX_SEGS];
+		float t0 = 0, pos = -carry; // the carry is owed from before this segment
+		uint8_t n, j;
+
+		n = advance_apply(SIM_ADV_K, &carry, de, pl->v0, pl->v1, dur, SIM_CLK, out);
+		if(n > 1) { splits++; }
+
+		for(j = 0; j < n; j++)
+		{
+			simSeg(pl, base, &out[j], t0, &pos);
+			t0 += (float)out[j].dur / SIM_CLK;
+		}
+
+		base += de + SIM_ADV_K * (pl->v1 - pl->v0);
+	}
+
+	printf("sim_advance: %u steps, %u rates checked, %u splits\n", stepsChecked, ratesChecked, splits);
+	printf("  max position error %.3f steps (tolerance %.3f)\n", maxPosErr, SIM_POS_TOL);
+	printf("  max rate error %.4f (tolerance %.4f)\n", maxVelErr, SIM_VEL_TOL);
+
+	if(maxPosErr > SIM_POS_TOL || maxVelErr > SIM_VEL_TOL || !splits)
+	{
+		printf("sim_advance: FAILED\n");
+		return 1;
+	}
+
+	printf("sim_advance: ok\n");
+	return 0;
+}
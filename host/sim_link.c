@@ -0,0 +1,79 @@
+/*
+ * sim_link.c
+ *
+ * Host simulation of the board end of the USB host link. Serves link.h's
+ * packets on the usblink.h stand-in socket, and runs the waypoint queue on
+ * simulated servo ticks kept in step with the wall clock, so host tools can
+ * be tried against it with no board attached. Prints the link stats every
+ * few seconds
+ */
+
+#include "code/link.h"
+#include "code/usblink.h"
+#include "code/wpq.h"
+#include "code/pool.h"
+#include "code/sched.h"
+#include "code/timebase.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SIM_CLK			120000000	// same as the board
+#define SIM_REPORT_US	5000000
+
+
+static uint64_t simStart;	// wall clock at startup (nsecs)
+static uint64_t simLastReport;
+
+
+
+static uint64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+
+/**
+ * Brings the simulated clock up to the wall clock, one servo tick at a time,
+ * running the servo and planner work for each tick as it goes
+ */
+static void simIdle()
+{
+	uint64_t target = (nowNs() - simStart) * (SIM_CLK / 1000000) / 1000;
+	uint32_t tick = SIM_CLK / SCHED_TICK_HZ;
+
+	while(currTimeCycles() + tick <= target)
+	{
+		timebase_simAdvance(tick);
+		wpq_tick();
+		wpq_service();
+	}
+
+	if(currTime() - simLastReport >= SIM_REPORT_US)
+	{
+		simLastReport = currTime();
+		link_report();
+	}
+}
+
+
+
+int main()
+{
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	timebase_init(SIM_CLK);
+	pool_initAll();
+	wpq_init();
+
+	if(!usblink_init()) { return 1; }
+	printf("sim_link: serving on localhost port %d\n", USBLINK_SIM_PORT);
+
+	simStart = nowNs();
+	usbLink.idle = simIdle;
+	link_serve(&usbLink);
+
+	return 0;
+}